@@ -0,0 +1,755 @@
+// Closed-loop HTTP/1.1 load generator for the server.
+//
+// Every connection keeps at most one batch (1 request, or --pipeline N) in
+// flight. With --rate the batches follow a fixed schedule and latency is
+// measured from the time a request *should* have been sent, so a stalled
+// server cannot hide its stall by slowing the generator down (coordinated
+// omission). Without --rate the generator runs flat out and the latency
+// distribution is corrected afterwards using the mean service time as the
+// expected interval, the same way HdrHistogram does.
+
+#include <algorithm>        // std::min, std::max
+#include <atomic>           // std::atomic
+#include <cctype>           // std::tolower
+#include <cerrno>           // errno
+#include <chrono>           // std::chrono
+#include <csignal>          // kill(), SIGTERM
+#include <cstdint>          // uint64_t
+#include <cstdlib>          // std::atoi, std::exit
+#include <cstring>          // std::memcmp, strerror
+#include <filesystem>       // std::filesystem
+#include <fstream>          // std::ofstream
+#include <iomanip>          // std::setprecision
+#include <iostream>         // std::cout, std::cerr
+#include <memory>           // std::unique_ptr
+#include <sstream>          // std::ostringstream
+#include <stdexcept>        // std::runtime_error
+#include <string>           // std::string
+#include <thread>           // std::thread
+#include <vector>           // std::vector
+#include <arpa/inet.h>      // inet_pton()
+#include <fcntl.h>          // fcntl()
+#include <netinet/in.h>     // sockaddr_in
+#include <netinet/tcp.h>    // TCP_NODELAY
+#include <poll.h>           // poll()
+#include <sys/socket.h>     // socket(), connect()
+#include <sys/wait.h>       // waitpid()
+#include <unistd.h>         // fork(), execv(), close()
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Log-linear latency histogram in microseconds, ~0.2% relative precision
+    class LatencyHistogram {
+    public:
+        static constexpr int LINEAR_LIMIT = 1024;
+        static constexpr int SUB_BUCKETS = 512;
+        static constexpr int MAGNITUDES = 40;
+
+        LatencyHistogram() : counts(LINEAR_LIMIT + MAGNITUDES * SUB_BUCKETS, 0) {}
+
+        void record(uint64_t value, uint64_t count = 1) {
+            counts[index_of(value)] += count;
+            total += count;
+            sum += value * count;
+            max_value = std::max(max_value, value);
+        }
+
+        // Back-fill the samples a closed-loop client failed to send while it waited
+        void record_corrected(uint64_t value, uint64_t expected_interval, uint64_t count = 1) {
+            record(value, count);
+            if (expected_interval == 0) {
+                return;
+            }
+            for (uint64_t missing = (value > expected_interval ? value - expected_interval : 0);
+                 missing >= expected_interval; missing -= expected_interval) {
+                record(missing, count);
+            }
+        }
+
+        void merge(const LatencyHistogram &other) {
+            for (size_t i = 0; i < counts.size(); ++i) {
+                counts[i] += other.counts[i];
+            }
+            total += other.total;
+            sum += other.sum;
+            max_value = std::max(max_value, other.max_value);
+        }
+
+        LatencyHistogram corrected(uint64_t expected_interval) const {
+            LatencyHistogram result;
+            for (size_t i = 0; i < counts.size(); ++i) {
+                if (counts[i]) {
+                    result.record_corrected(value_of(i), expected_interval, counts[i]);
+                }
+            }
+            return result;
+        }
+
+        uint64_t percentile(double p) const {
+            if (total == 0) {
+                return 0;
+            }
+            uint64_t rank = static_cast<uint64_t>(p / 100.0 * static_cast<double>(total) + 0.5);
+            rank = std::max<uint64_t>(rank, 1);
+            uint64_t seen = 0;
+            for (size_t i = 0; i < counts.size(); ++i) {
+                seen += counts[i];
+                if (seen >= rank) {
+                    return std::min(value_of(i), max_value);
+                }
+            }
+            return max_value;
+        }
+
+        uint64_t count() const { return total; }
+        uint64_t max() const { return max_value; }
+        double mean() const { return total ? static_cast<double>(sum) / static_cast<double>(total) : 0.0; }
+
+    private:
+        std::vector<uint64_t> counts;
+        uint64_t total = 0;
+        uint64_t sum = 0;
+        uint64_t max_value = 0;
+
+        static size_t index_of(uint64_t value) {
+            if (value < LINEAR_LIMIT) {
+                return static_cast<size_t>(value);
+            }
+            int magnitude = (63 - __builtin_clzll(value)) - 9;
+            magnitude = std::min(magnitude, MAGNITUDES);
+            uint64_t mantissa = std::min<uint64_t>(value >> magnitude, 2 * SUB_BUCKETS - 1);
+            return LINEAR_LIMIT + static_cast<size_t>(magnitude - 1) * SUB_BUCKETS + static_cast<size_t>(mantissa - SUB_BUCKETS);
+        }
+
+        static uint64_t value_of(size_t index) {
+            if (index < LINEAR_LIMIT) {
+                return index;
+            }
+            size_t magnitude = (index - LINEAR_LIMIT) / SUB_BUCKETS + 1;
+            uint64_t mantissa = (index - LINEAR_LIMIT) % SUB_BUCKETS + SUB_BUCKETS;
+            return (mantissa << magnitude) + ((uint64_t{1} << magnitude) >> 1);
+        }
+    };
+
+    struct Target {
+        std::string path;
+        unsigned weight;
+        std::string method = "GET";
+    };
+
+    struct Options {
+        std::string host = "127.0.0.1";
+        uint16_t port = 4221;
+        unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+        unsigned connections = 16;
+        double duration = 10.0;         // seconds
+        double warmup = 1.0;            // seconds, not recorded
+        double rate = 0.0;              // total requests per second, 0 = as fast as possible
+        unsigned pipeline = 1;
+        bool keep_alive = true;
+        int timeout_ms = 2000;
+        std::vector<Target> mix = {{"/", 1}, {"/echo/hello", 4}, {"/files/loadgen.bin", 1}, {"/user-agent", 2}};
+        std::string server_binary;      // spawn this server locally when set
+        std::string json_path;
+    };
+
+    struct ThreadResult {
+        LatencyHistogram latency;
+        uint64_t completed = 0;
+        uint64_t non_2xx = 0;
+        uint64_t connect_errors = 0;
+        uint64_t io_errors = 0;
+        uint64_t timeouts = 0;
+        uint64_t bytes_read = 0;
+    };
+
+    // Minimal incremental HTTP/1.1 response framer
+    struct ResponseParser {
+        enum class Result { INCOMPLETE, DONE, BAD };
+
+        int status = 0;
+        bool close = false;
+
+        // Consume one complete response from the front of 'in'
+        Result parse(std::string &in) {
+            size_t header_end = in.find("\r\n\r\n");
+            if (header_end == std::string::npos) {
+                return Result::INCOMPLETE;
+            }
+            if (in.compare(0, 9, "HTTP/1.1 ") != 0 && in.compare(0, 9, "HTTP/1.0 ") != 0) {
+                return Result::BAD;
+            }
+            status = std::atoi(in.c_str() + 9);
+            close = false;
+            size_t content_length = 0;
+            bool chunked = false;
+
+            size_t line = in.find("\r\n") + 2;
+            while (line < header_end) {
+                size_t eol = in.find("\r\n", line);
+                std::string header = in.substr(line, eol - line);
+                size_t colon = header.find(':');
+                if (colon != std::string::npos) {
+                    std::string name = lower(header.substr(0, colon));
+                    std::string value = lower(trim(header.substr(colon + 1)));
+                    if (name == "content-length") {
+                        content_length = std::stoul(value);
+                    } else if (name == "connection") {
+                        close = (value == "close");
+                    } else if (name == "transfer-encoding") {
+                        chunked = (value.find("chunked") != std::string::npos);
+                    }
+                }
+                line = eol + 2;
+            }
+
+            size_t body_start = header_end + 4;
+            if (!chunked) {
+                if (in.size() < body_start + content_length) {
+                    return Result::INCOMPLETE;
+                }
+                in.erase(0, body_start + content_length);
+                return Result::DONE;
+            }
+
+            size_t pos = body_start;
+            while (true) {
+                size_t eol = in.find("\r\n", pos);
+                if (eol == std::string::npos) {
+                    return Result::INCOMPLETE;
+                }
+                size_t chunk_size = std::stoul(in.substr(pos, eol - pos), nullptr, 16);
+                if (chunk_size == 0) {
+                    size_t trailer_end = in.find("\r\n\r\n", eol);
+                    if (trailer_end == std::string::npos) {
+                        return Result::INCOMPLETE;
+                    }
+                    in.erase(0, trailer_end + 4);
+                    return Result::DONE;
+                }
+                pos = eol + 2 + chunk_size + 2;
+                if (pos > in.size()) {
+                    return Result::INCOMPLETE;
+                }
+            }
+        }
+
+        static std::string lower(std::string s) {
+            for (char &c : s) {
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+            return s;
+        }
+
+        static std::string trim(const std::string &s) {
+            size_t begin = s.find_first_not_of(" \t");
+            size_t end = s.find_last_not_of(" \t");
+            return begin == std::string::npos ? "" : s.substr(begin, end - begin + 1);
+        }
+    };
+
+    struct Connection {
+        int fd = -1;
+        std::string out;
+        size_t out_offset = 0;
+        std::string in;
+        std::vector<Clock::time_point> in_flight;   // intended start of each outstanding request
+        Clock::time_point next_send;
+        Clock::time_point last_progress;
+        ResponseParser parser;
+    };
+
+    class Worker {
+    public:
+        Worker(const Options &options, const sockaddr_in &address, unsigned connection_count, unsigned seed)
+            : options(options), address(address), connections(connection_count), rng(seed | 1) {
+            for (const Target &target : options.mix) {
+                total_weight += target.weight;
+                std::ostringstream request;
+                request << target.method << " " << target.path << " HTTP/1.1\r\n"
+                        << "Host: " << options.host << ":" << options.port << "\r\n"
+                        << "User-Agent: http-server-loadgen/1.0\r\n"
+                        << "Accept-Encoding: gzip\r\n";
+                if (!options.keep_alive) {
+                    request << "Connection: close\r\n";
+                }
+                request << "\r\n";
+                rendered.push_back(request.str());
+            }
+            double per_connection_rate = options.rate / std::max(1u, options.connections);
+            if (per_connection_rate > 0) {
+                interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / per_connection_rate));
+            }
+        }
+
+        void run(Clock::time_point start, Clock::time_point record_from, Clock::time_point stop) {
+            this->record_from = record_from;
+            // Stagger the schedule so paced connections don't fire in lock-step
+            for (size_t i = 0; i < connections.size(); ++i) {
+                connections[i].next_send = start + (interval * static_cast<int>(i)) / static_cast<int>(connections.size());
+            }
+
+            std::vector<pollfd> fds(connections.size());
+            while (true) {
+                Clock::time_point now = Clock::now();
+                if (now >= stop) {
+                    break;
+                }
+
+                Clock::time_point wake = stop;
+                for (Connection &conn : connections) {
+                    if (conn.in_flight.empty() && conn.out_offset >= conn.out.size()) {
+                        if (interval.count() == 0 || now >= conn.next_send) {
+                            start_batch(conn, now);
+                        } else {
+                            wake = std::min(wake, conn.next_send);
+                        }
+                    }
+                }
+
+                for (size_t i = 0; i < connections.size(); ++i) {
+                    Connection &conn = connections[i];
+                    fds[i].fd = conn.fd;
+                    fds[i].events = 0;
+                    fds[i].revents = 0;
+                    if (conn.fd >= 0) {
+                        if (conn.out_offset < conn.out.size()) fds[i].events |= POLLOUT;
+                        if (!conn.in_flight.empty()) fds[i].events |= POLLIN;
+                    }
+                    if (fds[i].events == 0) {
+                        fds[i].fd = -1;
+                    }
+                }
+
+                auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(wake - Clock::now()).count();
+                int timeout = static_cast<int>(std::clamp<long long>(wait, 0, 10));
+                if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) {
+                    throw std::runtime_error("poll failed: " + std::string(strerror(errno)));
+                }
+
+                now = Clock::now();
+                for (size_t i = 0; i < connections.size(); ++i) {
+                    Connection &conn = connections[i];
+                    if (fds[i].fd < 0) {
+                        continue;
+                    }
+                    if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL) && !(fds[i].revents & POLLIN)) {
+                        fail(conn, result.io_errors);
+                        continue;
+                    }
+                    if (fds[i].revents & POLLOUT) {
+                        on_writable(conn);
+                    }
+                    if (conn.fd >= 0 && (fds[i].revents & POLLIN)) {
+                        on_readable(conn);
+                    }
+                    if (conn.fd >= 0 && !conn.in_flight.empty() &&
+                        now - conn.last_progress > std::chrono::milliseconds(options.timeout_ms)) {
+                        fail(conn, result.timeouts);
+                    }
+                }
+            }
+
+            for (Connection &conn : connections) {
+                close_connection(conn);
+            }
+        }
+
+        const ThreadResult &results() const { return result; }
+
+    private:
+        const Options &options;
+        sockaddr_in address;
+        std::vector<Connection> connections;
+        std::vector<std::string> rendered;
+        unsigned total_weight = 0;
+        uint64_t rng;
+        Clock::duration interval{0};
+        Clock::time_point record_from;
+        ThreadResult result;
+
+        uint64_t next_random() {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            return rng;
+        }
+
+        const std::string &pick_request() {
+            unsigned roll = static_cast<unsigned>(next_random() % total_weight);
+            for (size_t i = 0; i < options.mix.size(); ++i) {
+                if (roll < options.mix[i].weight) {
+                    return rendered[i];
+                }
+                roll -= options.mix[i].weight;
+            }
+            return rendered.back();
+        }
+
+        bool ensure_connected(Connection &conn) {
+            if (conn.fd >= 0) {
+                return true;
+            }
+            conn.fd = socket(AF_INET, SOCK_STREAM, 0);
+            if (conn.fd < 0) {
+                ++result.connect_errors;
+                return false;
+            }
+            if (connect(conn.fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0) {
+                ++result.connect_errors;
+                close_connection(conn);
+                return false;
+            }
+            int one = 1;
+            setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            fcntl(conn.fd, F_SETFL, fcntl(conn.fd, F_GETFL) | O_NONBLOCK);
+            return true;
+        }
+
+        void start_batch(Connection &conn, Clock::time_point now) {
+            // Paced mode measures from the schedule, closed mode from now
+            Clock::time_point intended = interval.count() ? conn.next_send : now;
+            if (!ensure_connected(conn)) {
+                conn.next_send = intended + interval * options.pipeline;
+                return;
+            }
+            conn.out.clear();
+            conn.out_offset = 0;
+            unsigned batch = options.keep_alive ? options.pipeline : 1;
+            for (unsigned i = 0; i < batch; ++i) {
+                conn.out += pick_request();
+                conn.in_flight.push_back(intended + interval * i);
+            }
+            conn.next_send = intended + interval * batch;
+            conn.last_progress = now;
+            on_writable(conn);
+        }
+
+        void on_writable(Connection &conn) {
+            while (conn.out_offset < conn.out.size()) {
+                ssize_t sent = send(conn.fd, conn.out.data() + conn.out_offset, conn.out.size() - conn.out_offset, MSG_NOSIGNAL);
+                if (sent < 0) {
+                    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                        fail(conn, result.io_errors);
+                    }
+                    return;
+                }
+                conn.out_offset += static_cast<size_t>(sent);
+            }
+        }
+
+        void on_readable(Connection &conn) {
+            char buffer[16384];
+            bool eof = false;
+            while (true) {
+                ssize_t got = recv(conn.fd, buffer, sizeof(buffer), 0);
+                if (got == 0) {
+                    eof = true;
+                    break;
+                }
+                if (got < 0) {
+                    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                        fail(conn, result.io_errors);
+                    }
+                    break;
+                }
+                conn.in.append(buffer, static_cast<size_t>(got));
+                result.bytes_read += static_cast<uint64_t>(got);
+            }
+
+            Clock::time_point now = Clock::now();
+            conn.last_progress = now;
+            while (!conn.in_flight.empty()) {
+                ResponseParser::Result parsed;
+                try {
+                    parsed = conn.parser.parse(conn.in);
+                } catch (const std::exception &) {
+                    parsed = ResponseParser::Result::BAD;
+                }
+                if (parsed == ResponseParser::Result::INCOMPLETE) {
+                    break;
+                }
+                if (parsed == ResponseParser::Result::BAD) {
+                    fail(conn, result.io_errors);
+                    return;
+                }
+                Clock::time_point intended = conn.in_flight.front();
+                conn.in_flight.erase(conn.in_flight.begin());
+                if (intended >= record_from) {
+                    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(now - intended).count();
+                    result.latency.record(static_cast<uint64_t>(std::max<long long>(micros, 0)));
+                    ++result.completed;
+                    if (conn.parser.status < 200 || conn.parser.status >= 300) {
+                        ++result.non_2xx;
+                    }
+                }
+                if (conn.parser.close) {
+                    eof = true;
+                    break;
+                }
+            }
+            if (eof) {
+                // Whatever was still outstanding will never be answered
+                result.io_errors += conn.in_flight.size();
+                close_connection(conn);
+            }
+        }
+
+        void fail(Connection &conn, uint64_t &counter) {
+            ++counter;
+            close_connection(conn);
+        }
+
+        void close_connection(Connection &conn) {
+            if (conn.fd >= 0) {
+                close(conn.fd);
+            }
+            conn.fd = -1;
+            conn.in.clear();
+            conn.out.clear();
+            conn.out_offset = 0;
+            conn.in_flight.clear();
+        }
+    };
+
+    std::vector<Target> parse_mix(const std::string &spec) {
+        // "/:1,/echo/abc:4,POST /files/x:1"
+        std::vector<Target> mix;
+        std::istringstream items(spec);
+        std::string item;
+        while (std::getline(items, item, ',')) {
+            Target target{item, 1};
+            size_t colon = item.rfind(':');
+            if (colon != std::string::npos && colon + 1 < item.size() &&
+                item.find_first_not_of("0123456789", colon + 1) == std::string::npos) {
+                target.path = item.substr(0, colon);
+                target.weight = static_cast<unsigned>(std::stoul(item.substr(colon + 1)));
+            }
+            size_t space = target.path.find(' ');
+            if (space != std::string::npos) {
+                target.method = target.path.substr(0, space);
+                target.path = target.path.substr(space + 1);
+            }
+            if (target.weight > 0) {
+                mix.push_back(target);
+            }
+        }
+        if (mix.empty()) {
+            throw std::invalid_argument("--mix needs at least one path with a non-zero weight");
+        }
+        return mix;
+    }
+
+    Options parse_options(int argc, char **argv) {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto value = [&](const std::string &name) -> std::string {
+                if (arg.rfind(name + "=", 0) == 0) {
+                    return arg.substr(name.size() + 1);
+                }
+                if (i + 1 < argc) {
+                    return argv[++i];
+                }
+                throw std::invalid_argument(name + " requires a value");
+            };
+            auto is = [&](const std::string &name) {
+                return arg == name || arg.rfind(name + "=", 0) == 0;
+            };
+
+            if (is("--host")) options.host = value("--host");
+            else if (is("--port")) options.port = static_cast<uint16_t>(std::stoul(value("--port")));
+            else if (is("--threads")) options.threads = static_cast<unsigned>(std::stoul(value("--threads")));
+            else if (is("--connections")) options.connections = static_cast<unsigned>(std::stoul(value("--connections")));
+            else if (is("--duration")) options.duration = std::stod(value("--duration"));
+            else if (is("--warmup")) options.warmup = std::stod(value("--warmup"));
+            else if (is("--rate")) options.rate = std::stod(value("--rate"));
+            else if (is("--pipeline")) options.pipeline = std::max(1u, static_cast<unsigned>(std::stoul(value("--pipeline"))));
+            else if (is("--timeout-ms")) options.timeout_ms = std::stoi(value("--timeout-ms"));
+            else if (is("--mix")) options.mix = parse_mix(value("--mix"));
+            else if (is("--server")) options.server_binary = value("--server");
+            else if (is("--json")) options.json_path = value("--json");
+            else if (arg == "--no-keep-alive") options.keep_alive = false;
+            else if (arg == "--help" || arg == "-h") {
+                std::cout <<
+                    "usage: loadgen [options]\n"
+                    "  --host ADDR          server address (127.0.0.1)\n"
+                    "  --port N             server port (4221)\n"
+                    "  --threads N          generator threads (hardware concurrency)\n"
+                    "  --connections N      open connections, spread over threads (16)\n"
+                    "  --duration SEC       measured duration (10)\n"
+                    "  --warmup SEC         unrecorded warm-up before measuring (1)\n"
+                    "  --rate RPS           total target rate; omit for max throughput\n"
+                    "  --pipeline N         requests written back to back per connection (1)\n"
+                    "  --no-keep-alive      one request per connection\n"
+                    "  --mix SPEC           weighted paths, e.g. '/:1,/echo/hi:4,/user-agent:2'\n"
+                    "  --server PATH        start this server binary on --port for the run\n"
+                    "  --json PATH          also write the summary as JSON\n";
+                std::exit(0);
+            } else {
+                throw std::invalid_argument("Unknown option: " + arg);
+            }
+        }
+        options.threads = std::max(1u, std::min(options.threads, options.connections));
+        return options;
+    }
+
+    // Starts the server under test with a scratch directory holding the /files target
+    class LocalServer {
+    public:
+        LocalServer(const Options &options) {
+            directory = std::filesystem::temp_directory_path() / ("http_server_loadgen_" + std::to_string(getpid()));
+            std::filesystem::create_directories(directory);
+            std::ofstream(directory / "loadgen.bin", std::ios::binary) << std::string(4096, 'x');
+
+            pid = fork();
+            if (pid < 0) {
+                throw std::runtime_error("fork failed: " + std::string(strerror(errno)));
+            }
+            if (pid == 0) {
+                // The server logs every request; keep that out of the measurement
+                int null_fd = open("/dev/null", O_WRONLY);
+                dup2(null_fd, STDOUT_FILENO);
+                dup2(null_fd, STDERR_FILENO);
+                std::string port_arg = "--port=" + std::to_string(options.port);
+                std::string dir = directory.string();
+                execl(options.server_binary.c_str(), options.server_binary.c_str(),
+                      port_arg.c_str(), "--directory", dir.c_str(), static_cast<char *>(nullptr));
+                _exit(127);
+            }
+        }
+
+        ~LocalServer() {
+            if (pid > 0) {
+                kill(pid, SIGTERM);
+                waitpid(pid, nullptr, 0);
+            }
+            std::error_code ec;
+            std::filesystem::remove_all(directory, ec);
+        }
+
+    private:
+        pid_t pid = -1;
+        std::filesystem::path directory;
+    };
+
+    void wait_until_listening(const sockaddr_in &address) {
+        auto deadline = Clock::now() + std::chrono::seconds(5);
+        while (Clock::now() < deadline) {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            bool ok = connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0;
+            close(fd);
+            if (ok) {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        throw std::runtime_error("server did not start listening within 5 seconds");
+    }
+
+    void report(const Options &options, const ThreadResult &total, double seconds) {
+        const LatencyHistogram &raw = total.latency;
+        // Paced runs are measured from the schedule already; closed runs need the correction
+        LatencyHistogram corrected = options.rate > 0 ? raw : raw.corrected(static_cast<uint64_t>(raw.mean()));
+        const double percentiles[] = {50, 75, 90, 99, 99.9, 99.99};
+        double rps = static_cast<double>(total.completed) / seconds;
+
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << "Requests:      " << total.completed << " in " << seconds << "s\n"
+                  << "Throughput:    " << rps << " req/s, "
+                  << static_cast<double>(total.bytes_read) / seconds / (1024 * 1024) << " MiB/s read\n"
+                  << "Errors:        connect " << total.connect_errors << ", io " << total.io_errors
+                  << ", timeout " << total.timeouts << ", non-2xx " << total.non_2xx << "\n"
+                  << "Latency (us, " << (options.rate > 0 ? "schedule-based" : "CO-corrected") << ")\n";
+        for (double p : percentiles) {
+            std::cout << "  p" << std::setw(6) << std::left << p << std::right << std::setw(10) << corrected.percentile(p) << "\n";
+        }
+        std::cout << "  max    " << std::setw(10) << corrected.max() << "\n";
+        if (options.rate <= 0) {
+            std::cout << "  (uncorrected p99 " << raw.percentile(99) << ", mean " << raw.mean() << ")\n";
+        }
+
+        if (!options.json_path.empty()) {
+            std::ofstream json(options.json_path);
+            json << std::fixed << std::setprecision(2) << "{\n"
+                 << "  \"connections\": " << options.connections << ",\n"
+                 << "  \"threads\": " << options.threads << ",\n"
+                 << "  \"pipeline\": " << options.pipeline << ",\n"
+                 << "  \"keep_alive\": " << (options.keep_alive ? "true" : "false") << ",\n"
+                 << "  \"target_rate\": " << options.rate << ",\n"
+                 << "  \"duration_s\": " << seconds << ",\n"
+                 << "  \"requests\": " << total.completed << ",\n"
+                 << "  \"rps\": " << rps << ",\n"
+                 << "  \"errors\": {\"connect\": " << total.connect_errors << ", \"io\": " << total.io_errors
+                 << ", \"timeout\": " << total.timeouts << ", \"non_2xx\": " << total.non_2xx << "},\n"
+                 << "  \"latency_us\": {";
+            for (double p : percentiles) {
+                json << "\"p" << p << "\": " << corrected.percentile(p) << ", ";
+            }
+            json << "\"max\": " << corrected.max() << ", \"uncorrected_mean\": " << raw.mean() << "}\n}\n";
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    try {
+        Options options = parse_options(argc, argv);
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(options.port);
+        if (inet_pton(AF_INET, options.host.c_str(), &address.sin_addr) != 1) {
+            throw std::invalid_argument("--host must be an IPv4 address: " + options.host);
+        }
+
+        std::unique_ptr<LocalServer> local_server;
+        if (!options.server_binary.empty()) {
+            local_server = std::make_unique<LocalServer>(options);
+        }
+        wait_until_listening(address);
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        for (unsigned t = 0; t < options.threads; ++t) {
+            unsigned share = options.connections / options.threads + (t < options.connections % options.threads ? 1 : 0);
+            workers.push_back(std::make_unique<Worker>(options, address, share, 0x9E3779B9u * (t + 1)));
+        }
+
+        auto start = Clock::now();
+        auto record_from = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.warmup));
+        auto stop = record_from + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.duration));
+
+        std::vector<std::thread> threads;
+        std::atomic<bool> failed{false};
+        for (auto &worker : workers) {
+            threads.emplace_back([&, w = worker.get()] {
+                try {
+                    w->run(start, record_from, stop);
+                } catch (const std::exception &e) {
+                    std::cerr << "Worker error: " << e.what() << std::endl;
+                    failed = true;
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        ThreadResult total;
+        for (auto &worker : workers) {
+            const ThreadResult &r = worker->results();
+            total.latency.merge(r.latency);
+            total.completed += r.completed;
+            total.non_2xx += r.non_2xx;
+            total.connect_errors += r.connect_errors;
+            total.io_errors += r.io_errors;
+            total.timeouts += r.timeouts;
+            total.bytes_read += r.bytes_read;
+        }
+        report(options, total, std::chrono::duration<double>(stop - record_from).count());
+        return failed ? 1 : 0;
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
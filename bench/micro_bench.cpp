@@ -0,0 +1,340 @@
+#include <http_server/request.hpp>
+#include <http_server/response.hpp>
+#include <http_server/router.hpp>
+#include <http_server/client_limits.hpp>
+#include <http_server/chunked.hpp>
+#include <http_server/trace.hpp>
+#include <http_server/websocket/frame.hpp>
+#include <http_server/sse.hpp>
+#include <http_server/compression/gzip.hpp>
+#include <utils/buffer_pool.hpp>
+#include <utils/file_utils.hpp>
+#include <utils/mmap_cache.hpp>
+#include <utils/path_validation.hpp>
+#include <benchmark/benchmark.h>
+#include <algorithm>        // std::min
+#include <cstdio>           // snprintf()
+#include <filesystem>       // std::filesystem
+#include <fstream>          // std::ofstream
+#include <memory>           // std::make_shared
+#include <string>           // std::string
+#include <sys/socket.h>     // socketpair()
+#include <unistd.h>         // getpid(), close()
+#include <vector>           // std::vector
+
+namespace {
+    // What curl sends by default
+    const std::string MINIMAL_REQUEST =
+        "GET /echo/hello HTTP/1.1\r\n"
+        "Host: localhost:4221\r\n"
+        "User-Agent: curl/7.88.1\r\n"
+        "Accept: */*\r\n"
+        "\r\n";
+
+    // A typical desktop browser navigation
+    const std::string BROWSER_REQUEST =
+        "GET /files/index.html HTTP/1.1\r\n"
+        "Host: localhost:4221\r\n"
+        "Connection: keep-alive\r\n"
+        "Cache-Control: max-age=0\r\n"
+        "Upgrade-Insecure-Requests: 1\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+        "Sec-Fetch-Site: none\r\n"
+        "Sec-Fetch-Mode: navigate\r\n"
+        "Sec-Fetch-User: ?1\r\n"
+        "Sec-Fetch-Dest: document\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Accept-Language: en-US,en;q=0.9\r\n"
+        "Cookie: session=6f1c2a9e0b7d4c3f8a5e; theme=dark; tz=Europe%2FBerlin\r\n"
+        "If-None-Match: \"5e1f-63a2b1c0\"\r\n"
+        "\r\n";
+
+    // Upload with a small body
+    const std::string POST_REQUEST =
+        "POST /files/upload.bin HTTP/1.1\r\n"
+        "Host: localhost:4221\r\n"
+        "User-Agent: python-requests/2.31.0\r\n"
+        "Accept-Encoding: gzip, deflate\r\n"
+        "Accept: */*\r\n"
+        "Connection: keep-alive\r\n"
+        "Content-Type: application/octet-stream\r\n"
+        "Content-Length: 64\r\n"
+        "\r\n" +
+        std::string(64, 'x');
+
+    std::string compressible_text(std::size_t size) {
+        static const std::string words = "the quick brown fox jumps over the lazy dog 0123456789 ";
+        std::string text;
+        text.reserve(size);
+        while (text.size() < size) {
+            text += words;
+        }
+        text.resize(size);
+        return text;
+    }
+
+    // Scratch directory shared by the file benchmarks, removed at exit
+    const std::filesystem::path &scratch_dir() {
+        static struct Scratch {
+            std::filesystem::path path;
+            Scratch() {
+                path = std::filesystem::temp_directory_path() / ("http_server_bench_" + std::to_string(getpid()));
+                std::filesystem::create_directories(path);
+            }
+            ~Scratch() {
+                std::error_code ec;
+                std::filesystem::remove_all(path, ec);
+            }
+        } scratch;
+        return scratch.path;
+    }
+
+    std::string scratch_file(std::size_t size) {
+        std::filesystem::path path = scratch_dir() / ("file_" + std::to_string(size));
+        if (!std::filesystem::exists(path)) {
+            std::ofstream out(path, std::ios::binary);
+            std::string data = compressible_text(size);
+            out.write(data.data(), data.size());
+        }
+        return path.string();
+    }
+}
+
+static void BM_ParseRequest(benchmark::State &state, const std::string &raw) {
+    for (auto _ : state) {
+        http_server::HTTP_Request request = http_server::parse_request(raw);
+        benchmark::DoNotOptimize(request);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * raw.size()));
+}
+BENCHMARK_CAPTURE(BM_ParseRequest, minimal, MINIMAL_REQUEST);
+BENCHMARK_CAPTURE(BM_ParseRequest, browser, BROWSER_REQUEST);
+BENCHMARK_CAPTURE(BM_ParseRequest, post_with_body, POST_REQUEST);
+
+// Routes are tried in registration order, so the first and last route bound the cost
+static void BM_RouterDispatch(benchmark::State &state, bool match_last) {
+    const int route_count = static_cast<int>(state.range(0));
+    http_server::Router router;
+    for (int i = 0; i < route_count; ++i) {
+        router.add_route("GET", "/r" + std::to_string(i) + "/:id", [](const http_server::HTTP_Request &, const http_server::Params &) {
+            return http_server::HTTP_Response{200, "OK", {}, ""};
+        });
+    }
+    http_server::HTTP_Request request;
+    request.method = "GET";
+    request.version = "HTTP/1.1";
+    request.path = "/r" + std::to_string(match_last ? route_count - 1 : 0) + "/42";
+
+    for (auto _ : state) {
+        http_server::HTTP_Response response = router.dispatch(request);
+        benchmark::DoNotOptimize(response);
+    }
+}
+BENCHMARK_CAPTURE(BM_RouterDispatch, first_route, false)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK_CAPTURE(BM_RouterDispatch, last_route, true)->Arg(10)->Arg(100)->Arg(1000);
+
+static void BM_RouterDispatchNotFound(benchmark::State &state) {
+    const int route_count = static_cast<int>(state.range(0));
+    http_server::Router router;
+    for (int i = 0; i < route_count; ++i) {
+        router.add_route("GET", "/r" + std::to_string(i) + "/:id", [](const http_server::HTTP_Request &, const http_server::Params &) {
+            return http_server::HTTP_Response{200, "OK", {}, ""};
+        });
+    }
+    http_server::HTTP_Request request;
+    request.method = "GET";
+    request.version = "HTTP/1.1";
+    request.path = "/missing/42";
+
+    for (auto _ : state) {
+        http_server::HTTP_Response response = router.dispatch(request);
+        benchmark::DoNotOptimize(response);
+    }
+}
+BENCHMARK(BM_RouterDispatchNotFound)->Arg(10)->Arg(100)->Arg(1000);
+
+static void BM_ResponseToString(benchmark::State &state) {
+    http_server::HTTP_Response response{
+        200,
+        "OK",
+        {
+            {"Content-Type", "text/plain"},
+            {"Content-Encoding", "gzip"},
+            {"Connection", "keep-alive"},
+            {"X-Request-Id", "0f8e2c1a-5b7d-4e3f-9a6c-2d1b0e8f7a6c"},
+        },
+        compressible_text(static_cast<std::size_t>(state.range(0)))
+    };
+    for (auto _ : state) {
+        std::string wire = response.to_string();
+        benchmark::DoNotOptimize(wire);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * state.range(0)));
+}
+BENCHMARK(BM_ResponseToString)->Arg(0)->Arg(64)->Arg(4 << 10)->Arg(64 << 10);
+
+static void BM_GzipCompress(benchmark::State &state) {
+    http_server::compression::GzipCompressor gzip;
+    std::string data = compressible_text(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        auto compressed = gzip.compress(data);
+        benchmark::DoNotOptimize(compressed);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * data.size()));
+}
+BENCHMARK(BM_GzipCompress)->Arg(64)->Arg(1 << 10)->Arg(16 << 10)->Arg(256 << 10);
+
+static void BM_ValidateFilePath(benchmark::State &state, bool existing) {
+    std::string root = scratch_dir().string();
+    std::string name = existing ? std::filesystem::path(scratch_file(1024)).filename().string() : "not_created_yet.bin";
+    for (auto _ : state) {
+        std::string path = http_server::path_validation::validate_file_path(root, name);
+        benchmark::DoNotOptimize(path);
+    }
+}
+BENCHMARK_CAPTURE(BM_ValidateFilePath, existing_file, true);
+BENCHMARK_CAPTURE(BM_ValidateFilePath, new_file, false);
+
+static void BM_ReadFile(benchmark::State &state) {
+    std::string path = scratch_file(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        auto content = http_server::file_utils::read_file(path);
+        benchmark::DoNotOptimize(content);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * state.range(0)));
+}
+BENCHMARK(BM_ReadFile)->Arg(1 << 10)->Arg(64 << 10)->Arg(1 << 20);
+
+// Upload replacing a file, one target per thread. Durable saves share syncs across the
+// threads; point TMPDIR at a real disk, as tmpfs makes syncing free.
+static void BM_SaveFile(benchmark::State &state, bool durable) {
+    std::string path = (scratch_dir() / ("upload_" + std::to_string(state.thread_index()))).string();
+    std::string data = compressible_text(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        http_server::file_utils::save_file(path, data, durable);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * state.range(0)));
+}
+BENCHMARK_CAPTURE(BM_SaveFile, buffered, false)->Arg(4 << 10)->Threads(1)->Threads(16)->UseRealTime();
+BENCHMARK_CAPTURE(BM_SaveFile, durable, true)->Arg(4 << 10)->Threads(1)->Threads(16)->UseRealTime();
+
+// Cache hit: a stat() to revalidate and a shared_ptr copy, independent of file size
+static void BM_MmapCacheGet(benchmark::State &state) {
+    std::string path = scratch_file(static_cast<std::size_t>(state.range(0)));
+    http_server::file_utils::MmapCache cache(64 << 20);
+    for (auto _ : state) {
+        auto mapped = cache.get(path);
+        benchmark::DoNotOptimize(mapped);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * state.range(0)));
+}
+BENCHMARK(BM_MmapCacheGet)->Arg(64 << 10)->Arg(1 << 20);
+
+// Per-request admission check; threads hammer distinct clients that share shards
+static void BM_ClientLimiterRequest(benchmark::State &state) {
+    static http_server::ClientLimiter limiter({0, 1e9, 1000});
+    uint32_t ip = 0x0100007f + (static_cast<uint32_t>(state.thread_index()) << 24);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(limiter.try_request(ip));
+    }
+}
+BENCHMARK(BM_ClientLimiterRequest)->Threads(1)->Threads(8);
+
+// Borrow and return a read buffer, as each socket read does; served from the thread cache
+static void BM_BufferPoolAcquire(benchmark::State &state) {
+    for (auto _ : state) {
+        auto buffer = http_server::buffer_pool::acquire(16 << 10);
+        benchmark::DoNotOptimize(buffer.data());
+    }
+}
+BENCHMARK(BM_BufferPoolAcquire)->Threads(1)->Threads(8);
+
+// Decode a chunked upload arriving in 16K reads, as the server feeds it to a handler
+static void BM_ChunkedDecode(benchmark::State &state) {
+    const size_t chunk_size = static_cast<size_t>(state.range(0));
+    std::string encoded;
+    char size_line[20];
+    for (size_t sent = 0; sent < (1 << 20); sent += chunk_size) {
+        encoded.append(size_line, snprintf(size_line, sizeof(size_line), "%zx\r\n", chunk_size));
+        encoded.append(chunk_size, 'x');
+        encoded += "\r\n";
+    }
+    encoded += "0\r\n\r\n";
+
+    for (auto _ : state) {
+        http_server::ChunkedDecoder decoder;
+        size_t decoded = 0;
+        http_server::BodySink sink = [&](const char *, size_t length) {
+            decoded += length;
+            return true;
+        };
+        std::string_view input = encoded;
+        while (!decoder.done()) {
+            size_t length = std::min<size_t>(input.size(), 16 << 10);
+            input.remove_prefix(decoder.decode(input.substr(0, length), sink));
+        }
+        benchmark::DoNotOptimize(decoded);
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(encoded.size()));
+}
+BENCHMARK(BM_ChunkedDecode)->Arg(256)->Arg(16 << 10);
+
+// Per-request tracing overhead with one request in N sampled; 0 is tracing off
+static void BM_TraceRequest(benchmark::State &state) {
+    http_server::trace::set_sampling(static_cast<uint32_t>(state.range(0)));
+    for (auto _ : state) {
+        http_server::trace::Request traced;
+        for (const char *phase : {"recv", "parse", "dispatch", "handler", "send"}) {
+            http_server::trace::Span span(phase);
+            benchmark::ClobberMemory();
+        }
+    }
+    http_server::trace::set_sampling(0);
+}
+BENCHMARK(BM_TraceRequest)->Arg(0)->Arg(100)->Arg(1);
+
+// Unmask a client frame payload in place, misaligned as it sits after the frame header
+static void BM_WebSocketUnmask(benchmark::State &state) {
+    const size_t length = static_cast<size_t>(state.range(0));
+    std::string frame(length + 6, 'x');
+    const uint8_t mask[4] = {0x37, 0xfa, 0x21, 0x3d};
+    for (auto _ : state) {
+        http_server::websocket::apply_mask(frame.data() + 6, length, mask);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(length));
+}
+BENCHMARK(BM_WebSocketUnmask)->Arg(125)->Arg(4 << 10)->Arg(64 << 10);
+
+// Publish a small event to N subscribers over socketpairs, and read it on every client end
+static void BM_SseBroadcast(benchmark::State &state) {
+    const int subscribers = static_cast<int>(state.range(0));
+    auto broadcaster = std::make_shared<http_server::sse::Broadcaster>();
+    std::vector<int> clients;
+    for (int i = 0; i < subscribers; ++i) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+            state.SkipWithError("socketpair failed");
+            return;
+        }
+        broadcaster->subscribe("bench", fds[0], "bench");
+        clients.push_back(fds[1]);
+    }
+    http_server::sse::Event event{std::string(128, 'x'), "tick"};
+    char buffer[4096];
+    for (auto _ : state) {
+        broadcaster->publish("bench", event);
+        for (int client : clients) {
+            while (recv(client, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {}
+        }
+    }
+    // Closing the client ends lets the subscribers unsubscribe and close theirs
+    for (int client : clients) {
+        close(client);
+    }
+    state.SetItemsProcessed(state.iterations() * subscribers);
+}
+BENCHMARK(BM_SseBroadcast)->Arg(16)->Arg(1024);
+
+BENCHMARK_MAIN();
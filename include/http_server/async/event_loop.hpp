@@ -0,0 +1,171 @@
+#ifndef ASYNC_EVENT_LOOP_HPP
+#define ASYNC_EVENT_LOOP_HPP
+
+#include <http_server/async/task.hpp>   // Task
+#include <chrono>                       // std::chrono
+#include <cstdint>                      // uint32_t
+#include <condition_variable>           // std::condition_variable
+#include <coroutine>                    // std::coroutine_handle
+#include <deque>                        // std::deque
+#include <exception>                    // std::exception_ptr
+#include <functional>                   // std::function
+#include <map>                          // std::multimap
+#include <mutex>                        // std::mutex
+#include <optional>                     // std::optional
+#include <thread>                       // std::thread
+#include <type_traits>                  // std::invoke_result_t
+#include <unordered_map>                // std::unordered_map
+#include <vector>                       // std::vector
+
+namespace http_server::async {
+    using Clock = std::chrono::steady_clock;
+
+    // epoll reactor that resumes coroutines waiting on timers and fd readiness,
+    // plus a small worker pool for blocking calls (regular files, resolver).
+    // Everything is resumed on the loop thread.
+    class EventLoop {
+    public:
+        EventLoop(size_t worker_count = 4);
+        ~EventLoop();
+        EventLoop(const EventLoop &) = delete;
+        EventLoop &operator=(const EventLoop &) = delete;
+
+        // Process-wide loop, started on first use
+        static EventLoop &instance();
+
+        bool in_loop_thread() const { return std::this_thread::get_id() == loop_thread.get_id(); }
+
+        // Resume 'handle' on the loop thread
+        void schedule(std::coroutine_handle<> handle);
+
+        struct SleepAwaiter;
+        struct IoAwaiter;
+        template <typename Fn>
+        struct OffloadAwaiter;
+
+        SleepAwaiter sleep_until(Clock::time_point deadline);
+        // Resolves to false if 'timeout' passed before 'fd' became ready
+        IoAwaiter wait_fd(int fd, uint32_t events, std::chrono::milliseconds timeout);
+        // Run 'fn' on a worker thread and resume with its result
+        template <typename Fn>
+        OffloadAwaiter<Fn> offload(Fn fn);
+
+    private:
+        struct Waiter {
+            std::coroutine_handle<> handle;
+            int fd = -1;
+            uint32_t events = 0;
+            bool timed_out = false;
+            bool has_timer = false;
+            std::multimap<Clock::time_point, Waiter *>::iterator timer;
+        };
+
+        int epoll_fd = -1;
+        int wake_fd = -1;           // eventfd that interrupts epoll_wait
+        std::thread loop_thread;
+        bool stopping = false;
+
+        std::mutex mutex;           // guards everything below
+        std::vector<std::coroutine_handle<>> ready;
+        std::multimap<Clock::time_point, Waiter *> timers;
+        // One reader and one writer may wait on an fd at the same time
+        struct FdWaiters {
+            Waiter *reader = nullptr;
+            Waiter *writer = nullptr;
+        };
+        std::unordered_map<int, FdWaiters> io_waiters;
+
+        std::mutex work_mutex;
+        std::condition_variable work_available;
+        std::deque<std::function<void()>> work;
+        std::vector<std::thread> workers;
+
+        void run();
+        void wake();
+        void add_timer(Waiter &waiter, Clock::time_point deadline);
+        // Registers the fd and its optional timeout atomically, since either may resume the waiter
+        void add_io(Waiter &waiter, int fd, uint32_t events, std::chrono::milliseconds timeout);
+        // Re-arm 'fd' for whichever waiters remain, or drop it from epoll; 'mutex' must be held
+        void rearm(int fd, FdWaiters &waiters);
+        void submit(std::function<void()> job);
+        void worker_main();
+
+    public:
+        struct SleepAwaiter {
+            EventLoop &loop;
+            Clock::time_point deadline;
+            Waiter waiter{};
+
+            bool await_ready() const { return deadline <= Clock::now(); }
+            void await_suspend(std::coroutine_handle<> handle) {
+                waiter.handle = handle;
+                loop.add_timer(waiter, deadline);
+            }
+            void await_resume() const noexcept {}
+        };
+
+        struct IoAwaiter {
+            EventLoop &loop;
+            int fd;
+            uint32_t events;
+            std::chrono::milliseconds timeout;
+            Waiter waiter{};
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) {
+                waiter.handle = handle;
+                loop.add_io(waiter, fd, events, timeout);
+            }
+            bool await_resume() const noexcept { return !waiter.timed_out; }
+        };
+
+        template <typename Fn>
+        struct OffloadAwaiter {
+            using Result = std::invoke_result_t<Fn &>;
+
+            EventLoop &loop;
+            Fn fn;
+            std::conditional_t<std::is_void_v<Result>, bool, std::optional<Result>> result{};
+            std::exception_ptr error = {};
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) {
+                loop.submit([this, handle] {
+                    try {
+                        if constexpr (std::is_void_v<Result>) {
+                            fn();
+                        } else {
+                            result.emplace(fn());
+                        }
+                    } catch (...) {
+                        error = std::current_exception();
+                    }
+                    loop.schedule(handle);
+                });
+            }
+            Result await_resume() {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+                if constexpr (!std::is_void_v<Result>) {
+                    return std::move(*result);
+                }
+            }
+        };
+    };
+
+    template <typename Fn>
+    EventLoop::OffloadAwaiter<Fn> EventLoop::offload(Fn fn) {
+        return OffloadAwaiter<Fn>{*this, std::move(fn)};
+    }
+
+    // Awaitables on the process-wide loop
+    EventLoop::SleepAwaiter sleep_for(std::chrono::milliseconds duration);
+    EventLoop::IoAwaiter wait_readable(int fd, std::chrono::milliseconds timeout = std::chrono::milliseconds(-1));
+    EventLoop::IoAwaiter wait_writable(int fd, std::chrono::milliseconds timeout = std::chrono::milliseconds(-1));
+
+    // Start 'task' without waiting for it; exceptions are logged and dropped
+    void spawn(Task<void> task);
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef ASYNC_IO_HPP
+#define ASYNC_IO_HPP
+
+#include <http_server/async/task.hpp>   // Task
+#include <chrono>                       // std::chrono::milliseconds
+#include <cstdint>                      // uint16_t
+#include <optional>                     // std::optional
+#include <stdexcept>                    // std::runtime_error
+#include <string>                       // std::string
+#include <string_view>                  // std::string_view
+
+// Socket and file I/O for coroutine handlers. Sockets may be blocking: reads and
+// writes use MSG_DONTWAIT and wait on the event loop when they would block.
+// A negative timeout waits forever.
+namespace http_server::async {
+    class TimeoutError : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // Read up to 'length' bytes; 0 at end of stream
+    Task<size_t> recv_some(int fd, char *buffer, size_t length, std::chrono::milliseconds timeout);
+
+    // Write all of 'data', which must stay alive until the task completes
+    Task<void> send_all(int fd, std::string_view data, std::chrono::milliseconds timeout);
+
+    // Open a non-blocking TCP connection; the caller owns the returned fd
+    Task<int> connect(std::string host, uint16_t port, std::chrono::milliseconds timeout);
+
+    // Read a whole file on a worker thread; nullopt if it can't be read
+    Task<std::optional<std::string>> read_file(std::string path);
+}
+
+#endif
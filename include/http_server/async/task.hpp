@@ -0,0 +1,153 @@
+#ifndef ASYNC_TASK_HPP
+#define ASYNC_TASK_HPP
+
+#include <coroutine>    // std::coroutine_handle, std::suspend_always
+#include <exception>    // std::exception_ptr
+#include <future>       // std::promise
+#include <optional>     // std::optional
+#include <type_traits>  // std::is_void_v
+#include <utility>      // std::exchange
+
+namespace http_server::async {
+    template <typename T>
+    class Task;
+
+    namespace task_detail {
+        // Resumes whoever co_awaited the task once it finishes
+        struct FinalAwaiter {
+            bool await_ready() const noexcept { return false; }
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) const noexcept {
+                if (auto continuation = handle.promise().continuation) {
+                    return continuation;
+                }
+                return std::noop_coroutine();
+            }
+            void await_resume() const noexcept {}
+        };
+
+        struct PromiseBase {
+            std::coroutine_handle<> continuation;
+            std::exception_ptr error;
+
+            std::suspend_always initial_suspend() const noexcept { return {}; }
+            FinalAwaiter final_suspend() const noexcept { return {}; }
+            void unhandled_exception() noexcept { error = std::current_exception(); }
+        };
+
+        template <typename T>
+        struct Promise : PromiseBase {
+            std::optional<T> value;
+
+            Task<T> get_return_object() noexcept;
+            template <typename U>
+            void return_value(U &&result) { value.emplace(std::forward<U>(result)); }
+
+            T take() {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+                return std::move(*value);
+            }
+        };
+
+        template <>
+        struct Promise<void> : PromiseBase {
+            Task<void> get_return_object() noexcept;
+            void return_void() const noexcept {}
+
+            void take() const {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+        };
+    }
+
+    // Lazily started coroutine producing a T. Awaiting it starts the body and
+    // resumes the awaiting coroutine when it returns; exceptions propagate.
+    template <typename T = void>
+    class [[nodiscard]] Task {
+    public:
+        using promise_type = task_detail::Promise<T>;
+
+        Task() = default;
+        explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+        Task(Task &&other) noexcept : handle(std::exchange(other.handle, {})) {}
+        Task &operator=(Task &&other) noexcept {
+            if (this != &other) {
+                if (handle) {
+                    handle.destroy();
+                }
+                handle = std::exchange(other.handle, {});
+            }
+            return *this;
+        }
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+        ~Task() {
+            if (handle) {
+                handle.destroy();
+            }
+        }
+
+        bool await_ready() const noexcept { return !handle || handle.done(); }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+            handle.promise().continuation = awaiting;
+            return handle;
+        }
+        T await_resume() { return handle.promise().take(); }
+
+    private:
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    template <typename T>
+    Task<T> task_detail::Promise<T>::get_return_object() noexcept {
+        return Task<T>{std::coroutine_handle<Promise<T>>::from_promise(*this)};
+    }
+
+    inline Task<void> task_detail::Promise<void>::get_return_object() noexcept {
+        return Task<void>{std::coroutine_handle<Promise<void>>::from_promise(*this)};
+    }
+
+    namespace task_detail {
+        // Eagerly started, self-destroying coroutine used to drive a Task to completion
+        struct Detached {
+            struct promise_type {
+                Detached get_return_object() const noexcept { return {}; }
+                std::suspend_never initial_suspend() const noexcept { return {}; }
+                std::suspend_never final_suspend() const noexcept { return {}; }
+                void return_void() const noexcept {}
+                void unhandled_exception() const noexcept { std::terminate(); }
+            };
+        };
+
+        template <typename T>
+        Detached complete_into(Task<T> task, std::promise<T> result) {
+            try {
+                if constexpr (std::is_void_v<T>) {
+                    co_await task;
+                    result.set_value();
+                } else {
+                    result.set_value(co_await task);
+                }
+            } catch (...) {
+                result.set_exception(std::current_exception());
+            }
+        }
+    }
+
+    // Run 'task' and block the calling thread until it finishes. The task runs
+    // inline up to its first suspension and is resumed by the event loop after
+    // that. Must not be called from the event loop thread.
+    template <typename T>
+    T sync_wait(Task<T> task) {
+        std::promise<T> result;
+        auto future = result.get_future();
+        task_detail::complete_into(std::move(task), std::move(result));
+        return future.get();
+    }
+}
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef BODY_HPP
+#define BODY_HPP
+
+#include <cstddef>
+#include <functional>
+
+namespace http_server {
+    // Receives a streamed body piece by piece; returns false once the client is gone
+    using BodySink = std::function<bool(const char *data, size_t length)>;
+
+    // Produces a body that is not held in memory; returns false if it failed part way
+    using BodyStream = std::function<bool(const BodySink &sink)>;
+}
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <http_server/response.hpp> // HTTP_Response
+#include <chrono>                   // std::chrono
+#include <functional>               // std::function
+#include <future>                   // std::shared_future
+#include <list>                     // std::list
+#include <memory>                   // std::unique_ptr
+#include <mutex>                    // std::mutex
+#include <string>                   // std::string
+#include <unordered_map>            // std::unordered_map
+#include <vector>                   // std::vector
+
+namespace http_server {
+    // Per-route opt-in to the response cache
+    struct CachePolicy {
+        std::chrono::milliseconds ttl;
+        std::vector<std::string> vary;  // request headers whose values split the cache key
+    };
+
+    // Byte-bounded, sharded response cache with single-flight misses: while one
+    // request computes a response, identical requests wait for its result
+    // instead of running the handler again.
+    class ResponseCache {
+    public:
+        explicit ResponseCache(size_t max_bytes, size_t shard_count = 16);
+
+        using Compute = std::function<HTTP_Response()>;
+        HTTP_Response get_or_compute(const std::string &key, std::chrono::milliseconds ttl, const Compute &compute);
+
+        size_t size_bytes() const;
+        void clear();
+
+        // Only complete, successful, non-private responses are stored
+        static bool is_cacheable(const HTTP_Response &response);
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Entry {
+            HTTP_Response response;
+            Clock::time_point expires;
+            size_t bytes;
+            std::list<std::string>::iterator lru_position;
+        };
+
+        struct Shard {
+            mutable std::mutex mutex;
+            std::unordered_map<std::string, Entry> entries;
+            std::list<std::string> lru;     // most recently used first
+            std::unordered_map<std::string, std::shared_future<HTTP_Response>> in_flight;
+            size_t bytes = 0;
+        };
+
+        std::vector<std::unique_ptr<Shard>> shards;
+        size_t max_bytes_per_shard;
+
+        Shard &shard_for(const std::string &key);
+        void store(Shard &shard, const std::string &key, const HTTP_Response &response, std::chrono::milliseconds ttl);
+        static void erase(Shard &shard, std::unordered_map<std::string, Entry>::iterator it);
+        static size_t footprint(const std::string &key, const HTTP_Response &response);
+    };
+}
+
+#endif
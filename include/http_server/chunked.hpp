@@ -0,0 +1,61 @@
+#ifndef CHUNKED_HPP
+#define CHUNKED_HPP
+
+#include <http_server/body.hpp>     // BodySink
+#include <http_server/config.hpp>   // MAX_CHUNK_LINE, MAX_HEADER_SIZE, MAX_BODY_SIZE
+#include <http_server/headers.hpp>  // Headers
+#include <stdexcept>                // std::runtime_error
+#include <string>
+#include <string_view>
+
+namespace http_server {
+    // Malformed chunked framing or a body past its limits
+    class ChunkedError : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    struct ChunkedLimits {
+        size_t max_line = config::MAX_CHUNK_LINE;       // one chunk size line, extensions included
+        size_t max_trailers = config::MAX_HEADER_SIZE;  // whole trailer section
+        size_t max_body = config::MAX_BODY_SIZE;        // decoded bytes
+    };
+
+    // Incremental decoder for a chunked message body (RFC 9112 section 7.1). Input
+    // may be split anywhere; decoded bytes go to the sink as soon as they arrive,
+    // so nothing beyond the piece at hand is buffered.
+    class ChunkedDecoder {
+    public:
+        explicit ChunkedDecoder(ChunkedLimits limits = {});
+
+        // Consume 'input' up to the end of the body, or until 'sink' returns false.
+        // Returns the bytes used; whatever follows the body is left to the caller.
+        // Throws ChunkedError on bad framing or when a limit is exceeded.
+        size_t decode(std::string_view input, const BodySink &sink);
+
+        bool done() const { return state == State::DONE; }
+        // The sink refused more data; the decoder takes no further input
+        bool aborted() const { return sink_refused; }
+        size_t body_size() const { return total; }
+        const Headers &trailers() const { return trailer_headers; }
+
+    private:
+        enum class State { SIZE_LINE, DATA, DATA_END, TRAILER_LINE, DONE };
+
+        ChunkedLimits limits;
+        State state = State::SIZE_LINE;
+        std::string line;           // partial size, CRLF or trailer line carried between calls
+        size_t remaining = 0;       // bytes left in the current chunk
+        size_t total = 0;
+        size_t trailer_bytes = 0;
+        Headers trailer_headers;
+        bool sink_refused = false;
+
+        // Append input up to and including the next LF to 'line'; true once it is complete
+        bool take_line(std::string_view input, size_t &pos, size_t max, const char *what);
+        void parse_size_line();
+        void parse_trailer_line();
+    };
+}
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef CLIENT_LIMITS_HPP
+#define CLIENT_LIMITS_HPP
+
+#include <atomic>       // std::atomic
+#include <chrono>       // std::chrono
+#include <cstdint>      // uint32_t, uint64_t, int64_t
+#include <memory>       // std::unique_ptr
+#include <mutex>        // std::mutex
+#include <optional>     // std::optional
+#include <sys/socket.h> // sockaddr_storage
+
+namespace http_server {
+    struct ClientLimits {
+        uint32_t max_connections_per_ip = 0;    // concurrent connections; 0 disables
+        double requests_per_second = 0;         // sustained request rate per IP; 0 disables
+        uint32_t request_burst = 20;            // requests allowed back to back above the rate
+    };
+
+    // A peer as the limiter sees it: an IPv4 address in network byte order, or
+    // IPV6_CLIENT plus the /64 prefix of an IPv6 address folded to 32 bits.
+    // 0 (Unix sockets) is never limited.
+    using ClientKey = uint64_t;
+    inline constexpr ClientKey IPV6_CLIENT = ClientKey(1) << 32;
+
+    // An admitted connection; 'counted' is false when it holds no place in its client's
+    // count (limits off, or let through by a full table) and so has nothing to release
+    struct ClientConnection {
+        ClientKey client = 0;
+        bool counted = false;
+    };
+
+    // Per-client connection counts and request token buckets in fixed-size open-addressing
+    // tables, one for IPv4 addresses and one for IPv6 prefixes. Lookups and counting are
+    // lock-free. Claiming a slot for a new client takes a per-shard lock, so a key never
+    // holds two slots. Idle slots are reclaimed; when a probe window is full the client is
+    // let through.
+    class ClientLimiter {
+    public:
+        explicit ClientLimiter(ClientLimits limits, size_t capacity = 1 << 16);
+
+        static ClientKey client_key(const sockaddr_storage &address);
+
+        // Count a new connection from 'client'; nullopt if over the cap
+        std::optional<ClientConnection> try_acquire_connection(ClientKey client);
+        void release_connection(const ClientConnection &connection);
+
+        // Take a request token; on refusal returns how long until one is available
+        std::chrono::nanoseconds try_request(ClientKey client);
+
+        const ClientLimits &limits() const { return settings; }
+
+    private:
+        struct Slot {
+            // Key in the high half, open connections in the low half: one CAS moves both,
+            // so a slot changes hands only while no connection is counted on it. Key 0
+            // marks a free slot.
+            std::atomic<uint64_t> owner{0};
+            // Token bucket kept as GCRA's theoretical arrival time, so it fits one CAS
+            std::atomic<int64_t> arrival{0};
+        };
+
+        static constexpr size_t SHARD_COUNT = 16;
+        static constexpr size_t MAX_PROBE = 32;
+
+        struct Table {
+            std::unique_ptr<Slot[]> shards[SHARD_COUNT];
+            std::mutex claiming[SHARD_COUNT];
+        };
+
+        ClientLimits settings;
+        int64_t emission_interval;  // ns per token
+        int64_t burst_tolerance;    // ns the bucket may run ahead of now
+        size_t shard_size;
+        Table ipv4;
+        Table ipv6;
+
+        Table &table_for(ClientKey client) { return (client & IPV6_CLIENT) ? ipv6 : ipv4; }
+        // Slot owned by 'client', claiming a free or idle one if needed; nullptr if none is left
+        Slot *acquire_slot(ClientKey client, int64_t now);
+        Slot *find_slot(Table &table, uint32_t key);
+        bool is_idle(const Slot &slot, int64_t now) const;
+        static int64_t now_ns();
+    };
+}
+
+#endif
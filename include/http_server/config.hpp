@@ -1,6 +1,7 @@
 #ifndef CONFIG_HPP
 #define CONFIG_HPP
 #include <cstdint>
+#include <cstddef>
 
 constexpr int BUF_LEN = 1024;
 constexpr int GZIP_BUF_LEN = 32768;
@@ -8,10 +9,36 @@ constexpr int GZIP_BUF_LEN = 32768;
 namespace http_server::config {
     inline constexpr int BUF_LEN                    = 1024;
     inline constexpr uint16_t DEFAULT_PORT          = 4221;
-    inline constexpr int CONNECTION_TIMEOUT         = 30; // seconds
+    inline constexpr int CONNECTION_TIMEOUT         = 30; // idle keep-alive seconds
     inline constexpr int BACKLOG_SIZE               = 10;
     inline constexpr int MAX_KEEP_ALIVE_REQUESTS    = 100;
+    inline constexpr size_t MAX_HEADER_SIZE         = 8192; // bytes before the blank line
+    inline constexpr size_t MAX_CHUNK_LINE          = 4096; // chunk size line, extensions included
+    inline constexpr size_t MAX_BODY_SIZE           = size_t(1) << 30; // request body, chunked or not
+    inline constexpr int LINGER_TIMEOUT_MS          = 2000;     // draining an unread body before closing
+    inline constexpr size_t LINGER_MAX_BYTES        = 1 << 20;  // unread body bytes discarded before closing anyway
     inline constexpr char DEFAULT_ROOT_PATH[]       = ".";
+    inline constexpr int HANDOFF_TIMEOUT            = 60;       // seconds for a replacement process to start serving
+    inline constexpr int DRAIN_TIMEOUT              = 30;       // seconds in-flight connections get after a handoff
+    inline constexpr int DRAIN_IDLE_MS              = 1000;     // keep-alive wait for a last request once draining
+    inline constexpr size_t MMAP_MIN_FILE_SIZE      = 64 << 10; // smaller files are read into memory
+    inline constexpr size_t MMAP_CACHE_BYTES        = 1 << 30;  // mapped address space kept by the cache
+    inline constexpr int GROUP_COMMIT_WINDOW_US     = 1000;     // extra wait for concurrent durable writes to share a sync
+    inline constexpr size_t GROUP_COMMIT_MAX_BATCH  = 256;      // files synced per round
+    inline constexpr size_t BUFFER_POOL_MAX_BYTES   = 32 << 20; // free I/O buffers kept for reuse
+    inline constexpr size_t BUFFER_POOL_THREAD_CACHE = 4;       // free buffers per size class per thread
+    inline constexpr size_t READ_BUFFER_SIZE        = 16 << 10; // borrowed for each socket read
+    inline constexpr size_t TRACE_RING_EVENTS       = 8192;     // spans kept, shared by every thread
+    inline constexpr size_t TRACE_THREAD_EVENTS     = 32;       // spans a thread batches before adding them
+    inline constexpr size_t WEBSOCKET_MAX_MESSAGE   = 16 << 20; // reassembled incoming message
+    inline constexpr size_t WEBSOCKET_MAX_BUFFERED  = 16 << 20; // queued outgoing bytes before the peer is dropped
+    inline constexpr int WEBSOCKET_SEND_TIMEOUT     = 30;       // seconds a write may stall
+    inline constexpr int WEBSOCKET_CLOSE_TIMEOUT    = 5;        // seconds to wait for the peer's close frame
+    inline constexpr size_t SSE_MAX_QUEUED          = 1 << 20;  // unsent event bytes before a subscriber is dropped
+    inline constexpr int SSE_SEND_TIMEOUT           = 30;       // seconds a write to a subscriber may stall
+    inline constexpr int TLS_HANDSHAKE_TIMEOUT      = 10;       // seconds
+    inline constexpr size_t TLS_SESSION_CACHE_SIZE  = 20480;    // sessions kept for resumption by ID
+    inline constexpr int SSE_HEARTBEAT_INTERVAL     = 15;       // seconds between comment lines keeping a stream open
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef HANDOFF_HPP
+#define HANDOFF_HPP
+
+#include <http_server/listener.hpp>    // Listener
+#include <string>                       // std::string
+#include <vector>                       // std::vector
+
+// Zero-downtime upgrades. A running server listens on a Unix control socket; a new process
+// started with --inherit-from connects to it and receives the listening sockets themselves
+// (SCM_RIGHTS), so the addresses stay bound and queued connections are never refused. Once
+// the new process is serving it says so, and the old one stops accepting and drains.
+namespace http_server::handoff {
+    struct Inherited {
+        std::vector<Listener> listeners;
+        int control_fd = -1;            // the old process's control socket
+        std::string control_path;
+        int connection = -1;            // to the old process, for ready()
+    };
+
+    // Bind a control socket at 'path', replacing a stale one; throws std::runtime_error
+    int open_control(const std::string &path);
+
+    // Old process, on a connection accepted from the control socket: send the listeners and
+    // the control socket, then wait up to 'timeout_ms' for the receiver to report it is
+    // serving. False, with nothing changed on this side, if it failed, left or timed out.
+    bool hand_over(int connection, const std::vector<Listener> &listeners, int control_fd,
+                   const std::string &control_path, int timeout_ms);
+
+    // New process: take the sockets of the server whose control socket is at 'path';
+    // throws std::runtime_error
+    Inherited inherit(const std::string &path, int timeout_ms);
+    // Tell the old process this one is accepting; closes 'connection'
+    void ready(int &connection);
+}
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef HEADERS_HPP
+#define HEADERS_HPP
+
+#include <array>            // std::array
+#include <cstdint>          // uint8_t, uint32_t, uint64_t
+#include <initializer_list> // std::initializer_list
+#include <optional>         // std::optional
+#include <string>           // std::string
+#include <string_view>      // std::string_view
+#include <utility>          // std::pair
+#include <vector>           // std::vector
+
+namespace http_server {
+    // Headers the server looks at on hot paths; each one owns a fixed slot in Headers.
+    enum class HTTP_HEADER : uint8_t {
+        ACCEPT,
+        ACCEPT_ENCODING,
+        ACCEPT_RANGES,
+        AUTHORIZATION,
+        CACHE_CONTROL,
+        CONNECTION,
+        CONTENT_ENCODING,
+        CONTENT_LENGTH,
+        CONTENT_RANGE,
+        CONTENT_TYPE,
+        COOKIE,
+        DATE,
+        ETAG,
+        EXPECT,
+        HOST,
+        HTTP2_SETTINGS,
+        IF_MODIFIED_SINCE,
+        IF_NONE_MATCH,
+        KEEP_ALIVE,
+        LAST_MODIFIED,
+        LOCATION,
+        ORIGIN,
+        RANGE,
+        REFERER,
+        RETRY_AFTER,
+        SERVER,
+        SET_COOKIE,
+        TRANSFER_ENCODING,
+        UPGRADE,
+        USER_AGENT,
+        VARY,
+        X_FORWARDED_FOR,
+        COUNT
+    };
+
+    namespace headers_detail {
+        inline constexpr std::size_t KNOWN_COUNT = static_cast<std::size_t>(HTTP_HEADER::COUNT);
+
+        // Canonical spelling, indexed by HTTP_HEADER
+        inline constexpr std::array<std::string_view, KNOWN_COUNT> KNOWN_NAMES = {
+            "Accept",
+            "Accept-Encoding",
+            "Accept-Ranges",
+            "Authorization",
+            "Cache-Control",
+            "Connection",
+            "Content-Encoding",
+            "Content-Length",
+            "Content-Range",
+            "Content-Type",
+            "Cookie",
+            "Date",
+            "ETag",
+            "Expect",
+            "Host",
+            "HTTP2-Settings",
+            "If-Modified-Since",
+            "If-None-Match",
+            "Keep-Alive",
+            "Last-Modified",
+            "Location",
+            "Origin",
+            "Range",
+            "Referer",
+            "Retry-After",
+            "Server",
+            "Set-Cookie",
+            "Transfer-Encoding",
+            "Upgrade",
+            "User-Agent",
+            "Vary",
+            "X-Forwarded-For",
+        };
+
+        // Must be a power of two; large enough that a collision-free seed is found quickly
+        inline constexpr std::size_t TABLE_SIZE = 128;
+        inline constexpr uint8_t EMPTY_SLOT = 0xFF;
+
+        constexpr char to_lower(char c) {
+            return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+
+        // Seeded FNV-1a over the lower-cased name
+        constexpr uint32_t hash(std::string_view name, uint32_t seed) {
+            uint32_t h = 2166136261u ^ seed;
+            for (char c : name) {
+                h ^= static_cast<uint8_t>(to_lower(c));
+                h *= 16777619u;
+            }
+            return h ^ (h >> 15);
+        }
+
+        constexpr bool is_perfect(uint32_t seed) {
+            std::array<bool, TABLE_SIZE> used{};
+            for (std::string_view name : KNOWN_NAMES) {
+                std::size_t slot = hash(name, seed) & (TABLE_SIZE - 1);
+                if (used[slot]) {
+                    return false;
+                }
+                used[slot] = true;
+            }
+            return true;
+        }
+
+        constexpr uint32_t find_seed() {
+            for (uint32_t seed = 0; seed < 1000000; ++seed) {
+                if (is_perfect(seed)) {
+                    return seed;
+                }
+            }
+            return 0xFFFFFFFFu;
+        }
+
+        inline constexpr uint32_t SEED = find_seed();
+        static_assert(SEED != 0xFFFFFFFFu, "no perfect hash seed for the known header set");
+        static_assert(KNOWN_COUNT <= 64, "known header presence is tracked in a 64-bit mask");
+
+        constexpr std::array<uint8_t, TABLE_SIZE> build_table() {
+            std::array<uint8_t, TABLE_SIZE> table{};
+            for (auto &slot : table) {
+                slot = EMPTY_SLOT;
+            }
+            for (std::size_t i = 0; i < KNOWN_COUNT; ++i) {
+                table[hash(KNOWN_NAMES[i], SEED) & (TABLE_SIZE - 1)] = static_cast<uint8_t>(i);
+            }
+            return table;
+        }
+
+        inline constexpr std::array<uint8_t, TABLE_SIZE> TABLE = build_table();
+    }
+
+    // ASCII case-insensitive comparison, as header names require
+    constexpr bool iequals(std::string_view a, std::string_view b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            if (headers_detail::to_lower(a[i]) != headers_detail::to_lower(b[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Resolve a header name to its fixed slot: one hash, one table probe, one compare
+    constexpr std::optional<HTTP_HEADER> lookup_header(std::string_view name) {
+        uint8_t index = headers_detail::TABLE[headers_detail::hash(name, headers_detail::SEED) & (headers_detail::TABLE_SIZE - 1)];
+        if (index == headers_detail::EMPTY_SLOT || !iequals(name, headers_detail::KNOWN_NAMES[index])) {
+            return std::nullopt;
+        }
+        return static_cast<HTTP_HEADER>(index);
+    }
+
+    constexpr std::string_view header_name(HTTP_HEADER header) {
+        return headers_detail::KNOWN_NAMES[static_cast<std::size_t>(header)];
+    }
+
+    // Case-insensitive header container. Known headers live in fixed slots,
+    // anything else in a small flat vector searched linearly.
+    class Headers {
+    public:
+        using value_type = std::pair<std::string, std::string>;
+
+        Headers() = default;
+        Headers(std::initializer_list<value_type> init);
+
+        const std::string* get(HTTP_HEADER header) const;
+        const std::string* get(std::string_view name) const;
+        bool contains(HTTP_HEADER header) const { return get(header) != nullptr; }
+        bool contains(std::string_view name) const { return get(name) != nullptr; }
+
+        void set(HTTP_HEADER header, std::string value);
+        void set(std::string_view name, std::string value);
+
+        // Returns the existing value or inserts an empty one
+        std::string& operator[](HTTP_HEADER header);
+        std::string& operator[](std::string_view name);
+
+        bool erase(HTTP_HEADER header);
+        bool erase(std::string_view name);
+
+        std::size_t size() const;
+        bool empty() const { return size() == 0; }
+
+        // Visit every header as (name, value); known headers first, using canonical names
+        template <typename Fn>
+        void for_each(Fn &&fn) const {
+            for (std::size_t i = 0; i < headers_detail::KNOWN_COUNT; ++i) {
+                if (known_present & (uint64_t{1} << i)) {
+                    fn(headers_detail::KNOWN_NAMES[i], known_values[i]);
+                }
+            }
+            for (const auto &[name, value] : extra) {
+                fn(std::string_view(name), value);
+            }
+        }
+
+    private:
+        std::array<std::string, headers_detail::KNOWN_COUNT> known_values;
+        uint64_t known_present = 0;
+        std::vector<value_type> extra;
+
+        static uint64_t bit(HTTP_HEADER header) { return uint64_t{1} << static_cast<std::size_t>(header); }
+    };
+}
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef HTTP2_FRAME_HPP
+#define HTTP2_FRAME_HPP
+
+#include <cstdint>          // uint8_t, uint32_t
+#include <string>           // std::string
+#include <string_view>      // std::string_view
+#include <stdexcept>        // std::runtime_error
+
+namespace http_server::http2 {
+    // Client connection preface (RFC 9113 section 3.4)
+    inline constexpr std::string_view CONNECTION_PREFACE = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+    inline constexpr size_t FRAME_HEADER_SIZE = 9;
+
+    enum class FrameType : uint8_t {
+        DATA            = 0x0,
+        HEADERS         = 0x1,
+        PRIORITY        = 0x2,
+        RST_STREAM      = 0x3,
+        SETTINGS        = 0x4,
+        PUSH_PROMISE    = 0x5,
+        PING            = 0x6,
+        GOAWAY          = 0x7,
+        WINDOW_UPDATE   = 0x8,
+        CONTINUATION    = 0x9,
+    };
+
+    namespace flags {
+        inline constexpr uint8_t END_STREAM     = 0x1;
+        inline constexpr uint8_t ACK            = 0x1;
+        inline constexpr uint8_t END_HEADERS    = 0x4;
+        inline constexpr uint8_t PADDED         = 0x8;
+        inline constexpr uint8_t PRIORITY       = 0x20;
+    }
+
+    enum class ErrorCode : uint32_t {
+        NO_ERROR            = 0x0,
+        PROTOCOL_ERROR      = 0x1,
+        INTERNAL_ERROR      = 0x2,
+        FLOW_CONTROL_ERROR  = 0x3,
+        SETTINGS_TIMEOUT    = 0x4,
+        STREAM_CLOSED       = 0x5,
+        FRAME_SIZE_ERROR    = 0x6,
+        REFUSED_STREAM      = 0x7,
+        CANCEL              = 0x8,
+        COMPRESSION_ERROR   = 0x9,
+        CONNECT_ERROR       = 0xa,
+        ENHANCE_YOUR_CALM   = 0xb,
+        INADEQUATE_SECURITY = 0xc,
+        HTTP_1_1_REQUIRED   = 0xd,
+    };
+
+    enum class SettingId : uint16_t {
+        HEADER_TABLE_SIZE       = 0x1,
+        ENABLE_PUSH             = 0x2,
+        MAX_CONCURRENT_STREAMS  = 0x3,
+        INITIAL_WINDOW_SIZE     = 0x4,
+        MAX_FRAME_SIZE          = 0x5,
+        MAX_HEADER_LIST_SIZE    = 0x6,
+    };
+
+    struct Settings {
+        uint32_t header_table_size      = 4096;
+        uint32_t enable_push            = 1;
+        uint32_t max_concurrent_streams = 0xFFFFFFFFu;
+        uint32_t initial_window_size    = 65535;
+        uint32_t max_frame_size         = 16384;
+        uint32_t max_header_list_size   = 0xFFFFFFFFu;
+    };
+
+    struct FrameHeader {
+        uint32_t length;
+        FrameType type;
+        uint8_t flags;
+        uint32_t stream_id;
+    };
+
+    // Thrown for errors that tear down the whole connection with GOAWAY
+    class ConnectionError : public std::runtime_error {
+    public:
+        ConnectionError(ErrorCode code, const std::string &what) : std::runtime_error(what), code(code) {}
+        ErrorCode code;
+    };
+
+    // Thrown for errors confined to a single stream, answered with RST_STREAM
+    class StreamError : public std::runtime_error {
+    public:
+        StreamError(uint32_t stream_id, ErrorCode code, const std::string &what)
+            : std::runtime_error(what), stream_id(stream_id), code(code) {}
+        uint32_t stream_id;
+        ErrorCode code;
+    };
+
+    FrameHeader parse_frame_header(const uint8_t *data);
+    std::string serialize_frame(FrameType type, uint8_t flags, uint32_t stream_id, std::string_view payload);
+
+    // Apply a SETTINGS payload on top of 'settings'; throws ConnectionError on invalid values
+    void apply_settings(Settings &settings, std::string_view payload);
+    std::string serialize_settings(const Settings &settings);
+
+    inline uint32_t read_u32(const uint8_t *p) {
+        return (uint32_t{p[0]} << 24) | (uint32_t{p[1]} << 16) | (uint32_t{p[2]} << 8) | uint32_t{p[3]};
+    }
+
+    inline void append_u32(std::string &out, uint32_t value) {
+        out.push_back(static_cast<char>(value >> 24));
+        out.push_back(static_cast<char>(value >> 16));
+        out.push_back(static_cast<char>(value >> 8));
+        out.push_back(static_cast<char>(value));
+    }
+}
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef HTTP2_HPACK_HPP
+#define HTTP2_HPACK_HPP
+
+#include <cstdint>          // uint8_t, uint32_t
+#include <deque>            // std::deque
+#include <string>           // std::string
+#include <string_view>      // std::string_view
+#include <utility>          // std::pair
+#include <vector>           // std::vector
+
+namespace http_server::http2 {
+    using HeaderField = std::pair<std::string, std::string>;
+
+    // HPACK dynamic table (RFC 7541 section 4): newest entry first, size counted with 32 bytes overhead per entry
+    class HpackTable {
+    public:
+        explicit HpackTable(size_t max_size = 4096) : max_size(max_size) {}
+
+        void add(std::string name, std::string value);
+        void set_max_size(size_t size);
+        size_t get_max_size() const { return max_size; }
+        size_t entry_count() const { return entries.size(); }
+
+        // 1-based HPACK index across static then dynamic table; nullptr if out of range
+        const HeaderField* at(size_t index) const;
+
+        // Best match for (name, value): index of a full match, else of a name match, 0 if none
+        size_t find(std::string_view name, std::string_view value, bool &full_match) const;
+
+    private:
+        std::deque<HeaderField> entries;
+        size_t size = 0;
+        size_t max_size;
+
+        void evict_to(size_t limit);
+    };
+
+    class HpackDecoder {
+    public:
+        // 'max_table_size' is the SETTINGS_HEADER_TABLE_SIZE we advertised
+        explicit HpackDecoder(size_t max_table_size = 4096) : table(max_table_size), settings_max(max_table_size) {}
+
+        // Decode a complete header block; throws ConnectionError(COMPRESSION_ERROR) on malformed input
+        std::vector<HeaderField> decode(std::string_view block);
+        // As above, but fields past 'max_list_size' (RFC 9113 section 6.5.2 sizes) are dropped and
+        // 'too_large' set; the rest of the block is still decoded to keep the table in sync
+        std::vector<HeaderField> decode(std::string_view block, size_t max_list_size, bool &too_large);
+
+    private:
+        HpackTable table;
+        size_t settings_max;
+    };
+
+    class HpackEncoder {
+    public:
+        // Called when the peer changes SETTINGS_HEADER_TABLE_SIZE
+        void set_max_table_size(size_t size);
+
+        // Encode one header block; names must already be lower-case
+        std::string encode(const std::vector<HeaderField> &headers);
+
+    private:
+        HpackTable table;
+        bool pending_size_update = false;
+
+        static bool should_index(std::string_view name);
+    };
+
+    // Primitive codecs, exposed for the session and for reuse
+    void encode_integer(std::string &out, uint32_t value, int prefix_bits, uint8_t first_byte_flags);
+    uint32_t decode_integer(const uint8_t *&pos, const uint8_t *end, int prefix_bits);
+    void encode_string(std::string &out, std::string_view value);
+    std::string huffman_encode(std::string_view value);
+    size_t huffman_encoded_length(std::string_view value);
+    std::string huffman_decode(std::string_view encoded);
+}
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef HTTP2_SESSION_HPP
+#define HTTP2_SESSION_HPP
+
+#include <http_server/config.hpp>       // MAX_BODY_SIZE
+#include <http_server/http2/frame.hpp>  // Settings, FrameHeader
+#include <http_server/http2/hpack.hpp>  // HpackDecoder, HpackEncoder
+#include <http_server/request.hpp>      // HTTP_Request
+#include <http_server/response.hpp>     // HTTP_Response
+#include <condition_variable>           // std::condition_variable
+#include <cstdint>                      // uint32_t, int64_t
+#include <functional>                   // std::function
+#include <map>                          // std::map
+#include <memory>                       // std::shared_ptr
+#include <mutex>                        // std::mutex
+#include <optional>                     // std::optional
+#include <string>                       // std::string
+
+namespace http_server::http2 {
+    // One cleartext HTTP/2 connection. The calling thread reads frames; each
+    // request stream is dispatched on its own thread so slow handlers don't
+    // block the other streams on the connection.
+    class Session {
+    public:
+        using Dispatch = std::function<HTTP_Response(const HTTP_Request &)>;
+        using HeadCheck = std::function<std::optional<HTTP_Response>(const HTTP_Request &)>;
+
+        // 'initial' holds bytes already read from the socket (the preface and possibly more)
+        Session(int fd, Dispatch dispatch, std::string client_ip, std::string initial);
+        ~Session();
+
+        // h2c upgrade (RFC 7540 section 3.2): 'request' becomes stream 1 and
+        // 'settings_payload' is the decoded HTTP2-Settings header
+        void set_upgrade(HTTP_Request request, const std::string &settings_payload);
+
+        // Once 'fd' turns readable, send GOAWAY, refuse new streams and close when the open
+        // ones are done
+        void drain_on(int fd);
+
+        // Check each request's head as soon as its headers are decoded, before any DATA is taken;
+        // a response refuses the stream. Bodies past 'max_body_size' are refused with 413.
+        void check_heads(HeadCheck check, size_t max_body_size);
+
+        // Serve the connection until the peer goes away or a connection error occurs
+        void run();
+
+        static constexpr uint32_t MAX_CONCURRENT_STREAMS = 100;
+        static constexpr uint32_t LOCAL_WINDOW_SIZE = 1 << 20;
+        // Request bodies buffered on a connection past which only the oldest incomplete stream
+        // gets its window back; the others wait for it (or any other stream) to finish
+        static constexpr size_t MAX_BUFFERED_BODIES = 16 << 20;
+        // Advertised SETTINGS_MAX_HEADER_LIST_SIZE; also caps the compressed block, which is never larger
+        static constexpr uint32_t MAX_HEADER_LIST_SIZE = 16 << 10;
+
+    private:
+        struct Stream {
+            uint32_t id;
+            HTTP_Request request;
+            int64_t send_window = 0;
+            int64_t receive_window = LOCAL_WINDOW_SIZE;
+            uint32_t withheld_credit = 0;   // received bytes not yet returned in a WINDOW_UPDATE
+            bool remote_closed = false;
+            bool reset = false;
+            bool dispatched = false;
+            std::optional<HTTP_Response> refusal;  // sent instead of dispatching; the body is discarded
+        };
+
+        int fd;
+        Dispatch dispatch;
+        std::string client_ip;
+        std::string in;             // received, unconsumed bytes
+        size_t in_offset = 0;
+        int idle_timeout_ms = -1;   // from the socket's SO_RCVTIMEO
+        int drain_fd = -1;
+        HeadCheck head_check;
+        size_t max_body_size = config::MAX_BODY_SIZE;
+
+        // Reader-thread state
+        HpackDecoder decoder;
+        uint32_t last_stream_id = 0;
+        uint32_t continuation_stream = 0;
+        bool continuation_end_stream = false;
+        std::string header_block;
+        std::shared_ptr<Stream> upgrade_stream;
+        bool draining = false;      // GOAWAY sent
+        bool peer_went_away = false;    // GOAWAY received; open streams still finish
+        int64_t connection_receive_window = LOCAL_WINDOW_SIZE;
+
+        // Shared with stream threads, guarded by state_mutex
+        std::mutex state_mutex;
+        std::condition_variable state_changed;
+        Settings peer_settings;
+        int64_t connection_send_window = 65535;
+        std::map<uint32_t, std::shared_ptr<Stream>> streams;
+        size_t buffered_bodies = 0;         // bodies of streams in 'streams'
+        size_t running_streams = 0;
+        bool closing = false;
+
+        // Serializes frame writes and the HPACK encoder, whose state follows write order
+        std::mutex write_mutex;
+        HpackEncoder encoder;
+
+        bool fill(size_t needed);
+        void handle_frame(const FrameHeader &header, std::string_view payload);
+        void handle_data(const FrameHeader &header, std::string_view payload);
+        void handle_headers(const FrameHeader &header, std::string_view payload);
+        void handle_settings(const FrameHeader &header, std::string_view payload);
+        void handle_window_update(const FrameHeader &header, std::string_view payload);
+        void handle_rst_stream(const FrameHeader &header, std::string_view payload);
+        void check_header_block();
+        void finish_header_block(uint32_t stream_id, bool end_stream);
+        std::string take_stream_credit();
+        void erase_stream(std::map<uint32_t, std::shared_ptr<Stream>>::iterator it);
+        void start_stream(const std::shared_ptr<Stream> &stream);
+        void serve_stream(const std::shared_ptr<Stream> &stream);
+
+        void send_response(const std::shared_ptr<Stream> &stream, const HTTP_Response &response);
+        bool send_data(const std::shared_ptr<Stream> &stream, std::string_view data, bool end_stream);
+        bool write_frame(FrameType type, uint8_t flags, uint32_t stream_id, std::string_view payload);
+        bool write_all(const std::string &bytes);
+        void reset_stream(uint32_t stream_id, ErrorCode code);
+        void go_away(ErrorCode code, const std::string &debug);
+    };
+}
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef LISTENER_HPP
+#define LISTENER_HPP
+
+#include <http_server/options.hpp>  // ServerOptions
+#include <string>                   // std::string
+#include <sys/socket.h>             // sockaddr_storage
+
+namespace http_server {
+    struct Listener {
+        int fd = -1;
+        std::string spec;           // as configured, for logs
+        std::string unix_path;      // socket file to remove on close; empty for TCP
+        bool tls = false;           // connections open with a TLS handshake
+
+        bool is_tcp() const { return unix_path.empty(); }
+    };
+
+    // Bind and listen on 'spec': "host:port", "[ipv6]:port", "*:port" (all IPv4
+    // interfaces) or "unix:/path", after an optional "tls:". IPv6 listeners are IPv6-only so "*:port" and
+    // "[::]:port" can be used together. A stale socket file at a Unix path is
+    // replaced. Throws std::runtime_error on failure.
+    Listener open_listener(const std::string &spec, const ServerOptions &options);
+    void close_listener(Listener &listener);
+
+    // Printable peer address for logs and HTTP_Request::remote_address
+    std::string format_peer(const sockaddr_storage &address, const Listener &listener);
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef OPTIONS_HPP
+#define OPTIONS_HPP
+
+#include <http_server/config.hpp>           // defaults
+#include <http_server/client_limits.hpp>    // ClientLimits
+#include <cstdint>                          // uint16_t
+#include <string>                           // std::string
+#include <vector>                           // std::vector
+
+namespace http_server {
+    // Runtime settings for HTTP_Server. Every field has a long option of the same
+    // name (dashes for underscores), accepted as '--name=value' on the command
+    // line and as 'name = value' in a config file.
+    struct ServerOptions {
+        uint16_t port = config::DEFAULT_PORT;
+        std::string directory = config::DEFAULT_ROOT_PATH;
+
+        // Listeners: '--listen' is repeatable and takes "host:port", "[ipv6]:port", "*:port"
+        // or "unix:/path", optionally prefixed with "tls:"; with none, the server listens on
+        // all IPv4 interfaces at 'port'
+        std::vector<std::string> listen;
+        int backlog = config::BACKLOG_SIZE;
+        bool reuse_port = false;        // SO_REUSEPORT, for several processes on one port
+        int defer_accept = 0;           // TCP_DEFER_ACCEPT seconds: wake accept() only once data arrives
+        int fastopen = 0;               // TCP_FASTOPEN queue length; 0 disables
+
+        // TLS listeners; needs a build with HTTP_SERVER_TLS
+        std::string tls_cert;           // PEM certificate chain
+        std::string tls_key;            // PEM private key
+        size_t tls_session_cache = config::TLS_SESSION_CACHE_SIZE;  // sessions resumable by ID; 0 disables
+        bool tls_tickets = true;        // stateless resumption with session tickets
+        bool ktls = true;               // let the kernel encrypt and decrypt records when it can
+
+        // Upgrades: a process started with '--inherit-from PATH' takes over the listeners of
+        // the one whose '--upgrade-socket' is PATH, which then drains and exits
+        std::string upgrade_socket;     // Unix control socket path; empty disables
+        std::string inherit_from;
+        int drain_timeout = config::DRAIN_TIMEOUT;  // seconds before remaining connections are dropped
+
+        // Accepted sockets; buffer sizes of 0 keep the kernel's autotuning
+        bool tcp_nodelay = true;        // send small responses immediately
+        bool cork = true;               // MSG_MORE so a response head and streamed body share segments
+        int rcvbuf = 0;                 // SO_RCVBUF bytes
+        int sndbuf = 0;                 // SO_SNDBUF bytes
+
+        // Keep-alive
+        int keep_alive_requests = config::MAX_KEEP_ALIVE_REQUESTS;
+        int keep_alive_timeout = config::CONNECTION_TIMEOUT;   // idle seconds before closing; 0 waits forever
+
+        // Requests; larger heads get 431 and larger bodies 413, before any body is read
+        size_t max_header_size = config::MAX_HEADER_SIZE;
+        size_t max_body_size = config::MAX_BODY_SIZE;
+
+        // Features
+        size_t cache_size = 0;                  // response cache bytes; 0 disables
+        bool durable_uploads = false;           // 201 only once an upload is synced to disk, in group commits
+        ClientLimits client_limits;             // --max-connections-per-ip, --rate-limit, --rate-burst
+        std::vector<std::string> proxies;       // '/prefix=host:port[,host:port...]', repeatable
+        uint32_t trace_sample = 0;              // trace one request in N; 0 disables
+        std::string trace_file = "trace";       // SIGUSR1 dumps to '<trace_file>.<pid>.<n>.json'
+        bool debug_buffers = false;             // GET /debug/buffers reports the I/O buffer pool
+    };
+
+    // Set one option by name (without the leading dashes); throws std::invalid_argument
+    void set_option(ServerOptions &options, const std::string &name, const std::string &value);
+
+    // Read 'name = value' lines; blank lines and lines starting with '#' are skipped
+    void load_options_file(ServerOptions &options, const std::string &path);
+
+    // Command line options, applied in order; '--config FILE' loads a file at that point
+    ServerOptions parse_options(int argc, char **argv);
+}
+
+#endif
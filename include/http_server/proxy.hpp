@@ -0,0 +1,37 @@
+#ifndef PROXY_HPP
+#define PROXY_HPP
+
+#include <http_server/router.hpp>   // Handler
+#include <chrono>                   // std::chrono::milliseconds
+#include <cstdint>                  // uint16_t
+#include <string>                   // std::string
+#include <vector>                   // std::vector
+
+namespace http_server::proxy {
+    struct Upstream {
+        std::string host;
+        uint16_t port;
+    };
+
+    struct ProxyOptions {
+        std::vector<Upstream> upstreams;
+        // When set, the upstream path is '/' plus this route parameter (e.g. "rest" for "/api/*rest");
+        // otherwise the request path is forwarded unchanged
+        std::string path_param;
+        size_t max_idle_connections = 16;               // kept open per upstream
+        std::chrono::milliseconds connect_timeout{1000};
+        std::chrono::milliseconds io_timeout{30000};
+        int max_failures = 3;                           // consecutive failures before an upstream is ejected
+        std::chrono::milliseconds eject_duration{5000};
+    };
+
+    // Build a handler that forwards matched requests to the upstreams over pooled
+    // keep-alive connections and streams the upstream response body back.
+    // Requests go to the healthy upstream with the fewest requests in flight.
+    Handler make_proxy_handler(ProxyOptions options);
+
+    // Parse "host:port[,host:port...]"; throws std::invalid_argument on malformed input
+    std::vector<Upstream> parse_upstreams(const std::string &spec);
+}
+
+#endif
@@ -1,18 +1,37 @@
 #ifndef REQUEST_HPP
 #define REQUEST_HPP
 
+#include <http_server/headers.hpp> // Headers
+#include <http_server/body.hpp>    // BodyStream
 #include <string>
-#include <map>
+#include <optional>
 
 namespace http_server {
     struct HTTP_Request {
         std::string method, path, version;
-        std::map<std::string, std::string> headers;
+        Headers headers;
         std::string body;
         std::string encoding_scheme;
+        std::string remote_address;     // peer address, filled in by the server
+        // Chunked uploads leave 'body' empty and are read from the connection through
+        // this instead; trailers arrive once it has run to the end
+        BodyStream body_stream = {};
+        Headers trailers = {};
     };
 
+    // Head and whatever follows it as the body; the server passes only the head and
+    // reads the body itself once the request is accepted
     HTTP_Request parse_request(const std::string &raw);
+
+    // Pick request.encoding_scheme from the Accept-Encoding header
+    void negotiate_encoding(HTTP_Request &request);
+
+    // Declared Content-Length, or nullopt without one; throws std::runtime_error
+    // unless the value is a plain decimal number
+    std::optional<size_t> content_length(const HTTP_Request &request);
+
+    // Whether the request body uses chunked transfer coding
+    bool is_chunked(const HTTP_Request &request);
 }
 
 #endif
\ No newline at end of file
@@ -1,16 +1,28 @@
 #ifndef RESPONSE_HPP
 #define RESPONSE_HPP
 
+#include <http_server/headers.hpp> // Headers
+#include <http_server/body.hpp>    // BodySink, BodyStream
+#include <http_server/async/task.hpp>  // async::Task
+#include <functional>
 #include <string>
-#include <map>
 
 namespace http_server {
     struct HTTP_Response {
         int status_code;
         std::string status_message;
-        std::map<std::string, std::string> headers;
+        Headers headers;
         std::string body;
+        BodyStream body_stream = {};    // when set, replaces 'body'; sent chunked unless Content-Length is set
+        // Takes over the socket once the head is sent, along with any bytes the client sent
+        // after the request, and the connection thread exits. Used by 101 upgrades and by
+        // responses that stream on the event loop until the server closes (event streams).
+        std::function<void(int fd, std::string buffered)> takeover = {};
+        // When set, the real response comes from this coroutine, run on the event loop; the other
+        // fields are placeholders. Set by routes with an AsyncHandler.
+        std::function<async::Task<HTTP_Response>()> deferred = {};
         
+        // Status line, headers and 'body'; only the head when 'body_stream' or 'takeover' is set
         std::string to_string() const;
     };
 }
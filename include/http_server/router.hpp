@@ -4,12 +4,18 @@
 #include <http_server/request.hpp>  // HTTP_Request
 #include <http_server/response.hpp> // HTTP_Response
 #include <http_server/status.hpp>   // HTTP_STATUS_CODE
+#include <http_server/cache.hpp>    // ResponseCache, CachePolicy
+#include <http_server/async/task.hpp>   // async::Task
 #include <functional>               // std::function
+#include <memory>                   // std::shared_ptr
+#include <optional>                 // std::optional
 #include <regex>                    // std::regex
 
 namespace http_server {
     using Params = std::map<std::string, std::string>;
     using Handler = std::function<HTTP_Response(const HTTP_Request &, const Params &)>;
+    // Coroutine handler; may co_await timers and I/O on the event loop (see async/event_loop.hpp)
+    using AsyncHandler = std::function<async::Task<HTTP_Response>(const HTTP_Request &, const Params &)>;
 
     struct Route {
         std::string method;
@@ -17,14 +23,24 @@ namespace http_server {
         std::regex regex_pattern;
         std::vector<std::string> path_params;
         Handler handler;
+        std::optional<CachePolicy> cache_policy = {};
     };
 
     class Router {
         private:
             std::vector<Route> routes;
+            std::shared_ptr<ResponseCache> cache;
+
+            static std::string cache_key(const HTTP_Request &request, const CachePolicy &policy);
         public:
             HTTP_Response dispatch(const HTTP_Request &request) const;
-            void add_route(const std::string &method, const std::string &path_pattern, Handler handler);
+            // Patterns match literally except ':name', one path segment, and a trailing '*name', the rest of the path.
+            // Routes with a cache policy are served from the response cache once it is enabled.
+            void add_route(const std::string &method, const std::string &path_pattern, Handler handler,
+                           std::optional<CachePolicy> cache_policy = std::nullopt);
+            void add_route(const std::string &method, const std::string &path_pattern, AsyncHandler handler,
+                           std::optional<CachePolicy> cache_policy = std::nullopt);
+            void enable_cache(size_t max_bytes);
             static std::pair<std::regex, std::vector<std::string>> compile_path_pattern(const std::string &path_pattern);
     };
 }
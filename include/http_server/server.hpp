@@ -6,30 +6,111 @@
 #include <http_server/status.hpp>   // HTTP_STATUS_CODE
 #include <http_server/config.hpp>  // HTTP_SERVER_CONFIG
 #include <http_server/router.hpp>  // Router
+#include <http_server/client_limits.hpp>   // ClientLimiter
+#include <http_server/options.hpp> // ServerOptions
+#include <http_server/listener.hpp>    // Listener
+#include <http_server/tls.hpp>         // tls::Context
+#include <atomic>           // std::atomic
 #include <iostream>         // std::cout, std::cerr
 #include <string>           // std::string
 #include <map>              // std::map
 #include <functional>       // std::function
 #include <optional>         // std::optional
-#include <arpa/inet.h>      // sockaddr_in, htons(), INADDR_ANY
 #include <stdexcept>        // std::runtime_error
 
 namespace http_server {
+    // Inspects a request line and headers before the body is read. A returned response is
+    // sent instead of dispatching; nullopt lets the request through.
+    using HeadCheck = std::function<std::optional<HTTP_Response>(const HTTP_Request &)>;
+
     class HTTP_Server {
     public:
         explicit HTTP_Server(uint16_t port = config::DEFAULT_PORT, std::string root_path = config::DEFAULT_ROOT_PATH);
-        void add_route(const std::string &method, const std::string &path_pattern, Handler handler);
+        // Listener and per-connection socket settings, keep-alive limits, cache and client limits from 'options'
+        explicit HTTP_Server(const ServerOptions &options);
+        void add_route(const std::string &method, const std::string &path_pattern, Handler handler,
+                       std::optional<CachePolicy> cache_policy = std::nullopt);
+        void add_route(const std::string &method, const std::string &path_pattern, AsyncHandler handler,
+                       std::optional<CachePolicy> cache_policy = std::nullopt);
+        // Serve routes registered with a cache policy from a response cache of at most 'max_bytes'
+        void enable_response_cache(size_t max_bytes);
+        // Cap connections and request rate per client IP; over-limit connections are
+        // closed at accept and over-rate requests get 429
+        void set_client_limits(const ClientLimits &limits);
+        // Trace one request in 'sample_every'. The spans are served as Chrome trace JSON at
+        // GET /debug/trace and written to '<dump_prefix>.<pid>.<n>.json' on SIGUSR1.
+        void enable_tracing(uint32_t sample_every, const std::string &dump_prefix);
+        // Run 'check' on every request head, in the order added. A client that sent
+        // 'Expect: 100-continue' is only told to send its body once all checks pass.
+        void add_head_check(HeadCheck check);
+        // Give requests for paths under 'prefix' (a leading path, such as "/api") their
+        // Content-Length body as request.body_stream, read off the connection as the handler
+        // consumes it, rather than whole in request.body. Chunked bodies always stream.
+        void stream_request_bodies(std::string prefix);
+        // Accept connections until the listeners have been handed to a replacement process
+        // (see handoff.hpp), then return once in-flight requests are answered
         void run();
         ~HTTP_Server();
     private:
-        int server_fd;
-        std::string root_path;
-        struct sockaddr_in server_address;
+        ServerOptions options;
+        std::vector<Listener> listeners;
         Router router;
+        std::unique_ptr<ClientLimiter> limiter;
+        std::unique_ptr<tls::Context> tls_context;     // set when a listener is "tls:"
         std::vector <std::pair<std::string, Handler>> routes;
+        std::vector<HeadCheck> head_checks;
+        std::vector<std::string> streamed_prefixes;
+
+        // Upgrades
+        int upgrade_fd = -1;            // control socket, when options.upgrade_socket is set
+        int predecessor = -1;           // process whose listeners were inherited, until run() starts
+        int drain_fd = -1;              // eventfd, readable once draining
+        std::atomic<bool> handing_off{false};
+        std::atomic<bool> draining{false};
+        std::atomic<size_t> connections{0};    // connections still open, other than taken-over ones
+
+        enum class Outcome {
+            open,           // ready for the next request
+            closed,         // to be closed
+            handed_off,     // a response took the socket over
+            suspended       // waiting on the event loop for a deferred response
+        };
+        // A connection picking up once the event loop has produced its deferred response
+        struct Resumption {
+            HTTP_Request request;
+            HTTP_Response response;
+            std::string pending;        // bytes read past the request
+            int requests;               // served before it
+        };
         
-        // New method to handle client connections with better error handling
-        void handle_client_connection(int client_fd, const sockaddr_in& client_address);
+        // Apply the per-connection socket options to an accepted socket
+        void configure_connection(int client_fd, const Listener &listener) const;
+        void accept_connection(const Listener &listener);
+        // Give the listeners to the process on 'connection'; drains if it takes them
+        void hand_off(int connection);
+        // Stop accepting, close idle keep-alive connections and wait for the rest, up to options.drain_timeout
+        void drain();
+        // Serve 'client_fd' on this thread, then close it and drop it from the counts unless it was
+        // handed off or suspended
+        void serve_connection(int client_fd, const std::string &client_ip, ClientConnection client,
+                              std::optional<Resumption> resumed = std::nullopt);
+        // New method to handle client connections with better error handling.
+        // Starts with sending 'resumed->response' when set; never returns Outcome::open.
+        Outcome handle_client_connection(int client_fd, const std::string &client_ip, ClientConnection client,
+                                         std::optional<Resumption> resumed);
+        // Send 'response' and decide whether the connection goes on; 'requests' counts it
+        Outcome respond(int client_fd, const std::string &client_ip, const HTTP_Request &request,
+                        HTTP_Response &response, bool body_unread, std::string &pending, int &requests);
+        // Await 'deferred' on the event loop, then resume the connection on a thread of its own
+        async::Task<void> resume_deferred(int client_fd, std::string client_ip, ClientConnection client, HTTP_Request request,
+                                          std::function<async::Task<HTTP_Response>()> deferred,
+                                          std::string pending, int requests);
+        // Whether 'request' falls under a prefix given to stream_request_bodies()
+        bool streams_body(const HTTP_Request &request) const;
+        // Expectation, size limits and head checks; a response if 'request' is refused
+        std::optional<HTTP_Response> check_head(const HTTP_Request &request) const;
+        // Route 'request' unless 'client' (see ClientLimiter::client_key) is over its request rate
+        HTTP_Response dispatch(const HTTP_Request &request, ClientKey client) const;
     };
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef SSE_HPP
+#define SSE_HPP
+
+#include <http_server/router.hpp>   // Handler, Params
+#include <http_server/config.hpp>   // SSE_MAX_QUEUED
+#include <cstdint>                  // uint64_t
+#include <functional>               // std::function
+#include <memory>                   // std::shared_ptr
+#include <mutex>                    // std::mutex
+#include <string>                   // std::string
+#include <unordered_map>            // std::unordered_map
+#include <vector>                   // std::vector
+
+// Server-Sent Events (text/event-stream). Subscribed connections leave their thread and
+// are written from the event loop; a published event is encoded once and the same
+// buffer is queued on every subscriber of its topic.
+namespace http_server::sse {
+    struct Event {
+        std::string data;           // may span lines
+        std::string event = {};     // type; the client's default is "message"
+        std::string id = {};        // becomes the client's Last-Event-ID
+        int retry_ms = -1;          // reconnection delay hint; negative leaves it out
+    };
+
+    // Wire form of 'event'; throws std::invalid_argument if 'event' or 'id' holds a line break
+    std::string encode(const Event &event);
+
+    class Subscriber;
+
+    class Broadcaster : public std::enable_shared_from_this<Broadcaster> {
+    public:
+        // 'max_queued' is how far, in bytes, a subscriber may fall behind before it is dropped
+        explicit Broadcaster(size_t max_queued = config::SSE_MAX_QUEUED);
+        Broadcaster(const Broadcaster &) = delete;
+        Broadcaster &operator=(const Broadcaster &) = delete;
+
+        // Queue 'event' on every subscriber of 'topic' and start their writes; safe from any
+        // thread. Returns the number of subscribers it was queued on.
+        size_t publish(const std::string &topic, const Event &event);
+        // Same, for an already encoded event
+        size_t publish_encoded(const std::string &topic, std::shared_ptr<const std::string> payload);
+
+        // Take ownership of a connected socket whose response head has been sent
+        void subscribe(const std::string &topic, int fd, std::string remote_address);
+
+        size_t subscriber_count(const std::string &topic) const;
+        // Subscribers dropped for falling behind or stalling a write
+        uint64_t evicted_count() const;
+
+        // Route handler answering with an event stream on the topic picked by 'topic':
+        //     auto events = std::make_shared<sse::Broadcaster>();
+        //     server.add_route("GET", "/events/:topic", events->endpoint(sse::topic_param("topic")));
+        using TopicSelector = std::function<std::string(const HTTP_Request &, const Params &)>;
+        http_server::Handler endpoint(TopicSelector topic);
+
+    private:
+        friend class Subscriber;
+
+        size_t max_queued;
+        mutable std::mutex mutex;   // guards everything below
+        std::unordered_map<std::string, std::vector<std::shared_ptr<Subscriber>>> topics;
+        uint64_t evicted = 0;
+
+        void unsubscribe(Subscriber &subscriber);
+        void evict(Subscriber &subscriber, const char *reason);
+    };
+
+    // Topic named by a route parameter, e.g. ":topic" in "/events/:topic"
+    Broadcaster::TopicSelector topic_param(std::string name);
+}
+
+#endif
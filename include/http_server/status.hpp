@@ -3,6 +3,8 @@
 
 namespace http_server {
     enum class HTTP_STATUS_CODE{
+        CONTINUE                = 100,
+        SWITCHING_PROTOCOLS     = 101,
         OK                      = 200,
         CREATED                 = 201,
         ACCEPTED                = 202,
@@ -16,10 +18,17 @@ namespace http_server {
         FORBIDDEN               = 403,
         NOT_FOUND               = 404,
         METHOD_NOT_ALLOWED      = 405,
+        CONTENT_TOO_LARGE       = 413,
+        EXPECTATION_FAILED      = 417,
+        UPGRADE_REQUIRED        = 426,
+        TOO_MANY_REQUESTS       = 429,
+        REQUEST_HEADER_FIELDS_TOO_LARGE = 431,
         INTERNAL_SERVER_ERROR   = 500,
         NOT_IMPLEMENTED         = 501,
         BAD_GATEWAY             = 502,
         SERVICE_UNAVAILABLE     = 503,
+        GATEWAY_TIMEOUT         = 504,
+        HTTP_VERSION_NOT_SUPPORTED = 505,
     };
 }
 
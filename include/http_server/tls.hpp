@@ -0,0 +1,37 @@
+#ifndef TLS_HPP
+#define TLS_HPP
+
+#include <http_server/options.hpp>  // ServerOptions
+#include <string>                   // std::string
+
+struct ssl_ctx_st;
+
+// TLS termination with OpenSSL, built when HTTP_SERVER_TLS is defined. Connections are
+// handed to the HTTP code as plain descriptors, so everything above the socket is unchanged.
+namespace http_server::tls {
+    // Certificate, session cache, ticket keys and ALPN shared by every connection
+    class Context {
+    public:
+        // Loads options.tls_cert and options.tls_key; throws std::runtime_error if they
+        // can't be used or TLS was not compiled in
+        explicit Context(const ServerOptions &options);
+        ~Context();
+        Context(const Context &) = delete;
+        Context &operator=(const Context &) = delete;
+
+        // Handshake on 'fd', which this takes over, within TLS_HANDSHAKE_TIMEOUT. Returns the
+        // descriptor to serve plaintext on, or -1 if the handshake failed. That is 'fd' itself
+        // once kTLS handles records in both directions; otherwise one end of a socketpair
+        // whose other end a relay thread encrypts to and decrypts from 'fd'.
+        int accept(int fd, const std::string &peer);
+
+        // Send close_notify before closing a descriptor accept() returned, if the kernel frames
+        // its records; relayed connections and plain sockets are left alone
+        void close_notify(int fd) const;
+
+    private:
+        ssl_ctx_st *context = nullptr;
+    };
+}
+
+#endif
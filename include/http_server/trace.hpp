@@ -0,0 +1,110 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>       // std::atomic
+#include <cstdint>      // uint32_t, uint64_t
+#include <string>       // std::string
+#include <string_view>  // std::string_view
+
+// Opt-in, sampled request tracing. A sampled request records how long each phase
+// took (recv, parse, dispatch, handler, gzip, send, ...). The serving thread
+// batches its spans and adds them to one bounded ring when the request ends; the
+// ring can be dumped as Chrome trace-event JSON and opened in Perfetto or
+// chrome://tracing. Requests that are not sampled, and
+// every request while tracing is off, pay one thread-local load per span.
+namespace http_server::trace {
+    // Record one request in every 'every'; 0 turns tracing off
+    void set_sampling(uint32_t every);
+
+    // CLOCK_MONOTONIC nanoseconds
+    uint64_t now_ns();
+
+    namespace detail {
+        extern std::atomic<uint32_t> sample_every;
+        // Id of the sampled request this thread is serving, 0 when none
+        extern thread_local uint64_t current_request;
+
+        // New request id if this one is sampled (and now current on this thread), else 0
+        uint64_t begin_request(uint32_t every);
+        void record(const char *name, uint64_t start_ns, uint64_t end_ns, std::string_view label = {});
+    }
+
+    // Scope of one request on the serving thread; decides whether it is sampled.
+    // Spans opened on this thread while it lives belong to the request.
+    class Request {
+    public:
+        Request() {
+            uint32_t every = detail::sample_every.load(std::memory_order_relaxed);
+            if (every != 0 && detail::current_request == 0) {
+                id = detail::begin_request(every);
+                if (id != 0) {
+                    start = now_ns();
+                }
+            }
+        }
+        ~Request();
+        Request(const Request &) = delete;
+        Request &operator=(const Request &) = delete;
+
+        explicit operator bool() const { return id != 0; }
+        // Move the start to now, e.g. once a keep-alive connection stops idling
+        void restart() {
+            if (id != 0) {
+                start = now_ns();
+            }
+        }
+        // Record nothing for this request after all (the connection closed, or was handed off)
+        void cancel();
+        // Shown with the request's event, typically "METHOD /path"
+        void set_label(std::string_view text) {
+            if (id != 0) {
+                label.assign(text);
+            }
+        }
+
+    private:
+        uint64_t id = 0;
+        uint64_t start = 0;
+        std::string label;
+    };
+
+    // One timed phase of the current request; does nothing if it is not sampled
+    class Span {
+    public:
+        explicit Span(const char *name) : name(name) {
+            if (detail::current_request != 0) {
+                start = now_ns();
+            }
+        }
+        ~Span() {
+            if (start != 0) {
+                detail::record(name, start, now_ns());
+            }
+        }
+        Span(const Span &) = delete;
+        Span &operator=(const Span &) = delete;
+
+        void restart() {
+            if (start != 0) {
+                start = now_ns();
+            }
+        }
+        void cancel() { start = 0; }
+
+    private:
+        const char *name;   // must be a string literal
+        uint64_t start = 0;
+    };
+
+    // Everything still in the rings as a Chrome trace-event JSON document
+    std::string dump_json();
+
+    // Write dump_json() to 'path'; false if the file could not be written
+    bool dump_to_file(const std::string &path);
+
+    // Dump to '<path_prefix>.<pid>.<n>.json' whenever 'signal' arrives. The handler
+    // only writes to a pipe; a background thread does the dumping.
+    void dump_on_signal(int signal, const std::string &path_prefix);
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef WEBSOCKET_FRAME_HPP
+#define WEBSOCKET_FRAME_HPP
+
+#include <cstddef>      // size_t
+#include <cstdint>      // uint8_t, uint16_t, uint64_t
+#include <optional>     // std::optional
+#include <stdexcept>    // std::runtime_error
+#include <string>       // std::string
+#include <string_view>  // std::string_view
+
+// WebSocket framing (RFC 6455 section 5)
+namespace http_server::websocket {
+    enum class Opcode : uint8_t {
+        CONTINUATION = 0x0,
+        TEXT = 0x1,
+        BINARY = 0x2,
+        CLOSE = 0x8,
+        PING = 0x9,
+        PONG = 0xA,
+    };
+
+    // Status codes carried by close frames (RFC 6455 section 7.4.1)
+    enum class CloseCode : uint16_t {
+        NORMAL = 1000,
+        GOING_AWAY = 1001,
+        PROTOCOL_ERROR = 1002,
+        UNSUPPORTED_DATA = 1003,
+        NO_STATUS = 1005,           // never sent; the peer's close frame had no code
+        ABNORMAL = 1006,            // never sent; the connection dropped without a close frame
+        INVALID_DATA = 1007,
+        POLICY_VIOLATION = 1008,
+        MESSAGE_TOO_BIG = 1009,
+        INTERNAL_ERROR = 1011,
+    };
+
+    // The peer broke the protocol; 'code' is what the connection is closed with
+    class ProtocolError : public std::runtime_error {
+    public:
+        ProtocolError(CloseCode code, const std::string &message) : std::runtime_error(message), code(code) {}
+        CloseCode code;
+    };
+
+    struct FrameHeader {
+        bool fin;
+        Opcode opcode;
+        bool masked;
+        uint8_t mask[4];
+        uint64_t payload_length;
+        size_t header_length;       // bytes before the payload
+    };
+
+    constexpr bool is_control(Opcode opcode) {
+        return (static_cast<uint8_t>(opcode) & 0x8) != 0;
+    }
+
+    // Header at the start of 'data', or nullopt until all of it has arrived.
+    // Throws ProtocolError for reserved bits, unknown opcodes and bad control frames.
+    std::optional<FrameHeader> parse_frame_header(std::string_view data);
+
+    // Append an unmasked frame, as servers send them
+    void append_frame(std::string &out, Opcode opcode, std::string_view payload, bool fin = true);
+
+    // XOR 'data' with the 4-byte 'mask', starting 'offset' bytes into the mask
+    // cycle; 16 bytes per step with SSE2
+    void apply_mask(char *data, size_t length, const uint8_t mask[4], size_t offset = 0);
+
+    bool is_valid_utf8(std::string_view text);
+}
+
+#endif
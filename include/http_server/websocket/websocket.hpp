@@ -0,0 +1,102 @@
+#ifndef WEBSOCKET_HPP
+#define WEBSOCKET_HPP
+
+#include <http_server/websocket/frame.hpp>  // Opcode, CloseCode
+#include <http_server/router.hpp>           // Handler, Params
+#include <http_server/async/task.hpp>       // Task
+#include <chrono>                           // std::chrono::milliseconds
+#include <coroutine>                        // std::coroutine_handle
+#include <functional>                       // std::function
+#include <memory>                           // std::shared_ptr
+#include <mutex>                            // std::mutex
+#include <optional>                         // std::optional
+#include <string>                           // std::string
+
+// RFC 6455 WebSockets on the event loop. After the upgrade the connection thread
+// exits; reads and writes are awaited on the loop, so an idle socket costs no thread.
+namespace http_server::websocket {
+    struct Message {
+        Opcode opcode;      // TEXT or BINARY
+        std::string data;
+
+        bool is_text() const { return opcode == Opcode::TEXT; }
+    };
+
+    class WebSocket : public std::enable_shared_from_this<WebSocket> {
+    public:
+        // Takes ownership of 'fd'; 'buffered' holds bytes already read past the handshake
+        WebSocket(int fd, std::string buffered, std::string remote_address);
+        ~WebSocket();
+        WebSocket(const WebSocket &) = delete;
+        WebSocket &operator=(const WebSocket &) = delete;
+
+        // Next complete text or binary message, reassembled from fragments; nullopt once
+        // the connection has closed. Pings are answered and the closing handshake is
+        // completed in here. Throws async::TimeoutError. One receive at a time.
+        async::Task<std::optional<Message>> receive(std::chrono::milliseconds timeout = std::chrono::milliseconds(-1));
+
+        // Queue a frame and return; safe from any thread. False once closing, or if the
+        // peer has fallen WEBSOCKET_MAX_BUFFERED bytes behind (it is then disconnected).
+        bool send_text(std::string_view text);
+        bool send_binary(std::string_view data);
+        bool ping(std::string_view payload = {});
+        // Start the closing handshake; later sends are refused
+        void close(CloseCode code = CloseCode::NORMAL, std::string_view reason = {});
+
+        bool is_open() const;
+        // Bytes queued but not yet written to the socket
+        size_t buffered_amount() const;
+        // The peer's close code; ABNORMAL if it went away without one
+        CloseCode close_code() const;
+        const std::string &remote_address() const { return peer; }
+
+        // Finish the closing handshake and shut the socket down; run when the handler returns
+        async::Task<void> finish();
+
+    private:
+        struct DrainAwaiter;
+
+        int fd;
+        std::string peer;
+
+        // Reader side, only touched by receive()
+        std::string in;
+        std::optional<Opcode> fragment_opcode;
+        std::string fragments;
+
+        mutable std::mutex mutex;   // guards everything below
+        std::string outbox;
+        size_t in_flight = 0;       // bytes of the batch being written
+        bool flushing = false;
+        bool close_sent = false;
+        bool close_received = false;
+        bool failed = false;
+        CloseCode peer_close_code = CloseCode::ABNORMAL;
+        std::coroutine_handle<> drain_waiter;
+
+        bool queue(Opcode opcode, std::string_view payload, bool closing = false);
+        void fail(CloseCode code, const std::string &reason);
+        static async::Task<void> flush(std::shared_ptr<WebSocket> self);
+    };
+
+    // Runs for the lifetime of one connection, on the event loop
+    using Handler = std::function<async::Task<void>(std::shared_ptr<WebSocket>, const HTTP_Request &, const Params &)>;
+
+    // Event style alternative to a coroutine handler. Called on the event loop
+    // thread, so they must not block; the WebSocket may be kept to send later.
+    struct Callbacks {
+        std::function<void(const std::shared_ptr<WebSocket> &)> on_open = {};
+        std::function<void(const std::shared_ptr<WebSocket> &, Message &&)> on_message = {};
+        std::function<void(const std::shared_ptr<WebSocket> &, CloseCode)> on_close = {};
+    };
+    Handler from_callbacks(Callbacks callbacks);
+
+    // Route handler performing the opening handshake and handing the socket to 'handler':
+    //     server.add_route("GET", "/chat", websocket::upgrade(handler));
+    http_server::Handler upgrade(Handler handler);
+
+    // Sec-WebSocket-Accept for a client's Sec-WebSocket-Key
+    std::string accept_key(std::string_view key);
+}
+
+#endif
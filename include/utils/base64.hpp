@@ -0,0 +1,16 @@
+#ifndef BASE64_HPP
+#define BASE64_HPP
+
+#include <optional>     // std::optional
+#include <string>       // std::string
+#include <string_view>  // std::string_view
+
+// Standard base64 alphabet with '=' padding (RFC 4648 section 4)
+namespace http_server::base64 {
+    std::string encode(std::string_view data);
+
+    // nullopt if 'text' is not padded, canonical base64
+    std::optional<std::string> decode(std::string_view text);
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uint64_t, uint8_t
+
+// Process-wide pool of I/O buffers in a few size classes. Connections borrow a
+// buffer only while a read or write is in progress, so idle connections hold
+// none. Each thread keeps a few free buffers per class before going to the
+// shared free lists; threads that serve a single connection hand them back
+// with flush_thread_cache() before waiting for the next request.
+namespace http_server::buffer_pool {
+    inline constexpr size_t SIZE_CLASSES[] = {4 << 10, 16 << 10, 64 << 10, 256 << 10};
+    inline constexpr size_t CLASS_COUNT = sizeof(SIZE_CLASSES) / sizeof(SIZE_CLASSES[0]);
+
+    // Borrowed buffer, handed back to the pool when destroyed
+    class Buffer {
+    public:
+        Buffer() = default;
+        Buffer(Buffer &&other) noexcept;
+        Buffer &operator=(Buffer &&other) noexcept;
+        Buffer(const Buffer &) = delete;
+        Buffer &operator=(const Buffer &) = delete;
+        ~Buffer();
+
+        char *data() const { return bytes; }
+        size_t size() const { return bytes ? SIZE_CLASSES[size_class] : 0; }
+        explicit operator bool() const { return bytes != nullptr; }
+
+    private:
+        friend Buffer acquire(size_t min_size);
+        Buffer(char *bytes, uint8_t size_class) : bytes(bytes), size_class(size_class) {}
+        void release();
+
+        char *bytes = nullptr;
+        uint8_t size_class = 0;
+    };
+
+    // Smallest class holding 'min_size'; larger requests get the largest class
+    Buffer acquire(size_t min_size);
+
+    // Move this thread's cached free buffers to the shared lists, where any thread can reuse them
+    void flush_thread_cache();
+
+    struct Stats {
+        size_t in_use_bytes;    // lent out right now
+        size_t pooled_bytes;    // free, in thread caches and the shared lists
+        uint64_t allocations;   // buffers taken from the heap
+        uint64_t reuses;        // buffers served from the pool
+    };
+    Stats stats();
+}
+
+#endif
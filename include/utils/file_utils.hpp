@@ -1,17 +1,28 @@
 #ifndef FILE_UTILS_HPP
 #define FILE_UTILS_HPP
 
+#include <http_server/body.hpp>    // BodyStream
 #include <string>
 #include <optional>
 namespace http_server::file_utils {
     // Read an entire file into a string
     std::optional<std::string> read_file(const std::string& file_path);
 
-    // Write 'data' into 'path', overwriting if exists
-    void save_file(const std::string& path, const std::string& data);
+    // Write 'data' into 'path', overwriting if exists. With 'durable', returns only once
+    // the new contents and the rename are on stable storage (see GroupCommitter).
+    void save_file(const std::string& path, const std::string& data, bool durable = false);
+
+    // Write everything 'source' produces into 'path' as it arrives. The old file is
+    // only replaced if the stream completes; returns false if it did not.
+    bool save_file_stream(const std::string& path, const BodyStream& source, bool durable = false);
 
     // Delete the file at 'path
     bool delete_file(const std::string& path);
+
+    // Replacements are written to a hidden sibling with this prefix and a random suffix
+    // first; routes serving a directory must not expose them
+    inline constexpr char TEMP_PREFIX[] = ".upload-";
+    bool is_temporary(const std::string& path);
 }
 
 
@@ -0,0 +1,66 @@
+#ifndef GROUP_COMMIT_HPP
+#define GROUP_COMMIT_HPP
+
+#include <chrono>               // std::chrono::microseconds
+#include <condition_variable>   // std::condition_variable
+#include <cstddef>              // size_t
+#include <cstdint>              // uint64_t
+#include <mutex>                // std::mutex
+#include <string>               // std::string
+#include <thread>               // std::thread
+#include <vector>               // std::vector
+
+namespace http_server::file_utils {
+    // Makes file replacements durable in batches. Writers finish a temporary file and
+    // block in commit(); one committer thread collects what arrives within 'window',
+    // starts writeback for the whole batch at once, waits for each file's data, renames
+    // them into place and syncs every directory touched once. Concurrent uploads then
+    // share the device flushes instead of paying two each.
+    class GroupCommitter {
+    public:
+        GroupCommitter(std::chrono::microseconds window, size_t max_batch);
+        // Finishes whatever is queued
+        ~GroupCommitter();
+        GroupCommitter(const GroupCommitter &) = delete;
+        GroupCommitter &operator=(const GroupCommitter &) = delete;
+
+        static GroupCommitter &instance();
+
+        // Sync 'temp_path', rename it over 'path' and sync the directory; returns once all of
+        // it is on stable storage. Throws std::runtime_error if any step failed; 'temp_path'
+        // is removed unless it was already renamed.
+        void commit(const std::string &temp_path, const std::string &path);
+
+        struct Stats {
+            uint64_t commits;           // files made durable
+            uint64_t batches;           // rounds of syncs they took
+            uint64_t directory_syncs;
+        };
+        Stats stats() const;
+
+    private:
+        struct Pending {
+            std::string temp_path;
+            std::string path;
+            std::string error = {};     // empty on success
+            bool done = false;
+        };
+
+        const std::chrono::microseconds window;
+        const size_t max_batch;
+
+        mutable std::mutex mutex;       // guards everything below
+        std::condition_variable queued; // wakes the committer
+        std::condition_variable committed;
+        std::vector<Pending *> queue;
+        bool stopping = false;
+        Stats totals{};
+        std::thread committer;          // started last, once the members above exist
+
+        void run();
+        // Returns the number of directories synced
+        static size_t sync_batch(const std::vector<Pending *> &batch);
+    };
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef MMAP_CACHE_HPP
+#define MMAP_CACHE_HPP
+
+#include <list>             // std::list
+#include <memory>           // std::shared_ptr
+#include <mutex>            // std::mutex
+#include <string>           // std::string
+#include <string_view>      // std::string_view
+#include <unordered_map>    // std::unordered_map
+#include <sys/stat.h>       // struct stat
+
+namespace http_server::file_utils {
+    // Read-only mapping of a whole file, unmapped when the last reference is dropped.
+    // Truncating the file in place while it is mapped makes reads fault (SIGBUS), so
+    // writers should replace files by rename, as save_file does.
+    class MappedFile {
+    public:
+        // nullptr if 'path' can't be opened or mapped
+        static std::shared_ptr<const MappedFile> map(const std::string &path, const struct stat &info);
+        ~MappedFile();
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        const char *data() const { return static_cast<const char *>(address); }
+        size_t size() const { return length; }
+        std::string_view view() const { return {data(), length}; }
+
+        // Whether 'info' still describes the file that was mapped
+        bool matches(const struct stat &info) const;
+
+    private:
+        MappedFile(void *address, const struct stat &info);
+
+        void *address;
+        size_t length;
+        dev_t device;
+        ino_t inode;
+        struct timespec modified;
+    };
+
+    // Process-wide cache of file mappings so concurrent readers of a file share one
+    // copy in the page cache. Entries are revalidated with stat() on every lookup
+    // and evicted least recently used once the mapped bytes exceed the budget.
+    class MmapCache {
+    public:
+        explicit MmapCache(size_t max_bytes);
+
+        static MmapCache &instance();
+
+        // nullptr if the file doesn't exist or can't be mapped
+        std::shared_ptr<const MappedFile> get(const std::string &path);
+
+        size_t mapped_bytes() const;
+
+    private:
+        struct Entry {
+            std::shared_ptr<const MappedFile> file;
+            std::list<std::string>::iterator lru_position;
+        };
+
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, Entry> entries;
+        std::list<std::string> lru;     // most recently used first
+        size_t bytes = 0;
+        size_t max_bytes;
+
+        void erase(std::unordered_map<std::string, Entry>::iterator it);
+    };
+}
+
+#endif
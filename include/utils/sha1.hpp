@@ -0,0 +1,16 @@
+#ifndef SHA1_HPP
+#define SHA1_HPP
+
+#include <array>        // std::array
+#include <cstdint>      // uint8_t
+#include <string_view>  // std::string_view
+
+// SHA-1 (FIPS 180-4). Only for protocol needs like the WebSocket handshake;
+// it is not collision resistant and must not be used for security.
+namespace http_server::sha1 {
+    using Digest = std::array<uint8_t, 20>;
+
+    Digest digest(std::string_view data);
+}
+
+#endif
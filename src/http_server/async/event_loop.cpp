@@ -0,0 +1,277 @@
+#include <http_server/async/event_loop.hpp>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+http_server::async::EventLoop::EventLoop(size_t worker_count) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || wake_fd < 0) {
+        throw std::runtime_error("Failed to create event loop: " + std::string(strerror(errno)));
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = wake_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+
+    loop_thread = std::thread([this] { run(); });
+    for (size_t i = 0; i < worker_count; ++i) {
+        workers.emplace_back([this] { worker_main(); });
+    }
+}
+
+http_server::async::EventLoop::~EventLoop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake();
+    loop_thread.join();
+    {
+        std::lock_guard<std::mutex> lock(work_mutex);
+        work.clear();
+        stopping = true;    // the loop thread is gone; workers read this under work_mutex
+    }
+    work_available.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    close(wake_fd);
+    close(epoll_fd);
+}
+
+http_server::async::EventLoop &http_server::async::EventLoop::instance() {
+    // Never destroyed: detached connection threads may still be waiting on it at exit
+    static EventLoop *loop = new EventLoop();
+    return *loop;
+}
+
+void http_server::async::EventLoop::wake() {
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+    (void)ignored;
+}
+
+void http_server::async::EventLoop::schedule(std::coroutine_handle<> handle) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.push_back(handle);
+    }
+    wake();
+}
+
+void http_server::async::EventLoop::add_timer(Waiter &waiter, Clock::time_point deadline) {
+    bool earliest;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        waiter.timer = timers.emplace(deadline, &waiter);
+        waiter.has_timer = true;
+        earliest = waiter.timer == timers.begin();
+    }
+    // The loop may be sleeping until a later deadline
+    if (earliest && !in_loop_thread()) {
+        wake();
+    }
+}
+
+void http_server::async::EventLoop::add_io(Waiter &waiter, int fd, uint32_t events, std::chrono::milliseconds timeout) {
+    bool earliest = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        bool registered = io_waiters.count(fd) != 0;
+        FdWaiters &waiters = io_waiters[fd];
+        Waiter *&slot = (events & EPOLLOUT) ? waiters.writer : waiters.reader;
+        if (slot != nullptr) {
+            throw std::logic_error("fd " + std::to_string(fd) + " already has a " + ((events & EPOLLOUT) ? "writer" : "reader") + " waiting");
+        }
+        epoll_event event{};
+        event.events = events | EPOLLONESHOT;
+        Waiter *other = (events & EPOLLOUT) ? waiters.reader : waiters.writer;
+        if (other != nullptr) {
+            event.events |= other->events;
+        }
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd, registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) < 0) {
+            if (!registered) {
+                io_waiters.erase(fd);
+            }
+            throw std::runtime_error("epoll_ctl failed: " + std::string(strerror(errno)));
+        }
+        waiter.fd = fd;
+        waiter.events = events;
+        slot = &waiter;
+        if (timeout.count() >= 0) {
+            waiter.timer = timers.emplace(Clock::now() + timeout, &waiter);
+            waiter.has_timer = true;
+            earliest = waiter.timer == timers.begin();
+        }
+    }
+    if (earliest && !in_loop_thread()) {
+        wake();
+    }
+}
+
+void http_server::async::EventLoop::rearm(int fd, FdWaiters &waiters) {
+    uint32_t events = 0;
+    if (waiters.reader != nullptr) {
+        events |= waiters.reader->events;
+    }
+    if (waiters.writer != nullptr) {
+        events |= waiters.writer->events;
+    }
+    if (events == 0) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        io_waiters.erase(fd);
+        return;
+    }
+    epoll_event event{};
+    event.events = events | EPOLLONESHOT;
+    event.data.fd = fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+}
+
+void http_server::async::EventLoop::run() {
+    constexpr int MAX_EVENTS = 64;
+    epoll_event events[MAX_EVENTS];
+    std::vector<std::coroutine_handle<>> runnable;
+
+    while (true) {
+        int timeout_ms = -1;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                return;
+            }
+            if (!ready.empty()) {
+                timeout_ms = 0;
+            } else if (!timers.empty()) {
+                auto wait = std::chrono::ceil<std::chrono::milliseconds>(timers.begin()->first - Clock::now());
+                timeout_ms = wait.count() > 0 ? static_cast<int>(wait.count()) : 0;
+            }
+        }
+
+        int count = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout_ms);
+        if (count < 0 && errno != EINTR) {
+            std::cerr << "epoll_wait failed: " << strerror(errno) << std::endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int i = 0; i < count; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == wake_fd) {
+                    uint64_t value;
+                    while (read(wake_fd, &value, sizeof(value)) > 0) {}
+                    continue;
+                }
+                auto it = io_waiters.find(fd);
+                if (it == io_waiters.end()) {
+                    continue;
+                }
+                // Errors and hangups wake both sides; each then sees the failure itself
+                uint32_t ready_events = events[i].events;
+                bool broken = ready_events & (EPOLLERR | EPOLLHUP);
+                FdWaiters &waiters = it->second;
+                for (Waiter **slot : {&waiters.reader, &waiters.writer}) {
+                    Waiter *waiter = *slot;
+                    if (waiter == nullptr || (!broken && !(ready_events & waiter->events))) {
+                        continue;
+                    }
+                    *slot = nullptr;
+                    if (waiter->has_timer) {
+                        timers.erase(waiter->timer);
+                    }
+                    runnable.push_back(waiter->handle);
+                }
+                rearm(fd, waiters);
+            }
+
+            auto now = Clock::now();
+            while (!timers.empty() && timers.begin()->first <= now) {
+                Waiter *waiter = timers.begin()->second;
+                timers.erase(timers.begin());
+                if (waiter->fd >= 0) {
+                    auto it = io_waiters.find(waiter->fd);
+                    if (it != io_waiters.end()) {
+                        FdWaiters &waiters = it->second;
+                        (waiters.reader == waiter ? waiters.reader : waiters.writer) = nullptr;
+                        rearm(waiter->fd, waiters);
+                    }
+                    waiter->timed_out = true;
+                }
+                runnable.push_back(waiter->handle);
+            }
+
+            runnable.insert(runnable.end(), ready.begin(), ready.end());
+            ready.clear();
+        }
+
+        // Resume outside the lock; resumed coroutines register new waiters
+        for (auto handle : runnable) {
+            handle.resume();
+        }
+        runnable.clear();
+    }
+}
+
+void http_server::async::EventLoop::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(work_mutex);
+        work.push_back(std::move(job));
+    }
+    work_available.notify_one();
+}
+
+void http_server::async::EventLoop::worker_main() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(work_mutex);
+            work_available.wait(lock, [this] { return !work.empty() || stopping; });
+            if (work.empty()) {
+                return;
+            }
+            job = std::move(work.front());
+            work.pop_front();
+        }
+        job();
+    }
+}
+
+http_server::async::EventLoop::SleepAwaiter http_server::async::EventLoop::sleep_until(Clock::time_point deadline) {
+    return SleepAwaiter{*this, deadline};
+}
+
+http_server::async::EventLoop::IoAwaiter http_server::async::EventLoop::wait_fd(int fd, uint32_t events, std::chrono::milliseconds timeout) {
+    return IoAwaiter{*this, fd, events, timeout};
+}
+
+http_server::async::EventLoop::SleepAwaiter http_server::async::sleep_for(std::chrono::milliseconds duration) {
+    return EventLoop::instance().sleep_until(Clock::now() + duration);
+}
+
+http_server::async::EventLoop::IoAwaiter http_server::async::wait_readable(int fd, std::chrono::milliseconds timeout) {
+    return EventLoop::instance().wait_fd(fd, EPOLLIN | EPOLLRDHUP, timeout);
+}
+
+http_server::async::EventLoop::IoAwaiter http_server::async::wait_writable(int fd, std::chrono::milliseconds timeout) {
+    return EventLoop::instance().wait_fd(fd, EPOLLOUT, timeout);
+}
+
+namespace {
+    http_server::async::task_detail::Detached run_detached(http_server::async::Task<void> task) {
+        try {
+            co_await task;
+        } catch (const std::exception &e) {
+            std::cerr << "Unhandled exception in spawned task: " << e.what() << std::endl;
+        }
+    }
+}
+
+void http_server::async::spawn(Task<void> task) {
+    run_detached(std::move(task));
+}
@@ -0,0 +1,96 @@
+#include <http_server/async/io.hpp>
+#include <http_server/async/event_loop.hpp>
+#include <utils/file_utils.hpp>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+http_server::async::Task<size_t> http_server::async::recv_some(int fd, char *buffer, size_t length, std::chrono::milliseconds timeout) {
+    while (true) {
+        ssize_t received = ::recv(fd, buffer, length, MSG_DONTWAIT);
+        if (received >= 0) {
+            co_return static_cast<size_t>(received);
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            throw std::runtime_error("recv failed: " + std::string(strerror(errno)));
+        }
+        if (!co_await wait_readable(fd, timeout)) {
+            throw TimeoutError("Timed out waiting to read");
+        }
+    }
+}
+
+http_server::async::Task<void> http_server::async::send_all(int fd, std::string_view data, std::chrono::milliseconds timeout) {
+    while (!data.empty()) {
+        ssize_t sent = ::send(fd, data.data(), data.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent >= 0) {
+            data.remove_prefix(static_cast<size_t>(sent));
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            throw std::runtime_error("send failed: " + std::string(strerror(errno)));
+        }
+        if (!co_await wait_writable(fd, timeout)) {
+            throw TimeoutError("Timed out waiting to write");
+        }
+    }
+}
+
+http_server::async::Task<int> http_server::async::connect(std::string host, uint16_t port, std::chrono::milliseconds timeout) {
+    // getaddrinfo blocks, so resolve on a worker
+    using AddrInfo = std::unique_ptr<addrinfo, decltype(&freeaddrinfo)>;
+    AddrInfo addresses = co_await EventLoop::instance().offload([&] {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *result = nullptr;
+        int status = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result);
+        if (status != 0) {
+            throw std::runtime_error("Failed to resolve " + host + ": " + gai_strerror(status));
+        }
+        return AddrInfo(result, &freeaddrinfo);
+    });
+
+    std::string last_error = "no addresses";
+    for (addrinfo *address = addresses.get(); address; address = address->ai_next) {
+        int fd = ::socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd < 0) {
+            last_error = strerror(errno);
+            continue;
+        }
+        if (::connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+            co_return fd;
+        }
+        if (errno == EINPROGRESS) {
+            if (!co_await wait_writable(fd, timeout)) {
+                close(fd);
+                throw TimeoutError("Timed out connecting to " + host + ":" + std::to_string(port));
+            }
+            int error = 0;
+            socklen_t error_length = sizeof(error);
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_length);
+            if (error == 0) {
+                co_return fd;
+            }
+            errno = error;
+        }
+        last_error = strerror(errno);
+        close(fd);
+    }
+    throw std::runtime_error("Failed to connect to " + host + ":" + std::to_string(port) + ": " + last_error);
+}
+
+http_server::async::Task<std::optional<std::string>> http_server::async::read_file(std::string path) {
+    co_return co_await EventLoop::instance().offload([&] {
+        return file_utils::read_file(path);
+    });
+}
@@ -0,0 +1,135 @@
+#include <http_server/cache.hpp>
+#include <algorithm>
+#include <exception>
+
+http_server::ResponseCache::ResponseCache(size_t max_bytes, size_t shard_count) {
+    shard_count = std::max<size_t>(shard_count, 1);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards.push_back(std::make_unique<Shard>());
+    }
+    max_bytes_per_shard = max_bytes / shard_count;
+}
+
+http_server::ResponseCache::Shard &http_server::ResponseCache::shard_for(const std::string &key) {
+    return *shards[std::hash<std::string>{}(key) % shards.size()];
+}
+
+http_server::HTTP_Response http_server::ResponseCache::get_or_compute(const std::string &key, std::chrono::milliseconds ttl, const Compute &compute) {
+    Shard &shard = shard_for(key);
+    std::promise<HTTP_Response> promise;
+    {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.end()) {
+            if (Clock::now() < it->second.expires) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lru_position);
+                return it->second.response;
+            }
+            erase(shard, it);
+        }
+
+        auto flight = shard.in_flight.find(key);
+        if (flight != shard.in_flight.end()) {
+            // Someone is already computing this response; wait for theirs
+            std::shared_future<HTTP_Response> result = flight->second;
+            lock.unlock();
+            HTTP_Response response = result.get();  // rethrows the computing request's exception
+            if (!response.body_stream) {
+                return response;
+            }
+            // A streamed body can only be consumed once, so compute our own
+            return compute();
+        }
+        shard.in_flight.emplace(key, promise.get_future().share());
+    }
+
+    HTTP_Response response;
+    try {
+        response = compute();
+    } catch (...) {
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.in_flight.erase(key);
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.in_flight.erase(key);
+        if (ttl.count() > 0 && is_cacheable(response)) {
+            store(shard, key, response, ttl);
+        }
+    }
+    promise.set_value(response);
+    return response;
+}
+
+bool http_server::ResponseCache::is_cacheable(const HTTP_Response &response) {
+    if (response.body_stream || response.status_code < 200 || response.status_code >= 500) {
+        return false;
+    }
+    if (response.headers.contains("Set-Cookie")) {
+        return false;
+    }
+    if (const std::string *cache_control = response.headers.get("Cache-Control")) {
+        if (cache_control->find("no-store") != std::string::npos || cache_control->find("private") != std::string::npos) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void http_server::ResponseCache::store(Shard &shard, const std::string &key, const HTTP_Response &response, std::chrono::milliseconds ttl) {
+    size_t bytes = footprint(key, response);
+    if (bytes > max_bytes_per_shard) {
+        return;
+    }
+
+    auto existing = shard.entries.find(key);
+    if (existing != shard.entries.end()) {
+        erase(shard, existing);
+    }
+    // Evict least recently used entries until the new one fits
+    while (shard.bytes + bytes > max_bytes_per_shard && !shard.lru.empty()) {
+        erase(shard, shard.entries.find(shard.lru.back()));
+    }
+
+    shard.lru.push_front(key);
+    shard.entries.emplace(key, Entry{response, Clock::now() + ttl, bytes, shard.lru.begin()});
+    shard.bytes += bytes;
+}
+
+void http_server::ResponseCache::erase(Shard &shard, std::unordered_map<std::string, Entry>::iterator it) {
+    shard.bytes -= it->second.bytes;
+    shard.lru.erase(it->second.lru_position);
+    shard.entries.erase(it);
+}
+
+size_t http_server::ResponseCache::footprint(const std::string &key, const HTTP_Response &response) {
+    // Key is held twice (map and LRU list); a rough per-entry overhead covers the nodes
+    size_t bytes = 2 * key.size() + response.status_message.size() + response.body.size() + sizeof(Entry) + 64;
+    response.headers.for_each([&](std::string_view name, const std::string &value) {
+        bytes += name.size() + value.size();
+    });
+    return bytes;
+}
+
+size_t http_server::ResponseCache::size_bytes() const {
+    size_t total = 0;
+    for (const auto &shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        total += shard->bytes;
+    }
+    return total;
+}
+
+void http_server::ResponseCache::clear() {
+    for (const auto &shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->entries.clear();
+        shard->lru.clear();
+        shard->bytes = 0;
+    }
+}
@@ -0,0 +1,119 @@
+#include <http_server/chunked.hpp>
+#include <algorithm>    // std::min
+
+http_server::ChunkedDecoder::ChunkedDecoder(ChunkedLimits limits) : limits(limits) {}
+
+bool http_server::ChunkedDecoder::take_line(std::string_view input, size_t &pos, size_t max, const char *what) {
+    size_t newline = input.find('\n', pos);
+    size_t end = (newline == std::string_view::npos) ? input.size() : newline + 1;
+    if(line.size() + (end - pos) > max) {
+        throw ChunkedError(std::string(what) + " too long");
+    }
+    line.append(input.substr(pos, end - pos));
+    pos = end;
+    if(newline == std::string_view::npos) {
+        return false;
+    }
+    if(line.size() < 2 || line[line.size() - 2] != '\r') {
+        throw ChunkedError(std::string(what) + " not terminated by CRLF");
+    }
+    line.resize(line.size() - 2);
+    return true;
+}
+
+void http_server::ChunkedDecoder::parse_size_line() {
+    // chunk-size [ chunk-ext ]; extensions are ignored
+    size_t size = 0;
+    size_t digits = 0;
+    for(char c : line) {
+        int value;
+        if(c >= '0' && c <= '9') {
+            value = c - '0';
+        } else if(c >= 'a' && c <= 'f') {
+            value = c - 'a' + 10;
+        } else if(c >= 'A' && c <= 'F') {
+            value = c - 'A' + 10;
+        } else if(c == ';' || c == ' ' || c == '\t') {
+            break;
+        } else {
+            throw ChunkedError("Invalid chunk size");
+        }
+        if(++digits > sizeof(size_t) * 2) {
+            throw ChunkedError("Chunk size overflows");
+        }
+        size = size * 16 + static_cast<size_t>(value);
+    }
+    if(digits == 0) {
+        throw ChunkedError("Missing chunk size");
+    }
+    line.clear();
+
+    if(size == 0) {
+        state = State::TRAILER_LINE;
+        return;
+    }
+    if(size > limits.max_body - total) {
+        throw ChunkedError("Request body exceeds " + std::to_string(limits.max_body) + " bytes");
+    }
+    remaining = size;
+    state = State::DATA;
+}
+
+void http_server::ChunkedDecoder::parse_trailer_line() {
+    if(line.empty()) {
+        state = State::DONE;
+        return;
+    }
+    // Same leniency as the request head: malformed fields are skipped
+    size_t colon = line.find(':');
+    if(colon != std::string::npos && colon > 0) {
+        size_t value_start = line.find_first_not_of(" \t", colon + 1);
+        std::string value = (value_start == std::string::npos) ? "" : line.substr(value_start);
+        trailer_headers.set(line.substr(0, colon), std::move(value));
+    }
+    line.clear();
+}
+
+size_t http_server::ChunkedDecoder::decode(std::string_view input, const BodySink &sink) {
+    size_t pos = 0;
+    while(pos < input.size() && state != State::DONE && !sink_refused) {
+        switch(state) {
+        case State::SIZE_LINE:
+            if(take_line(input, pos, limits.max_line, "Chunk size line")) {
+                parse_size_line();
+            }
+            break;
+        case State::DATA: {
+            size_t length = std::min(remaining, input.size() - pos);
+            bool accepted = sink(input.data() + pos, length);
+            pos += length;
+            remaining -= length;
+            total += length;
+            if(!accepted) {
+                sink_refused = true;
+            } else if(remaining == 0) {
+                state = State::DATA_END;
+            }
+            break;
+        }
+        case State::DATA_END:
+            // CRLF closing the chunk data
+            if(take_line(input, pos, 2, "Chunk data")) {
+                if(!line.empty()) {
+                    throw ChunkedError("Chunk data longer than its size");
+                }
+                state = State::SIZE_LINE;
+            }
+            break;
+        case State::TRAILER_LINE:
+            if(take_line(input, pos, limits.max_trailers - trailer_bytes, "Trailer section")) {
+                trailer_bytes += line.size() + 2;
+                parse_trailer_line();
+            }
+            break;
+        case State::DONE:
+            break;
+        }
+    }
+    return pos;
+}
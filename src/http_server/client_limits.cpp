@@ -0,0 +1,170 @@
+#include <http_server/client_limits.hpp>
+#include <algorithm>
+#include <cstring>
+#include <netinet/in.h>
+
+namespace {
+    constexpr uint64_t COUNT_MASK = 0xFFFFFFFFu;
+
+    uint32_t key_of(uint64_t owner) {
+        return static_cast<uint32_t>(owner >> 32);
+    }
+}
+
+http_server::ClientLimiter::ClientLimiter(ClientLimits limits, size_t capacity) : settings(limits) {
+    settings.request_burst = std::max<uint32_t>(settings.request_burst, 1);
+    emission_interval = settings.requests_per_second > 0
+        ? std::max<int64_t>(static_cast<int64_t>(1e9 / settings.requests_per_second), 1)
+        : 0;
+    burst_tolerance = emission_interval * settings.request_burst;
+    shard_size = std::max(capacity / SHARD_COUNT, MAX_PROBE);
+    for (Table *table : {&ipv4, &ipv6}) {
+        for (auto &shard : table->shards) {
+            shard = std::make_unique<Slot[]>(shard_size);
+        }
+    }
+}
+
+http_server::ClientKey http_server::ClientLimiter::client_key(const sockaddr_storage &address) {
+    if (address.ss_family == AF_INET) {
+        return reinterpret_cast<const sockaddr_in &>(address).sin_addr.s_addr;
+    }
+    if (address.ss_family != AF_INET6) {
+        return 0;
+    }
+    const in6_addr &ip6 = reinterpret_cast<const sockaddr_in6 &>(address).sin6_addr;
+    uint32_t words[4];
+    std::memcpy(words, ip6.s6_addr, sizeof(words));
+    if (IN6_IS_ADDR_V4MAPPED(&ip6)) {
+        return words[3];
+    }
+    // One host usually owns a whole /64, so limit the prefix rather than each address
+    uint32_t folded = words[0] ^ (words[1] * 0x9E3779B1u);
+    return IPV6_CLIENT | (folded != 0 ? folded : 1);
+}
+
+int64_t http_server::ClientLimiter::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool http_server::ClientLimiter::is_idle(const Slot &slot, int64_t now) const {
+    // No open connections and a full bucket: forgetting this client changes nothing
+    return (slot.owner.load() & COUNT_MASK) == 0 && slot.arrival.load() <= now;
+}
+
+http_server::ClientLimiter::Slot *http_server::ClientLimiter::find_slot(Table &table, uint32_t key) {
+    uint32_t hash = key * 0x9E3779B1u;
+    Slot *shard = table.shards[hash % SHARD_COUNT].get();
+    size_t start = (hash / SHARD_COUNT) % shard_size;
+    // Keys never go back to 0, so a client is always found before the first free slot
+    for (size_t i = 0; i < MAX_PROBE; ++i) {
+        Slot &slot = shard[(start + i) % shard_size];
+        uint32_t holder = key_of(slot.owner.load(std::memory_order_acquire));
+        if (holder == key) {
+            return &slot;
+        }
+        if (holder == 0) {
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+http_server::ClientLimiter::Slot *http_server::ClientLimiter::acquire_slot(ClientKey client, int64_t now) {
+    Table &table = table_for(client);
+    uint32_t key = static_cast<uint32_t>(client);
+    if (Slot *slot = find_slot(table, key)) {
+        return slot;
+    }
+
+    // Claims in a shard take turns, and each looks again first: two connections from a new
+    // client must not each claim a slot for it
+    uint32_t hash = key * 0x9E3779B1u;
+    std::lock_guard<std::mutex> lock(table.claiming[hash % SHARD_COUNT]);
+    Slot *shard = table.shards[hash % SHARD_COUNT].get();
+    size_t start = (hash / SHARD_COUNT) % shard_size;
+    Slot *idle = nullptr;
+    for (size_t i = 0; i < MAX_PROBE; ++i) {
+        Slot &slot = shard[(start + i) % shard_size];
+        uint64_t owner = slot.owner.load(std::memory_order_acquire);
+        if (key_of(owner) == key) {
+            return &slot;
+        }
+        if (key_of(owner) == 0) {
+            slot.owner.store(uint64_t{key} << 32, std::memory_order_release);
+            return &slot;
+        }
+        if (!idle && is_idle(slot, now)) {
+            idle = &slot;
+        }
+    }
+    if (idle) {
+        // Fails if the old client connected again since: its count is no longer 0
+        uint64_t owner = idle->owner.load();
+        if ((owner & COUNT_MASK) == 0 && idle->arrival.load() <= now &&
+            idle->owner.compare_exchange_strong(owner, uint64_t{key} << 32)) {
+            return idle;
+        }
+    }
+    return nullptr;
+}
+
+std::optional<http_server::ClientConnection> http_server::ClientLimiter::try_acquire_connection(ClientKey client) {
+    if (settings.max_connections_per_ip == 0 || client == 0) {
+        return ClientConnection{client, false};
+    }
+    uint32_t key = static_cast<uint32_t>(client);
+    while (true) {
+        Slot *slot = acquire_slot(client, now_ns());
+        if (!slot) {
+            return ClientConnection{client, false};    // table full: fail open
+        }
+        uint64_t owner = slot->owner.load();
+        // Counting fails, and the lookup starts over, if the slot was reclaimed in between
+        while (key_of(owner) == key) {
+            if ((owner & COUNT_MASK) >= settings.max_connections_per_ip) {
+                return std::nullopt;
+            }
+            if (slot->owner.compare_exchange_weak(owner, owner + 1)) {
+                return ClientConnection{client, true};
+            }
+        }
+    }
+}
+
+void http_server::ClientLimiter::release_connection(const ClientConnection &connection) {
+    // Uncounted connections must not take back a place a counted one holds
+    if (!connection.counted) {
+        return;
+    }
+    uint32_t key = static_cast<uint32_t>(connection.client);
+    if (Slot *slot = find_slot(table_for(connection.client), key)) {
+        // A slot with connections counted is never reclaimed, so this is still the client's
+        uint64_t owner = slot->owner.load();
+        while (key_of(owner) == key && (owner & COUNT_MASK) > 0 &&
+               !slot->owner.compare_exchange_weak(owner, owner - 1)) {}
+    }
+}
+
+std::chrono::nanoseconds http_server::ClientLimiter::try_request(ClientKey client) {
+    if (emission_interval == 0 || client == 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    int64_t now = now_ns();
+    Slot *slot = acquire_slot(client, now);
+    if (!slot) {
+        return std::chrono::nanoseconds(0);
+    }
+    // GCRA: each request pushes the arrival time one interval further; refuse once
+    // it would run more than a burst ahead of now
+    int64_t arrival = slot->arrival.load();
+    while (true) {
+        int64_t next = std::max(arrival, now) + emission_interval;
+        if (next - now > burst_tolerance) {
+            return std::chrono::nanoseconds(next - now - burst_tolerance);
+        }
+        if (slot->arrival.compare_exchange_weak(arrival, next)) {
+            return std::chrono::nanoseconds(0);
+        }
+    }
+}
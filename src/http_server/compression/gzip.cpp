@@ -1,10 +1,12 @@
 #include <http_server/compression/gzip.hpp>
+#include <http_server/trace.hpp>
 #include <zlib.h>
 #include <stdexcept>
 #include <iostream>
 
 namespace http_server::compression {
     std::optional<std::string> GzipCompressor::compress(const std::string &data) {
+        trace::Span span("gzip");
         try {
             z_stream zstream{};
             if(deflateInit2(&zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
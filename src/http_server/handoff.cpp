@@ -0,0 +1,227 @@
+#include <http_server/handoff.hpp>
+#include <cerrno>           // errno
+#include <cstring>          // strerror(), memcpy()
+#include <poll.h>           // poll()
+#include <sstream>          // std::istringstream
+#include <stdexcept>        // std::runtime_error
+#include <sys/socket.h>     // sendmsg(), recvmsg(), SCM_RIGHTS
+#include <sys/stat.h>       // stat()
+#include <sys/un.h>         // sockaddr_un
+#include <unistd.h>         // close(), unlink()
+
+namespace {
+    constexpr size_t MAX_SOCKETS = 64;          // descriptors in one handoff message
+    constexpr size_t MAX_MESSAGE = 64 << 10;
+    constexpr char GREETING[] = "http_server handoff 1\n";
+    constexpr char READY[] = "ready\n";
+
+    sockaddr_un control_address(const std::string &path) {
+        sockaddr_un address{};
+        if(path.empty() || path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("Invalid control socket path: " + path);
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return address;
+    }
+
+    void close_all(const std::vector<int> &fds) {
+        for(int fd : fds) {
+            close(fd);
+        }
+    }
+
+    // One message, the descriptors in 'fds' riding along with it
+    bool send_message(int fd, const std::string &text, const std::vector<int> &fds = {}) {
+        iovec iov{const_cast<char *>(text.data()), text.size()};
+        msghdr message{};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        std::vector<char> control(fds.empty() ? 0 : CMSG_SPACE(sizeof(int) * fds.size()));
+        if(!fds.empty()) {
+            message.msg_control = control.data();
+            message.msg_controllen = control.size();
+            cmsghdr *header = CMSG_FIRSTHDR(&message);
+            header->cmsg_level = SOL_SOCKET;
+            header->cmsg_type = SCM_RIGHTS;
+            header->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+            std::memcpy(CMSG_DATA(header), fds.data(), sizeof(int) * fds.size());
+        }
+        ssize_t sent;
+        do {
+            sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+        } while(sent < 0 && errno == EINTR);
+        return sent == static_cast<ssize_t>(text.size());
+    }
+
+    // Next message within 'timeout_ms', with any descriptors it carried appended to 'fds'.
+    // Empty if the peer closed or nothing came in time.
+    std::string receive_message(int fd, std::vector<int> &fds, int timeout_ms) {
+        pollfd readable{fd, POLLIN, 0};
+        int ready;
+        do {
+            ready = poll(&readable, 1, timeout_ms);
+        } while(ready < 0 && errno == EINTR);
+        if(ready <= 0) {
+            return "";
+        }
+
+        std::string text(MAX_MESSAGE, '\0');
+        iovec iov{text.data(), text.size()};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_SOCKETS)];
+        msghdr message{};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        ssize_t received;
+        do {
+            received = recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+        } while(received < 0 && errno == EINTR);
+        if(received <= 0) {
+            return "";
+        }
+        for(cmsghdr *header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header)) {
+            if(header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+                size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                const unsigned char *data = CMSG_DATA(header);
+                for(size_t i = 0; i < count; ++i) {
+                    int passed;
+                    std::memcpy(&passed, data + i * sizeof(int), sizeof(int));
+                    fds.push_back(passed);
+                }
+            }
+        }
+        if(message.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+            close_all(fds);
+            fds.clear();
+            throw std::runtime_error("Handoff message truncated");
+        }
+        text.resize(static_cast<size_t>(received));
+        return text;
+    }
+}
+
+int http_server::handoff::open_control(const std::string &path) {
+    sockaddr_un address = control_address(path);
+    struct stat info;
+    if(stat(path.c_str(), &info) == 0) {
+        if(!S_ISSOCK(info.st_mode)) {
+            throw std::runtime_error("Refusing to replace non-socket file: " + path);
+        }
+        unlink(path.c_str());
+    }
+
+    // Sequenced packets keep each message, and the descriptors sent with it, in one piece
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(fd < 0) {
+        throw std::runtime_error("Failed to create control socket");
+    }
+    if(bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0 || listen(fd, 1) < 0) {
+        int error = errno;
+        close(fd);
+        throw std::runtime_error("Failed to listen on " + path + ": " + strerror(error));
+    }
+    return fd;
+}
+
+bool http_server::handoff::hand_over(int connection, const std::vector<Listener> &listeners, int control_fd,
+                                     const std::string &control_path, int timeout_ms) {
+    std::vector<int> ignored;
+    try {
+        if(receive_message(connection, ignored, timeout_ms) != GREETING) {
+            close_all(ignored);
+            return false;
+        }
+    } catch(const std::runtime_error &) {
+        return false;
+    }
+
+    // A line per descriptor, in order: "listener <tls> <spec> <unix path>" or "control <path>"
+    std::string text;
+    std::vector<int> fds;
+    for(const auto &listener : listeners) {
+        text += "listener\t" + std::string(listener.tls ? "1" : "0") + "\t" + listener.spec + "\t" + listener.unix_path + "\n";
+        fds.push_back(listener.fd);
+    }
+    text += "control\t" + control_path + "\n";
+    fds.push_back(control_fd);
+    if(fds.size() > MAX_SOCKETS || !send_message(connection, text, fds)) {
+        return false;
+    }
+
+    try {
+        return receive_message(connection, ignored, timeout_ms) == READY;
+    } catch(const std::runtime_error &) {
+        return false;
+    }
+}
+
+http_server::handoff::Inherited http_server::handoff::inherit(const std::string &path, int timeout_ms) {
+    sockaddr_un address = control_address(path);
+    int connection = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(connection < 0) {
+        throw std::runtime_error("Failed to create socket");
+    }
+    if(connect(connection, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+        int error = errno;
+        close(connection);
+        throw std::runtime_error("Failed to connect to " + path + ": " + strerror(error));
+    }
+
+    std::vector<int> fds;
+    std::string text;
+    try {
+        if(send_message(connection, GREETING)) {
+            text = receive_message(connection, fds, timeout_ms);
+        }
+    } catch(const std::runtime_error &) {
+        close(connection);
+        throw;
+    }
+
+    Inherited inherited;
+    inherited.connection = connection;
+    std::istringstream lines(text);
+    std::string line;
+    size_t next = 0;
+    bool valid = !text.empty();
+    while(valid && std::getline(lines, line)) {
+        std::vector<std::string> fields;
+        std::istringstream split(line);
+        std::string field;
+        while(std::getline(split, field, '\t')) {
+            fields.push_back(field);
+        }
+        if(!line.empty() && line.back() == '\t') {
+            fields.emplace_back();
+        }
+        if(next >= fds.size()) {
+            valid = false;
+        } else if(fields.size() == 4 && fields[0] == "listener") {
+            Listener listener;
+            listener.fd = fds[next++];
+            listener.tls = fields[1] == "1";
+            listener.spec = fields[2];
+            listener.unix_path = fields[3];
+            inherited.listeners.push_back(std::move(listener));
+        } else if(fields.size() == 2 && fields[0] == "control") {
+            inherited.control_fd = fds[next++];
+            inherited.control_path = fields[1];
+        } else {
+            valid = false;
+        }
+    }
+    if(!valid || next != fds.size()) {
+        close_all(fds);
+        close(connection);
+        throw std::runtime_error("No usable handoff from " + path);
+    }
+    return inherited;
+}
+
+void http_server::handoff::ready(int &connection) {
+    send_message(connection, READY);
+    close(connection);
+    connection = -1;
+}
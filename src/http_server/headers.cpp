@@ -0,0 +1,86 @@
+#include <http_server/headers.hpp>
+#include <algorithm>        // std::find_if
+
+namespace http_server {
+    Headers::Headers(std::initializer_list<value_type> init) {
+        for (const auto &[name, value] : init) {
+            set(name, value);
+        }
+    }
+
+    const std::string* Headers::get(HTTP_HEADER header) const {
+        if (!(known_present & bit(header))) {
+            return nullptr;
+        }
+        return &known_values[static_cast<std::size_t>(header)];
+    }
+
+    const std::string* Headers::get(std::string_view name) const {
+        if (auto known = lookup_header(name)) {
+            return get(*known);
+        }
+        auto it = std::find_if(extra.begin(), extra.end(), [&](const value_type &entry) {
+            return iequals(entry.first, name);
+        });
+        return it == extra.end() ? nullptr : &it->second;
+    }
+
+    void Headers::set(HTTP_HEADER header, std::string value) {
+        known_values[static_cast<std::size_t>(header)] = std::move(value);
+        known_present |= bit(header);
+    }
+
+    void Headers::set(std::string_view name, std::string value) {
+        (*this)[name] = std::move(value);
+    }
+
+    std::string& Headers::operator[](HTTP_HEADER header) {
+        std::string &slot = known_values[static_cast<std::size_t>(header)];
+        if (!(known_present & bit(header))) {
+            slot.clear();
+            known_present |= bit(header);
+        }
+        return slot;
+    }
+
+    std::string& Headers::operator[](std::string_view name) {
+        if (auto known = lookup_header(name)) {
+            return (*this)[*known];
+        }
+        auto it = std::find_if(extra.begin(), extra.end(), [&](const value_type &entry) {
+            return iequals(entry.first, name);
+        });
+        if (it != extra.end()) {
+            return it->second;
+        }
+        extra.emplace_back(std::string(name), std::string());
+        return extra.back().second;
+    }
+
+    bool Headers::erase(HTTP_HEADER header) {
+        if (!(known_present & bit(header))) {
+            return false;
+        }
+        known_present &= ~bit(header);
+        known_values[static_cast<std::size_t>(header)].clear();
+        return true;
+    }
+
+    bool Headers::erase(std::string_view name) {
+        if (auto known = lookup_header(name)) {
+            return erase(*known);
+        }
+        auto it = std::find_if(extra.begin(), extra.end(), [&](const value_type &entry) {
+            return iequals(entry.first, name);
+        });
+        if (it == extra.end()) {
+            return false;
+        }
+        extra.erase(it);
+        return true;
+    }
+
+    std::size_t Headers::size() const {
+        return static_cast<std::size_t>(__builtin_popcountll(known_present)) + extra.size();
+    }
+}
@@ -0,0 +1,84 @@
+#include <http_server/http2/frame.hpp>
+
+namespace http_server::http2 {
+    FrameHeader parse_frame_header(const uint8_t *data) {
+        FrameHeader header;
+        header.length = (uint32_t{data[0]} << 16) | (uint32_t{data[1]} << 8) | uint32_t{data[2]};
+        header.type = static_cast<FrameType>(data[3]);
+        header.flags = data[4];
+        header.stream_id = read_u32(data + 5) & 0x7FFFFFFFu;
+        return header;
+    }
+
+    std::string serialize_frame(FrameType type, uint8_t frame_flags, uint32_t stream_id, std::string_view payload) {
+        std::string frame;
+        frame.reserve(FRAME_HEADER_SIZE + payload.size());
+        frame.push_back(static_cast<char>(payload.size() >> 16));
+        frame.push_back(static_cast<char>(payload.size() >> 8));
+        frame.push_back(static_cast<char>(payload.size()));
+        frame.push_back(static_cast<char>(type));
+        frame.push_back(static_cast<char>(frame_flags));
+        append_u32(frame, stream_id & 0x7FFFFFFFu);
+        frame.append(payload);
+        return frame;
+    }
+
+    void apply_settings(Settings &settings, std::string_view payload) {
+        if (payload.size() % 6 != 0) {
+            throw ConnectionError(ErrorCode::FRAME_SIZE_ERROR, "SETTINGS payload is not a multiple of 6");
+        }
+        const auto *p = reinterpret_cast<const uint8_t *>(payload.data());
+        for (size_t i = 0; i < payload.size(); i += 6) {
+            uint16_t id = static_cast<uint16_t>((p[i] << 8) | p[i + 1]);
+            uint32_t value = read_u32(p + i + 2);
+            switch (static_cast<SettingId>(id)) {
+                case SettingId::HEADER_TABLE_SIZE:
+                    settings.header_table_size = value;
+                    break;
+                case SettingId::ENABLE_PUSH:
+                    if (value > 1) {
+                        throw ConnectionError(ErrorCode::PROTOCOL_ERROR, "ENABLE_PUSH must be 0 or 1");
+                    }
+                    settings.enable_push = value;
+                    break;
+                case SettingId::MAX_CONCURRENT_STREAMS:
+                    settings.max_concurrent_streams = value;
+                    break;
+                case SettingId::INITIAL_WINDOW_SIZE:
+                    if (value > 0x7FFFFFFFu) {
+                        throw ConnectionError(ErrorCode::FLOW_CONTROL_ERROR, "INITIAL_WINDOW_SIZE too large");
+                    }
+                    settings.initial_window_size = value;
+                    break;
+                case SettingId::MAX_FRAME_SIZE:
+                    if (value < 16384 || value > 16777215) {
+                        throw ConnectionError(ErrorCode::PROTOCOL_ERROR, "MAX_FRAME_SIZE out of range");
+                    }
+                    settings.max_frame_size = value;
+                    break;
+                case SettingId::MAX_HEADER_LIST_SIZE:
+                    settings.max_header_list_size = value;
+                    break;
+                default:
+                    // Unknown settings must be ignored
+                    break;
+            }
+        }
+    }
+
+    std::string serialize_settings(const Settings &settings) {
+        std::string payload;
+        auto add = [&](SettingId id, uint32_t value) {
+            payload.push_back(static_cast<char>(static_cast<uint16_t>(id) >> 8));
+            payload.push_back(static_cast<char>(static_cast<uint16_t>(id)));
+            append_u32(payload, value);
+        };
+        add(SettingId::MAX_CONCURRENT_STREAMS, settings.max_concurrent_streams);
+        add(SettingId::INITIAL_WINDOW_SIZE, settings.initial_window_size);
+        add(SettingId::MAX_FRAME_SIZE, settings.max_frame_size);
+        if (settings.max_header_list_size != 0xFFFFFFFFu) {
+            add(SettingId::MAX_HEADER_LIST_SIZE, settings.max_header_list_size);
+        }
+        return payload;
+    }
+}
@@ -0,0 +1,487 @@
+#include <http_server/http2/hpack.hpp>
+#include <http_server/http2/frame.hpp>
+#include <array>            // std::array
+#include <cstdint>          // SIZE_MAX, UINT32_MAX
+
+namespace http_server::http2 {
+    namespace {
+        const std::array<HeaderField, 61> &static_table() {
+            static const std::array<HeaderField, 61> table = {{
+                {":authority", ""},
+                {":method", "GET"},
+                {":method", "POST"},
+                {":path", "/"},
+                {":path", "/index.html"},
+                {":scheme", "http"},
+                {":scheme", "https"},
+                {":status", "200"},
+                {":status", "204"},
+                {":status", "206"},
+                {":status", "304"},
+                {":status", "400"},
+                {":status", "404"},
+                {":status", "500"},
+                {"accept-charset", ""},
+                {"accept-encoding", "gzip, deflate"},
+                {"accept-language", ""},
+                {"accept-ranges", ""},
+                {"accept", ""},
+                {"access-control-allow-origin", ""},
+                {"age", ""},
+                {"allow", ""},
+                {"authorization", ""},
+                {"cache-control", ""},
+                {"content-disposition", ""},
+                {"content-encoding", ""},
+                {"content-language", ""},
+                {"content-length", ""},
+                {"content-location", ""},
+                {"content-range", ""},
+                {"content-type", ""},
+                {"cookie", ""},
+                {"date", ""},
+                {"etag", ""},
+                {"expect", ""},
+                {"expires", ""},
+                {"from", ""},
+                {"host", ""},
+                {"if-match", ""},
+                {"if-modified-since", ""},
+                {"if-none-match", ""},
+                {"if-range", ""},
+                {"if-unmodified-since", ""},
+                {"last-modified", ""},
+                {"link", ""},
+                {"location", ""},
+                {"max-forwards", ""},
+                {"proxy-authenticate", ""},
+                {"proxy-authorization", ""},
+                {"range", ""},
+                {"referer", ""},
+                {"refresh", ""},
+                {"retry-after", ""},
+                {"server", ""},
+                {"set-cookie", ""},
+                {"strict-transport-security", ""},
+                {"transfer-encoding", ""},
+                {"user-agent", ""},
+                {"vary", ""},
+                {"via", ""},
+                {"www-authenticate", ""},
+            }};
+            return table;
+        }
+
+        // RFC 7541 Appendix B, indexed by symbol; 256 is EOS
+        const std::array<uint32_t, 257> HUFFMAN_CODES = {
+            0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+            0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+            0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+            0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+            0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+            0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+            0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+            0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+            0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+            0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+            0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+            0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+            0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+            0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+            0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+            0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+            0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+            0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+            0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+            0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+            0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+            0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+            0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+            0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+            0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+            0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+            0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+            0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+            0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+            0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+            0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+            0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+            0x3fffffff,
+        };
+
+        const std::array<uint8_t, 257> HUFFMAN_CODE_LENGTHS = {
+            13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+            28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+            6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+            5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+            13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+            7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+            15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+            6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+            20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+            24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+            22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+            21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+            26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+            19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+            20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+            26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+            30,
+        };
+
+        // Binary trie over the code table; leaves carry the symbol
+        struct HuffmanTrie {
+            struct Node {
+                int16_t child[2] = {-1, -1};
+                int16_t symbol = -1;
+            };
+            std::vector<Node> nodes;
+
+            HuffmanTrie() {
+                nodes.reserve(513);
+                nodes.emplace_back();
+                for (int symbol = 0; symbol < 257; ++symbol) {
+                    uint32_t code = HUFFMAN_CODES[symbol];
+                    int length = HUFFMAN_CODE_LENGTHS[symbol];
+                    size_t node = 0;
+                    for (int bit = length - 1; bit >= 0; --bit) {
+                        int branch = (code >> bit) & 1;
+                        if (nodes[node].child[branch] < 0) {
+                            nodes[node].child[branch] = static_cast<int16_t>(nodes.size());
+                            nodes.emplace_back();
+                        }
+                        node = static_cast<size_t>(nodes[node].child[branch]);
+                    }
+                    nodes[node].symbol = static_cast<int16_t>(symbol);
+                }
+            }
+        };
+
+        const HuffmanTrie &huffman_trie() {
+            static const HuffmanTrie trie;
+            return trie;
+        }
+
+        size_t entry_size(const HeaderField &field) {
+            return field.first.size() + field.second.size() + 32;
+        }
+
+        [[noreturn]] void compression_error(const std::string &what) {
+            throw ConnectionError(ErrorCode::COMPRESSION_ERROR, "HPACK: " + what);
+        }
+
+        std::string decode_string(const uint8_t *&pos, const uint8_t *end) {
+            if (pos >= end) {
+                compression_error("truncated string literal");
+            }
+            bool huffman = (*pos & 0x80) != 0;
+            uint32_t length = decode_integer(pos, end, 7);
+            if (static_cast<size_t>(end - pos) < length) {
+                compression_error("string literal exceeds header block");
+            }
+            std::string_view raw(reinterpret_cast<const char *>(pos), length);
+            pos += length;
+            return huffman ? huffman_decode(raw) : std::string(raw);
+        }
+    }
+
+    void HpackTable::add(std::string name, std::string value) {
+        HeaderField field{std::move(name), std::move(value)};
+        size_t needed = entry_size(field);
+        if (needed > max_size) {
+            // An entry larger than the table empties it and is not added
+            evict_to(0);
+            return;
+        }
+        evict_to(max_size - needed);
+        size += needed;
+        entries.push_front(std::move(field));
+    }
+
+    void HpackTable::set_max_size(size_t new_size) {
+        max_size = new_size;
+        evict_to(max_size);
+    }
+
+    void HpackTable::evict_to(size_t limit) {
+        while (size > limit && !entries.empty()) {
+            size -= entry_size(entries.back());
+            entries.pop_back();
+        }
+    }
+
+    const HeaderField* HpackTable::at(size_t index) const {
+        const auto &fixed = static_table();
+        if (index == 0) {
+            return nullptr;
+        }
+        if (index <= fixed.size()) {
+            return &fixed[index - 1];
+        }
+        index -= fixed.size() + 1;
+        return index < entries.size() ? &entries[index] : nullptr;
+    }
+
+    size_t HpackTable::find(std::string_view name, std::string_view value, bool &full_match) const {
+        const auto &fixed = static_table();
+        size_t name_match = 0;
+        full_match = false;
+        for (size_t i = 0; i < fixed.size(); ++i) {
+            if (fixed[i].first == name) {
+                if (fixed[i].second == value) {
+                    full_match = true;
+                    return i + 1;
+                }
+                if (!name_match) {
+                    name_match = i + 1;
+                }
+            }
+        }
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (entries[i].first == name) {
+                if (entries[i].second == value) {
+                    full_match = true;
+                    return fixed.size() + i + 1;
+                }
+                if (!name_match) {
+                    name_match = fixed.size() + i + 1;
+                }
+            }
+        }
+        return name_match;
+    }
+
+    std::vector<HeaderField> HpackDecoder::decode(std::string_view block) {
+        bool too_large = false;
+        return decode(block, SIZE_MAX, too_large);
+    }
+
+    std::vector<HeaderField> HpackDecoder::decode(std::string_view block, size_t max_list_size, bool &too_large) {
+        std::vector<HeaderField> headers;
+        const auto *pos = reinterpret_cast<const uint8_t *>(block.data());
+        const auto *end = pos + block.size();
+        bool header_seen = false;
+        size_t list_size = 0;
+        too_large = false;
+        // Indexed fields can expand a few bytes into whole table entries, so count before keeping
+        auto keep = [&](const std::string &name, const std::string &value) {
+            list_size += name.size() + value.size() + 32;
+            too_large = too_large || list_size > max_list_size;
+            return !too_large;
+        };
+
+        while (pos < end) {
+            uint8_t first = *pos;
+            if (first & 0x80) {
+                // Indexed header field
+                uint32_t index = decode_integer(pos, end, 7);
+                const HeaderField *field = table.at(index);
+                if (!field) {
+                    compression_error("invalid index " + std::to_string(index));
+                }
+                if (keep(field->first, field->second)) {
+                    headers.push_back(*field);
+                }
+                header_seen = true;
+            } else if ((first & 0xE0) == 0x20) {
+                // Dynamic table size update, only allowed before the first header
+                if (header_seen) {
+                    compression_error("table size update after header field");
+                }
+                uint32_t size = decode_integer(pos, end, 5);
+                if (size > settings_max) {
+                    compression_error("table size update exceeds advertised limit");
+                }
+                table.set_max_size(size);
+            } else {
+                // Literal: with incremental indexing (01), without indexing (0000) or never indexed (0001)
+                bool index_it = (first & 0xC0) == 0x40;
+                int prefix = index_it ? 6 : 4;
+                uint32_t name_index = decode_integer(pos, end, prefix);
+                std::string name;
+                if (name_index) {
+                    const HeaderField *field = table.at(name_index);
+                    if (!field) {
+                        compression_error("invalid name index " + std::to_string(name_index));
+                    }
+                    name = field->first;
+                } else {
+                    name = decode_string(pos, end);
+                }
+                std::string value = decode_string(pos, end);
+                if (index_it) {
+                    table.add(name, value);
+                }
+                if (keep(name, value)) {
+                    headers.emplace_back(std::move(name), std::move(value));
+                }
+                header_seen = true;
+            }
+        }
+        return headers;
+    }
+
+    void HpackEncoder::set_max_table_size(size_t size) {
+        // Never use more than the default even if the peer offers more
+        size_t capped = std::min<size_t>(size, 4096);
+        if (capped != table.get_max_size()) {
+            table.set_max_size(capped);
+            pending_size_update = true;
+        }
+    }
+
+    bool HpackEncoder::should_index(std::string_view name) {
+        // Values that change on every response only churn the table
+        return name != "content-length" && name != "date" && name != "etag" && name != "last-modified" &&
+               name != "set-cookie" && name != "authorization" && name != "location" && name != "content-range";
+    }
+
+    std::string HpackEncoder::encode(const std::vector<HeaderField> &headers) {
+        std::string out;
+        if (pending_size_update) {
+            encode_integer(out, static_cast<uint32_t>(table.get_max_size()), 5, 0x20);
+            pending_size_update = false;
+        }
+        for (const auto &[name, value] : headers) {
+            bool full_match = false;
+            size_t index = table.find(name, value, full_match);
+            if (full_match) {
+                encode_integer(out, static_cast<uint32_t>(index), 7, 0x80);
+                continue;
+            }
+            bool index_it = should_index(name);
+            if (index_it) {
+                encode_integer(out, static_cast<uint32_t>(index), 6, 0x40);
+            } else {
+                encode_integer(out, static_cast<uint32_t>(index), 4, 0x00);
+            }
+            if (!index) {
+                encode_string(out, name);
+            }
+            encode_string(out, value);
+            if (index_it) {
+                table.add(name, value);
+            }
+        }
+        return out;
+    }
+
+    void encode_integer(std::string &out, uint32_t value, int prefix_bits, uint8_t first_byte_flags) {
+        uint32_t limit = (1u << prefix_bits) - 1;
+        if (value < limit) {
+            out.push_back(static_cast<char>(first_byte_flags | value));
+            return;
+        }
+        out.push_back(static_cast<char>(first_byte_flags | limit));
+        value -= limit;
+        while (value >= 128) {
+            out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    uint32_t decode_integer(const uint8_t *&pos, const uint8_t *end, int prefix_bits) {
+        if (pos >= end) {
+            compression_error("truncated integer");
+        }
+        uint32_t limit = (1u << prefix_bits) - 1;
+        uint32_t value = *pos++ & limit;
+        if (value < limit) {
+            return value;
+        }
+        // Accumulated wide so a hostile encoder can't wrap a huge length or index to a small one
+        uint64_t wide = value;
+        for (int shift = 0; ; shift += 7) {
+            if (pos >= end) {
+                compression_error("truncated integer");
+            }
+            if (shift > 28) {
+                compression_error("integer overflow");
+            }
+            uint8_t byte = *pos++;
+            wide += static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (wide > UINT32_MAX) {
+                compression_error("integer overflow");
+            }
+            if (!(byte & 0x80)) {
+                return static_cast<uint32_t>(wide);
+            }
+        }
+    }
+
+    void encode_string(std::string &out, std::string_view value) {
+        size_t huffman_length = huffman_encoded_length(value);
+        if (huffman_length < value.size()) {
+            encode_integer(out, static_cast<uint32_t>(huffman_length), 7, 0x80);
+            out += huffman_encode(value);
+        } else {
+            encode_integer(out, static_cast<uint32_t>(value.size()), 7, 0x00);
+            out.append(value);
+        }
+    }
+
+    size_t huffman_encoded_length(std::string_view value) {
+        size_t bits = 0;
+        for (unsigned char c : value) {
+            bits += HUFFMAN_CODE_LENGTHS[c];
+        }
+        return (bits + 7) / 8;
+    }
+
+    std::string huffman_encode(std::string_view value) {
+        std::string out;
+        out.reserve(huffman_encoded_length(value));
+        uint64_t buffer = 0;
+        int pending_bits = 0;
+        for (unsigned char c : value) {
+            buffer = (buffer << HUFFMAN_CODE_LENGTHS[c]) | HUFFMAN_CODES[c];
+            pending_bits += HUFFMAN_CODE_LENGTHS[c];
+            while (pending_bits >= 8) {
+                pending_bits -= 8;
+                out.push_back(static_cast<char>(buffer >> pending_bits));
+            }
+        }
+        if (pending_bits > 0) {
+            // Pad with the most significant bits of EOS (all ones)
+            out.push_back(static_cast<char>((buffer << (8 - pending_bits)) | (0xFF >> pending_bits)));
+        }
+        return out;
+    }
+
+    std::string huffman_decode(std::string_view encoded) {
+        const HuffmanTrie &trie = huffman_trie();
+        std::string out;
+        out.reserve(encoded.size() * 8 / 5);
+        size_t node = 0;
+        int depth = 0;
+        bool all_ones = true;
+        for (unsigned char byte : encoded) {
+            for (int bit = 7; bit >= 0; --bit) {
+                int branch = (byte >> bit) & 1;
+                int16_t next = trie.nodes[node].child[branch];
+                if (next < 0) {
+                    compression_error("invalid Huffman code");
+                }
+                node = static_cast<size_t>(next);
+                ++depth;
+                all_ones = all_ones && branch;
+                int16_t symbol = trie.nodes[node].symbol;
+                if (symbol >= 0) {
+                    if (symbol == 256) {
+                        compression_error("EOS in Huffman string");
+                    }
+                    out.push_back(static_cast<char>(symbol));
+                    node = 0;
+                    depth = 0;
+                    all_ones = true;
+                }
+            }
+        }
+        // Leftover bits must be a short all-ones prefix of EOS
+        if (depth > 7 || !all_ones) {
+            compression_error("invalid Huffman padding");
+        }
+        return out;
+    }
+}
@@ -0,0 +1,831 @@
+#include <http_server/http2/session.hpp>
+#include <http_server/status.hpp>
+#include <http_server/config.hpp>
+#include <http_server/trace.hpp>
+#include <utils/buffer_pool.hpp>
+#include <algorithm>        // std::min
+#include <cctype>           // std::tolower
+#include <cerrno>           // errno
+#include <cstring>          // strerror
+#include <iostream>         // std::cout, std::cerr
+#include <thread>           // std::thread
+#include <poll.h>           // poll()
+#include <sys/socket.h>     // recv(), send()
+
+namespace http_server::http2 {
+    namespace {
+        constexpr int64_t MAX_WINDOW = 0x7FFFFFFF;
+        constexpr int DRAIN_POLL_MS = 100;
+
+        std::string lower(std::string_view name) {
+            std::string out(name);
+            for (char &c : out) {
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+            return out;
+        }
+
+        // Hop-by-hop headers have no meaning in HTTP/2 and must not be sent
+        bool is_connection_specific(std::string_view name) {
+            return iequals(name, "connection") || iequals(name, "keep-alive") || iequals(name, "transfer-encoding") ||
+                   iequals(name, "upgrade") || iequals(name, "proxy-connection");
+        }
+
+        // Strip the padding (and optional priority block) from HEADERS and DATA payloads
+        std::string_view unpad(const FrameHeader &header, std::string_view payload, bool has_priority) {
+            size_t pad = 0;
+            if (header.flags & flags::PADDED) {
+                if (payload.empty()) {
+                    throw ConnectionError(ErrorCode::FRAME_SIZE_ERROR, "padded frame without pad length");
+                }
+                pad = static_cast<uint8_t>(payload[0]);
+                payload.remove_prefix(1);
+            }
+            if (has_priority && (header.flags & flags::PRIORITY)) {
+                if (payload.size() < 5) {
+                    throw ConnectionError(ErrorCode::FRAME_SIZE_ERROR, "HEADERS priority block truncated");
+                }
+                payload.remove_prefix(5);
+            }
+            if (pad > payload.size()) {
+                throw ConnectionError(ErrorCode::PROTOCOL_ERROR, "padding exceeds frame payload");
+            }
+            payload.remove_suffix(pad);
+            return payload;
+        }
+
+        std::string base64url_decode(std::string_view input) {
+            auto value = [](char c) -> int {
+                if (c >= 'A' && c <= 'Z') return c - 'A';
+                if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+                if (c >= '0' && c <= '9') return c - '0' + 52;
+                if (c == '-' || c == '+') return 62;
+                if (c == '_' || c == '/') return 63;
+                return -1;
+            };
+            std::string out;
+            uint32_t buffer = 0;
+            int bits = 0;
+            for (char c : input) {
+                int v = value(c);
+                if (v < 0) {
+                    continue; // padding or whitespace
+                }
+                buffer = (buffer << 6) | static_cast<uint32_t>(v);
+                bits += 6;
+                if (bits >= 8) {
+                    bits -= 8;
+                    out.push_back(static_cast<char>((buffer >> bits) & 0xFF));
+                }
+            }
+            return out;
+        }
+    }
+
+    Session::Session(int fd, Dispatch dispatch, std::string client_ip, std::string initial)
+        : fd(fd), dispatch(std::move(dispatch)), client_ip(std::move(client_ip)), in(std::move(initial)) {
+        // Idle reads give up after the socket's receive timeout, as on HTTP/1.1
+        timeval timeout{};
+        socklen_t length = sizeof(timeout);
+        if (getsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, &length) == 0 && (timeout.tv_sec > 0 || timeout.tv_usec > 0)) {
+            idle_timeout_ms = static_cast<int>(timeout.tv_sec * 1000 + timeout.tv_usec / 1000);
+        }
+    }
+
+    Session::~Session() {
+        // Stream threads reference this session; wait until the last one is gone
+        std::unique_lock<std::mutex> lock(state_mutex);
+        closing = true;
+        state_changed.notify_all();
+        state_changed.wait(lock, [&] { return running_streams == 0; });
+    }
+
+    void Session::set_upgrade(HTTP_Request request, const std::string &settings_payload) {
+        apply_settings(peer_settings, base64url_decode(settings_payload));
+        encoder.set_max_table_size(peer_settings.header_table_size);
+
+        upgrade_stream = std::make_shared<Stream>();
+        upgrade_stream->id = 1;
+        upgrade_stream->request = std::move(request);
+        upgrade_stream->send_window = peer_settings.initial_window_size;
+        upgrade_stream->remote_closed = true;
+        last_stream_id = 1;
+    }
+
+    void Session::drain_on(int fd) {
+        drain_fd = fd;
+    }
+
+    void Session::check_heads(HeadCheck check, size_t max_body_size) {
+        head_check = std::move(check);
+        this->max_body_size = max_body_size;
+    }
+
+    bool Session::fill(size_t needed) {
+        while (in.size() - in_offset < needed) {
+            if (in_offset > 0) {
+                in.erase(0, in_offset);
+                in_offset = 0;
+            }
+            if (in.empty()) {
+                // Don't hold receive storage, or cached pool buffers, while waiting on an idle connection
+                std::string().swap(in);
+                buffer_pool::flush_thread_cache();
+            }
+
+            // While draining, wake now and then to close as soon as the last stream is done
+            bool winding_down = draining || peer_went_away;
+            pollfd waiting[2] = {{fd, POLLIN, 0}, {draining ? -1 : drain_fd, POLLIN, 0}};
+            int ready = poll(waiting, 2, winding_down ? DRAIN_POLL_MS : idle_timeout_ms);
+            if (ready < 0 && errno == EINTR) {
+                continue;
+            }
+            if (ready > 0 && waiting[0].revents == 0) {
+                draining = true;
+                go_away(ErrorCode::NO_ERROR, "");
+                continue;
+            }
+            if (ready == 0) {
+                // Keep-alive timeout: only close once no stream is still being served
+                std::lock_guard<std::mutex> lock(state_mutex);
+                if (winding_down ? !streams.empty() : running_streams > 0) {
+                    continue;
+                }
+                return false;
+            }
+
+            buffer_pool::Buffer buffer = buffer_pool::acquire(config::READ_BUFFER_SIZE);
+            ssize_t bytes_read = ready < 0 ? -1 : recv(fd, buffer.data(), buffer.size(), 0);
+            if (bytes_read <= 0) {
+                if (bytes_read < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                    std::cerr << "HTTP/2 read error from " << client_ip << ": " << strerror(errno) << std::endl;
+                }
+                return false;
+            }
+            in.append(buffer.data(), static_cast<size_t>(bytes_read));
+        }
+        return true;
+    }
+
+    void Session::run() {
+        // Our SETTINGS must be the first frame we send
+        Settings local;
+        local.max_concurrent_streams = MAX_CONCURRENT_STREAMS;
+        local.initial_window_size = LOCAL_WINDOW_SIZE;
+        local.max_header_list_size = MAX_HEADER_LIST_SIZE;
+        std::string preface = serialize_frame(FrameType::SETTINGS, 0, 0, serialize_settings(local));
+        std::string window_increment;
+        append_u32(window_increment, LOCAL_WINDOW_SIZE - 65535);
+        preface += serialize_frame(FrameType::WINDOW_UPDATE, 0, 0, window_increment);
+        {
+            std::lock_guard<std::mutex> lock(write_mutex);
+            if (!write_all(preface)) {
+                return;
+            }
+        }
+
+        if (!fill(CONNECTION_PREFACE.size()) ||
+            std::string_view(in).substr(in_offset, CONNECTION_PREFACE.size()) != CONNECTION_PREFACE) {
+            go_away(ErrorCode::PROTOCOL_ERROR, "invalid connection preface");
+            return;
+        }
+        in_offset += CONNECTION_PREFACE.size();
+
+        if (upgrade_stream) {
+            {
+                std::lock_guard<std::mutex> lock(state_mutex);
+                streams[1] = upgrade_stream;
+            }
+            start_stream(upgrade_stream);
+        }
+
+        try {
+            while (fill(FRAME_HEADER_SIZE)) {
+                FrameHeader header = parse_frame_header(reinterpret_cast<const uint8_t *>(in.data() + in_offset));
+                if (header.length > local.max_frame_size) {
+                    throw ConnectionError(ErrorCode::FRAME_SIZE_ERROR, "frame larger than SETTINGS_MAX_FRAME_SIZE");
+                }
+                if (!fill(FRAME_HEADER_SIZE + header.length)) {
+                    break;
+                }
+                std::string_view payload(in.data() + in_offset + FRAME_HEADER_SIZE, header.length);
+                in_offset += FRAME_HEADER_SIZE + header.length;
+
+                try {
+                    handle_frame(header, payload);
+                } catch (const StreamError &e) {
+                    std::cerr << "HTTP/2 stream " << e.stream_id << " error: " << e.what() << std::endl;
+                    reset_stream(e.stream_id, e.code);
+                }
+
+                // After the peer's GOAWAY its open streams still complete (their bodies and
+                // window updates keep arriving here); stop once the last one is done
+                if (peer_went_away) {
+                    std::lock_guard<std::mutex> lock(state_mutex);
+                    if (streams.empty()) {
+                        break;
+                    }
+                }
+            }
+        } catch (const ConnectionError &e) {
+            std::cerr << "HTTP/2 connection error from " << client_ip << ": " << e.what() << std::endl;
+            go_away(e.code, e.what());
+        }
+
+        // Nothing more will be read: unblock senders waiting for window updates
+        std::unique_lock<std::mutex> lock(state_mutex);
+        closing = true;
+        state_changed.notify_all();
+        state_changed.wait(lock, [&] { return running_streams == 0; });
+        lock.unlock();
+        if (peer_went_away) {
+            go_away(ErrorCode::NO_ERROR, "");
+        }
+    }
+
+    void Session::handle_frame(const FrameHeader &header, std::string_view payload) {
+        if (continuation_stream != 0 &&
+            (header.type != FrameType::CONTINUATION || header.stream_id != continuation_stream)) {
+            throw ConnectionError(ErrorCode::PROTOCOL_ERROR, "expected CONTINUATION");
+        }
+
+        switch (header.type) {
+            case FrameType::DATA:
+                handle_data(header, payload);
+                break;
+            case FrameType::HEADERS:
+                handle_headers(header, payload);
+                break;
+            case FrameType::CONTINUATION:
+                if (continuation_stream == 0) {
+                    throw ConnectionError(ErrorCode::PROTOCOL_ERROR, "unexpected CONTINUATION");
+                }
+                header_block.append(payload);
+                check_header_block();
+                if (header.flags & flags::END_HEADERS) {
+                    uint32_t stream_id = continuation_stream;
+                    continuation_stream = 0;
+                    finish_header_block(stream_id, continuation_end_stream);
+                }
+                break;
+            case FrameType::PRIORITY:
+                if (header.stream_id == 0) {
+                    throw ConnectionError(ErrorCode::PROTOCOL_ERROR, "PRIORITY on stream 0");
+                }
+                if (payload.size() != 5) {
+                    throw StreamError(header.stream_id, ErrorCode::FRAME_SIZE_ERROR, "PRIORITY length must be 5");
+                }
+                break;
+            case FrameType::RST_STREAM:
+                handle_rst_stream(header, payload);
+                break;
+            case FrameType::SETTINGS:
+                handle_settings(header, payload);
+                break;
+            case FrameType::PUSH_PROMISE:
+                throw ConnectionError(ErrorCode::PROTOCOL_ERROR, "clients cannot push");
+            case FrameType::PING:
+                if (header.stream_id != 0) {
+                    throw ConnectionError(ErrorCode::PROTOCOL_ERROR, "PING on a stream");
+                }
+                if (payload.size() != 8) {
+                    throw ConnectionError(ErrorCode::FRAME_SIZE_ERROR, "PING length must be 8");
+                }
+                if (!(header.flags & flags::ACK)) {
+                    write_frame(FrameType::PING, flags::ACK, 0, payload);
+                }
+                break;
+            case FrameType::WINDOW_UPDATE:
+                handle_window_update(header, payload);
+                break;
+            case FrameType::GOAWAY:
+                if (header.stream_id != 0) {
+                    throw ConnectionError(ErrorCode::PROTOCOL_ERROR, "GOAWAY on a stream");
+                }
+                if (payload.size() < 8) {
+                    throw ConnectionError(ErrorCode::FRAME_SIZE_ERROR, "GOAWAY shorter than 8 bytes");
+                }
+                peer_went_away = true;
+                break;
+            default:
+                // Unknown frame types are ignored
+                break;
+        }
+    }
+
+    void Session::handle_data(const FrameHeader &header, std::string_view payload) {
+        if (header.stream_id == 0) {
+            throw ConnectionError(ErrorCode::PROTOCOL_ERROR, "DATA on stream 0");
+        }
+        // The whole frame, padding included, counts against the windows, even on a closed stream
+        connection_receive_window -= header.length;
+        if (connection_receive_window < 0) {
+            throw ConnectionError(ErrorCode::FLOW_CONTROL_ERROR, "DATA exceeds the connection window");
+        }
+        if (header.length > 0) {
+            // Connection credit goes straight back; the stream windows bound what is buffered
+            std::string increment;
+            append_u32(increment, header.length);
+            write_frame(FrameType::WINDOW_UPDATE, 0, 0, increment);
+            connection_receive_window += header.length;
+        }
+        std::string_view data = unpad(header, payload, false);
+
+        std::shared_ptr<Stream> stream;
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            auto it = streams.find(header.stream_id);
+            if (it != streams.end()) {
+                stream = it->second;
+            }
+        }
+        if (!stream) {
+            if (header.stream_id > last_stream_id) {
+                throw ConnectionError(ErrorCode::PROTOCOL_ERROR, "DATA on idle stream");
+            }
+            throw StreamError(header.stream_id, ErrorCode::STREAM_CLOSED, "DATA on closed stream");
+        }
+        if (stream->remote_closed) {
+            throw StreamError(header.stream_id, ErrorCode::STREAM_CLOSED, "DATA after END_STREAM");
+        }
+        if (stream->refusal) {
+            return;
+        }
+
+        bool end_stream = (header.flags & flags::END_STREAM) != 0;
+        bool too_large = stream->request.body.size() + data.size() > max_body_size;
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            stream->receive_window -= header.length;
+            if (stream->receive_window < 0) {
+                throw StreamError(header.stream_id, ErrorCode::FLOW_CONTROL_ERROR, "DATA exceeds the stream window");
+            }
+            if (too_large) {
+                // Answered now, like an HTTP/1.1 body past the limit; the rest of it is discarded
+                buffered_bodies -= stream->request.body.size();
+                std::string().swap(stream->request.body);
+                stream->refusal = HTTP_Response {
+                    (int)HTTP_STATUS_CODE::CONTENT_TOO_LARGE,
+                    "Content Too Large",
+                    {},
+                    "Request body is limited to " + std::to_string(max_body_size) + " bytes"
+                };
+            } else {
+                stream->request.body.append(data);
+                buffered_bodies += data.size();
+                if (!end_stream) {
+                    stream->withheld_credit += header.length;
+                }
+            }
+        }
+        if (end_stream || too_large) {
+            stream->remote_closed = end_stream;
+            start_stream(stream);
+        }
+
+        std::string frames;
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            frames = take_stream_credit();
+        }
+        if (!frames.empty()) {
+            std::lock_guard<std::mutex> lock(write_mutex);
+            write_all(frames);
+        }
+    }
+
+    std::string Session::take_stream_credit() {
+        // Credit is returned as bodies are buffered while they fit the budget. Past it only the
+        // oldest stream still receiving gets its window back, so one upload can always finish
+        // and free the rest; the others stall at a window's worth each.
+        std::string frames;
+        bool within_budget = buffered_bodies <= MAX_BUFFERED_BODIES;
+        for (auto &[id, stream] : streams) {
+            if (stream->dispatched) {
+                continue;
+            }
+            if (stream->withheld_credit > 0) {
+                std::string increment;
+                append_u32(increment, stream->withheld_credit);
+                frames += serialize_frame(FrameType::WINDOW_UPDATE, 0, id, increment);
+                stream->receive_window += stream->withheld_credit;
+                stream->withheld_credit = 0;
+            }
+            if (!within_budget) {
+                break;
+            }
+        }
+        return frames;
+    }
+
+    void Session::erase_stream(std::map<uint32_t, std::shared_ptr<Stream>>::iterator it) {
+        buffered_bodies -= it->second->request.body.size();
+        streams.erase(it);
+    }
+
+    void Session::handle_headers(const FrameHeader &header, std::string_view payload) {
+        if (header.stream_id == 0) {
+            throw ConnectionError(ErrorCode::PROTOCOL_ERROR, "HEADERS on stream 0");
+        }
+        header_block.assign(unpad(header, payload, true));
+        check_header_block();
+        bool end_stream = (header.flags & flags::END_STREAM) != 0;
+        if (header.flags & flags::END_HEADERS) {
+            finish_header_block(header.stream_id, end_stream);
+        } else {
+            continuation_stream = header.stream_id;
+            continuation_end_stream = end_stream;
+        }
+    }
+
+    void Session::check_header_block() {
+        // A block this size can only decode past the advertised limit; don't wait for the rest of it
+        if (header_block.size() > MAX_HEADER_LIST_SIZE) {
+            throw ConnectionError(ErrorCode::ENHANCE_YOUR_CALM, "header block exceeds SETTINGS_MAX_HEADER_LIST_SIZE");
+        }
+    }
+
+    void Session::finish_header_block(uint32_t stream_id, bool end_stream) {
+        // Always decode, even for streams we refuse, to keep the HPACK state in sync
+        bool too_large = false;
+        std::vector<HeaderField> fields = decoder.decode(header_block, MAX_HEADER_LIST_SIZE, too_large);
+        header_block.clear();
+
+        std::shared_ptr<Stream> stream;
+        size_t open_streams;
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            auto it = streams.find(stream_id);
+            if (it != streams.end()) {
+                stream = it->second;
+            }
+            open_streams = streams.size();
+        }
+
+        if (stream) {
+            // Trailers: must end the stream; their fields are not exposed to handlers
+            if (stream->remote_closed || !end_stream) {
+                throw StreamError(stream_id, ErrorCode::PROTOCOL_ERROR, "unexpected HEADERS on open stream");
+            }
+            stream->remote_closed = true;
+            start_stream(stream);
+            return;
+        }
+
+        if (stream_id % 2 == 0 || stream_id <= last_stream_id) {
+            throw ConnectionError(ErrorCode::PROTOCOL_ERROR, "invalid new stream id " + std::to_string(stream_id));
+        }
+        last_stream_id = stream_id;
+        if (draining) {
+            // Sent after our GOAWAY; the client may retry it elsewhere
+            throw StreamError(stream_id, ErrorCode::REFUSED_STREAM, "server is draining");
+        }
+        if (peer_went_away) {
+            throw StreamError(stream_id, ErrorCode::REFUSED_STREAM, "client sent GOAWAY");
+        }
+        if (open_streams >= MAX_CONCURRENT_STREAMS) {
+            throw StreamError(stream_id, ErrorCode::REFUSED_STREAM, "too many concurrent streams");
+        }
+
+        stream = std::make_shared<Stream>();
+        stream->id = stream_id;
+        HTTP_Request &request = stream->request;
+        request.version = "HTTP/2.0";
+        request.remote_address = client_ip;
+        if (too_large) {
+            // The decoder dropped the fields past the limit; answer without the handler
+            stream->refusal = HTTP_Response {
+                (int)HTTP_STATUS_CODE::REQUEST_HEADER_FIELDS_TOO_LARGE,
+                "Request Header Fields Too Large",
+                {},
+                ""
+            };
+            fields.clear();
+        }
+        bool regular_seen = false;
+        for (auto &[name, value] : fields) {
+            if (!name.empty() && name[0] == ':') {
+                if (regular_seen) {
+                    throw StreamError(stream_id, ErrorCode::PROTOCOL_ERROR, "pseudo-header after regular header");
+                }
+                if (name == ":method") {
+                    request.method = value;
+                } else if (name == ":path") {
+                    request.path = value;
+                } else if (name == ":authority") {
+                    request.headers.set(HTTP_HEADER::HOST, value);
+                } else if (name != ":scheme") {
+                    throw StreamError(stream_id, ErrorCode::PROTOCOL_ERROR, "unknown pseudo-header " + name);
+                }
+                continue;
+            }
+            regular_seen = true;
+            if (const std::string *existing = request.headers.get(name)) {
+                // Repeated fields fold into one; cookies were split for compression (RFC 9113 section 8.2.3)
+                std::string folded = *existing + (name == "cookie" ? "; " : ", ") + value;
+                request.headers.set(name, std::move(folded));
+            } else {
+                request.headers.set(name, std::move(value));
+            }
+        }
+        if (!stream->refusal && (request.method.empty() || request.path.empty())) {
+            throw StreamError(stream_id, ErrorCode::PROTOCOL_ERROR, "missing :method or :path");
+        }
+        negotiate_encoding(request);
+        if (!stream->refusal && head_check) {
+            // Before any of the body is taken, as HTTP/1.1 checks the head before reading one
+            stream->refusal = head_check(request);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            stream->send_window = peer_settings.initial_window_size;
+            streams[stream_id] = stream;
+        }
+        stream->remote_closed = end_stream;
+        if (end_stream || stream->refusal) {
+            start_stream(stream);
+        }
+    }
+
+    void Session::handle_settings(const FrameHeader &header, std::string_view payload) {
+        if (header.stream_id != 0) {
+            throw ConnectionError(ErrorCode::PROTOCOL_ERROR, "SETTINGS on a stream");
+        }
+        if (header.flags & flags::ACK) {
+            if (!payload.empty()) {
+                throw ConnectionError(ErrorCode::FRAME_SIZE_ERROR, "SETTINGS ACK with payload");
+            }
+            return;
+        }
+
+        uint32_t table_size;
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            uint32_t old_window = peer_settings.initial_window_size;
+            apply_settings(peer_settings, payload);
+            int64_t delta = static_cast<int64_t>(peer_settings.initial_window_size) - old_window;
+            for (auto &[id, stream] : streams) {
+                stream->send_window += delta;
+                if (stream->send_window > MAX_WINDOW) {
+                    throw ConnectionError(ErrorCode::FLOW_CONTROL_ERROR, "stream window overflow");
+                }
+            }
+            table_size = peer_settings.header_table_size;
+            state_changed.notify_all();
+        }
+
+        std::lock_guard<std::mutex> lock(write_mutex);
+        encoder.set_max_table_size(table_size);
+        write_all(serialize_frame(FrameType::SETTINGS, flags::ACK, 0, ""));
+    }
+
+    void Session::handle_window_update(const FrameHeader &header, std::string_view payload) {
+        if (payload.size() != 4) {
+            throw ConnectionError(ErrorCode::FRAME_SIZE_ERROR, "WINDOW_UPDATE length must be 4");
+        }
+        uint32_t increment = read_u32(reinterpret_cast<const uint8_t *>(payload.data())) & 0x7FFFFFFFu;
+        if (increment == 0) {
+            if (header.stream_id == 0) {
+                throw ConnectionError(ErrorCode::PROTOCOL_ERROR, "zero WINDOW_UPDATE");
+            }
+            throw StreamError(header.stream_id, ErrorCode::PROTOCOL_ERROR, "zero WINDOW_UPDATE");
+        }
+
+        std::lock_guard<std::mutex> lock(state_mutex);
+        if (header.stream_id == 0) {
+            connection_send_window += increment;
+            if (connection_send_window > MAX_WINDOW) {
+                throw ConnectionError(ErrorCode::FLOW_CONTROL_ERROR, "connection window overflow");
+            }
+        } else {
+            auto it = streams.find(header.stream_id);
+            if (it == streams.end()) {
+                return; // the stream finished while the update was in flight
+            }
+            it->second->send_window += increment;
+            if (it->second->send_window > MAX_WINDOW) {
+                throw StreamError(header.stream_id, ErrorCode::FLOW_CONTROL_ERROR, "stream window overflow");
+            }
+        }
+        state_changed.notify_all();
+    }
+
+    void Session::handle_rst_stream(const FrameHeader &header, std::string_view payload) {
+        if (header.stream_id == 0) {
+            throw ConnectionError(ErrorCode::PROTOCOL_ERROR, "RST_STREAM on stream 0");
+        }
+        if (payload.size() != 4) {
+            throw ConnectionError(ErrorCode::FRAME_SIZE_ERROR, "RST_STREAM length must be 4");
+        }
+        std::lock_guard<std::mutex> lock(state_mutex);
+        auto it = streams.find(header.stream_id);
+        if (it == streams.end()) {
+            return;
+        }
+        it->second->reset = true;
+        if (!it->second->dispatched) {
+            erase_stream(it);
+        }
+        state_changed.notify_all();
+    }
+
+    void Session::start_stream(const std::shared_ptr<Stream> &stream) {
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            stream->dispatched = true;
+            ++running_streams;
+        }
+        std::thread([this, stream]() {
+            serve_stream(stream);
+            std::string frames;
+            {
+                std::lock_guard<std::mutex> lock(state_mutex);
+                auto it = streams.find(stream->id);
+                if (it != streams.end()) {
+                    erase_stream(it);
+                    // Its body no longer counts: streams held back may get their windows now
+                    frames = take_stream_credit();
+                }
+            }
+            if (!frames.empty()) {
+                std::lock_guard<std::mutex> lock(write_mutex);
+                write_all(frames);
+            }
+            // Last: the session may be destroyed once no stream is running
+            std::lock_guard<std::mutex> lock(state_mutex);
+            --running_streams;
+            state_changed.notify_all();
+        }).detach();
+    }
+
+    void Session::serve_stream(const std::shared_ptr<Stream> &stream) {
+        trace::Request traced;
+        if (traced) {
+            traced.set_label(stream->request.method + " " + stream->request.path);
+        }
+        HTTP_Response response;
+        try {
+            response = stream->refusal ? *stream->refusal : dispatch(stream->request);
+            if (response.deferred) {
+                // The stream has this thread to itself; wait here for the event loop
+                response = async::sync_wait(response.deferred());
+            }
+        } catch (const std::exception &e) {
+            std::cerr << "Error dispatching request: " << e.what() << std::endl;
+            response = HTTP_Response {
+                (int)HTTP_STATUS_CODE::INTERNAL_SERVER_ERROR,
+                "Internal Server Error",
+                {},
+                "An error occurred while processing your request"
+            };
+        }
+        {
+            trace::Span span("send");
+            send_response(stream, response);
+        }
+        if (stream->refusal && !stream->remote_closed) {
+            // Answered before the request ended: ask the client to stop sending the body
+            reset_stream(stream->id, ErrorCode::NO_ERROR);
+        }
+
+        std::cout << client_ip << " - " << stream->request.method << " " << stream->request.path
+                  << " - " << response.status_code << " (h2 stream " << stream->id << ")" << std::endl;
+    }
+
+    void Session::send_response(const std::shared_ptr<Stream> &stream, const HTTP_Response &response) {
+        std::vector<HeaderField> fields;
+        fields.emplace_back(":status", std::to_string(response.status_code));
+        response.headers.for_each([&](std::string_view name, const std::string &value) {
+            if (!is_connection_specific(name)) {
+                fields.emplace_back(lower(name), value);
+            }
+        });
+        bool has_body = !response.body.empty() || response.body_stream;
+        if (!response.headers.contains(HTTP_HEADER::CONTENT_LENGTH) && !response.body_stream) {
+            fields.emplace_back("content-length", std::to_string(response.body.size()));
+        }
+
+        uint32_t max_frame_size;
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            if (stream->reset || closing) {
+                return;
+            }
+            max_frame_size = peer_settings.max_frame_size;
+        }
+
+        {
+            // HEADERS and its CONTINUATIONs must not interleave with other frames
+            std::lock_guard<std::mutex> lock(write_mutex);
+            std::string block = encoder.encode(fields);
+            std::string frames;
+            size_t offset = 0;
+            do {
+                size_t chunk = std::min<size_t>(block.size() - offset, max_frame_size);
+                bool last = offset + chunk == block.size();
+                uint8_t frame_flags = last ? flags::END_HEADERS : 0;
+                if (offset == 0 && !has_body) {
+                    frame_flags |= flags::END_STREAM;
+                }
+                frames += serialize_frame(offset == 0 ? FrameType::HEADERS : FrameType::CONTINUATION, frame_flags,
+                                          stream->id, std::string_view(block).substr(offset, chunk));
+                offset += chunk;
+            } while (offset < block.size());
+            if (!write_all(frames)) {
+                return;
+            }
+        }
+
+        if (response.body_stream) {
+            bool completed = response.body_stream([&](const char *data, size_t length) {
+                return send_data(stream, std::string_view(data, length), false);
+            });
+            if (completed) {
+                send_data(stream, "", true);
+            } else {
+                reset_stream(stream->id, ErrorCode::INTERNAL_ERROR);
+            }
+        } else if (!response.body.empty()) {
+            send_data(stream, response.body, true);
+        }
+    }
+
+    bool Session::send_data(const std::shared_ptr<Stream> &stream, std::string_view data, bool end_stream) {
+        do {
+            size_t chunk;
+            {
+                // Wait for credit on both the connection and the stream
+                std::unique_lock<std::mutex> lock(state_mutex);
+                state_changed.wait(lock, [&] {
+                    return closing || stream->reset || data.empty() ||
+                           (connection_send_window > 0 && stream->send_window > 0);
+                });
+                if (closing || stream->reset) {
+                    return false;
+                }
+                int64_t credit = std::min(connection_send_window, stream->send_window);
+                chunk = std::min<size_t>({data.size(), static_cast<size_t>(std::max<int64_t>(credit, 0)),
+                                          peer_settings.max_frame_size});
+                connection_send_window -= static_cast<int64_t>(chunk);
+                stream->send_window -= static_cast<int64_t>(chunk);
+            }
+            bool last = chunk == data.size();
+            if (!write_frame(FrameType::DATA, (last && end_stream) ? flags::END_STREAM : 0, stream->id,
+                             data.substr(0, chunk))) {
+                return false;
+            }
+            data.remove_prefix(chunk);
+        } while (!data.empty());
+        return true;
+    }
+
+    bool Session::write_frame(FrameType type, uint8_t frame_flags, uint32_t stream_id, std::string_view payload) {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        return write_all(serialize_frame(type, frame_flags, stream_id, payload));
+    }
+
+    bool Session::write_all(const std::string &bytes) {
+        size_t sent = 0;
+        while (sent < bytes.size()) {
+            ssize_t n = send(fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                std::cerr << "HTTP/2 write error to " << client_ip << ": " << strerror(errno) << std::endl;
+                std::lock_guard<std::mutex> lock(state_mutex);
+                closing = true;
+                state_changed.notify_all();
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    void Session::reset_stream(uint32_t stream_id, ErrorCode code) {
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            auto it = streams.find(stream_id);
+            if (it != streams.end()) {
+                it->second->reset = true;
+                if (!it->second->dispatched) {
+                    erase_stream(it);
+                }
+                state_changed.notify_all();
+            }
+        }
+        std::string payload;
+        append_u32(payload, static_cast<uint32_t>(code));
+        write_frame(FrameType::RST_STREAM, 0, stream_id, payload);
+    }
+
+    void Session::go_away(ErrorCode code, const std::string &debug) {
+        std::string payload;
+        append_u32(payload, last_stream_id);
+        append_u32(payload, static_cast<uint32_t>(code));
+        payload += debug;
+        write_frame(FrameType::GOAWAY, 0, 0, payload);
+    }
+}
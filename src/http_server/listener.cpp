@@ -0,0 +1,169 @@
+#include <http_server/listener.hpp>
+#include <arpa/inet.h>      // inet_ntop()
+#include <cerrno>           // errno
+#include <cstring>          // strerror()
+#include <iostream>         // std::cerr
+#include <memory>           // std::unique_ptr
+#include <netdb.h>          // getaddrinfo()
+#include <netinet/in.h>     // sockaddr_in6
+#include <netinet/tcp.h>    // TCP_DEFER_ACCEPT, TCP_FASTOPEN
+#include <stdexcept>        // std::runtime_error
+#include <sys/stat.h>       // stat()
+#include <sys/un.h>         // sockaddr_un
+#include <unistd.h>         // close(), unlink()
+
+namespace {
+    // Best effort: warn and carry on if the kernel refuses a tunable
+    void tune(int fd, int level, int name, int value, const char *label) {
+        if(setsockopt(fd, level, name, &value, sizeof(value)) < 0) {
+            std::cerr << "Warning: failed to set " << label << ": " << strerror(errno) << std::endl;
+        }
+    }
+
+    int bind_unix(const std::string &path) {
+        sockaddr_un address{};
+        if(path.empty() || path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("Invalid Unix socket path: " + path);
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        // A socket file left behind by a previous run would make bind() fail
+        struct stat info;
+        if(stat(path.c_str(), &info) == 0) {
+            if(!S_ISSOCK(info.st_mode)) {
+                throw std::runtime_error("Refusing to replace non-socket file: " + path);
+            }
+            unlink(path.c_str());
+        }
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(fd < 0) {
+            throw std::runtime_error("Failed to create socket");
+        }
+        if(bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+            int error = errno;
+            close(fd);
+            throw std::runtime_error("Failed to bind to " + path + ": " + strerror(error));
+        }
+        return fd;
+    }
+
+    int bind_tcp(const std::string &spec, const http_server::ServerOptions &options) {
+        // Split "host:port", "[v6]:port" or "*:port"
+        std::string host;
+        std::string port;
+        if(!spec.empty() && spec[0] == '[') {
+            size_t close_bracket = spec.find(']');
+            if(close_bracket == std::string::npos || spec.compare(close_bracket, 2, "]:") != 0) {
+                throw std::runtime_error("Invalid listen address: " + spec);
+            }
+            host = spec.substr(1, close_bracket - 1);
+            port = spec.substr(close_bracket + 2);
+        } else {
+            size_t colon = spec.rfind(':');
+            if(colon == std::string::npos) {
+                throw std::runtime_error("Invalid listen address: " + spec);
+            }
+            host = spec.substr(0, colon);
+            port = spec.substr(colon + 1);
+        }
+        if(host.empty() || host == "*") {
+            host = "0.0.0.0";
+        }
+
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+        addrinfo *found = nullptr;
+        int status = getaddrinfo(host.c_str(), port.c_str(), &hints, &found);
+        if(status != 0) {
+            throw std::runtime_error("Invalid listen address " + spec + ": " + gai_strerror(status));
+        }
+        std::unique_ptr<addrinfo, decltype(&freeaddrinfo)> addresses(found, &freeaddrinfo);
+
+        int fd = socket(found->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(fd < 0) {
+            throw std::runtime_error("Failed to create socket");
+        }
+        
+        // Set socket options to reuse address and port
+        int opt = 1;
+        if(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0 ||
+           (options.reuse_port && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) ||
+           (found->ai_family == AF_INET6 && setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &opt, sizeof(opt)) < 0)) {
+            close(fd);
+            throw std::runtime_error("Failed to set socket options");
+        }
+        if(options.defer_accept > 0) {
+            tune(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, options.defer_accept, "TCP_DEFER_ACCEPT");
+        }
+        if(options.fastopen > 0) {
+            tune(fd, IPPROTO_TCP, TCP_FASTOPEN, options.fastopen, "TCP_FASTOPEN");
+        }
+
+        if(bind(fd, found->ai_addr, found->ai_addrlen) < 0) {
+            int error = errno;
+            close(fd);
+            throw std::runtime_error("Failed to bind to " + spec + ": " + strerror(error));
+        }
+        return fd;
+    }
+}
+
+http_server::Listener http_server::open_listener(const std::string &spec, const ServerOptions &options) {
+    Listener listener;
+    listener.spec = spec;
+    std::string address = spec;
+    if(address.rfind("tls:", 0) == 0) {
+        listener.tls = true;
+        address.erase(0, 4);
+    }
+    if(address.rfind("unix:", 0) == 0) {
+        listener.unix_path = address.substr(5);
+        listener.fd = bind_unix(listener.unix_path);
+    } else {
+        listener.fd = bind_tcp(address, options);
+    }
+
+    // Buffer sizes set on the listener are inherited by accepted sockets, and must
+    // be in place before listen() to affect the advertised window scale
+    if(options.rcvbuf > 0) {
+        tune(listener.fd, SOL_SOCKET, SO_RCVBUF, options.rcvbuf, "SO_RCVBUF");
+    }
+    if(options.sndbuf > 0) {
+        tune(listener.fd, SOL_SOCKET, SO_SNDBUF, options.sndbuf, "SO_SNDBUF");
+    }
+
+    // Listen for connections
+    if(listen(listener.fd, options.backlog) < 0) {
+        int error = errno;
+        close_listener(listener);
+        throw std::runtime_error("Failed to listen on " + spec + ": " + strerror(error));
+    }
+    return listener;
+}
+
+void http_server::close_listener(Listener &listener) {
+    if(listener.fd >= 0) {
+        close(listener.fd);
+        listener.fd = -1;
+        if(!listener.unix_path.empty()) {
+            unlink(listener.unix_path.c_str());
+        }
+    }
+}
+
+std::string http_server::format_peer(const sockaddr_storage &address, const Listener &listener) {
+    char text[INET6_ADDRSTRLEN] = "unknown";
+    if(address.ss_family == AF_INET) {
+        inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in &>(address).sin_addr, text, sizeof(text));
+    } else if(address.ss_family == AF_INET6) {
+        inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6 &>(address).sin6_addr, text, sizeof(text));
+    } else if(address.ss_family == AF_UNIX) {
+        // Unix peers are unnamed; identify them by the socket they came in on
+        return "unix:" + listener.unix_path;
+    }
+    return text;
+}
@@ -0,0 +1,203 @@
+#include <http_server/options.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+    // Dashes and underscores are interchangeable in option names
+    std::string normalize(std::string name) {
+        std::replace(name.begin(), name.end(), '_', '-');
+        return name;
+    }
+
+    std::string trim(const std::string &text) {
+        size_t begin = text.find_first_not_of(" \t\r");
+        if (begin == std::string::npos) {
+            return "";
+        }
+        size_t end = text.find_last_not_of(" \t\r");
+        return text.substr(begin, end - begin + 1);
+    }
+
+    bool parse_bool(const std::string &name, const std::string &value) {
+        if (value == "1" || value == "true" || value == "on" || value == "yes") {
+            return true;
+        }
+        if (value == "0" || value == "false" || value == "off" || value == "no") {
+            return false;
+        }
+        throw std::invalid_argument("Invalid value for " + name + ": " + value);
+    }
+
+    long long parse_integer(const std::string &name, const std::string &value, long long min, long long max) {
+        size_t used = 0;
+        long long result;
+        try {
+            result = std::stoll(value, &used);
+        } catch (const std::exception &) {
+            used = 0;
+        }
+        if (used == 0 || used != value.size() || result < min || result > max) {
+            throw std::invalid_argument("Invalid value for " + name + ": " + value);
+        }
+        return result;
+    }
+
+    double parse_double(const std::string &name, const std::string &value) {
+        size_t used = 0;
+        double result;
+        try {
+            result = std::stod(value, &used);
+        } catch (const std::exception &) {
+            used = 0;
+        }
+        if (used == 0 || used != value.size() || result < 0) {
+            throw std::invalid_argument("Invalid value for " + name + ": " + value);
+        }
+        return result;
+    }
+
+    // Options that are flags on the command line when given without '=value'
+    bool is_flag(const std::string &name) {
+        return name == "reuse-port" || name == "tcp-nodelay" || name == "cork" || name == "tls-tickets" || name == "ktls"
+            || name == "durable-uploads" || name == "debug-buffers";
+    }
+}
+
+void http_server::set_option(ServerOptions &options, const std::string &raw_name, const std::string &value) {
+    constexpr long long INT_LIMIT = std::numeric_limits<int>::max();
+    std::string name = normalize(raw_name);
+    if (name == "port") {
+        options.port = static_cast<uint16_t>(parse_integer(name, value, 1, 65535));
+    } else if (name == "directory") {
+        options.directory = value;
+    } else if (name == "listen") {
+        options.listen.push_back(value);
+    } else if (name == "backlog") {
+        options.backlog = static_cast<int>(parse_integer(name, value, 1, INT_LIMIT));
+    } else if (name == "reuse-port") {
+        options.reuse_port = parse_bool(name, value);
+    } else if (name == "defer-accept") {
+        options.defer_accept = static_cast<int>(parse_integer(name, value, 0, INT_LIMIT));
+    } else if (name == "fastopen") {
+        options.fastopen = static_cast<int>(parse_integer(name, value, 0, INT_LIMIT));
+    } else if (name == "tls-cert") {
+        options.tls_cert = value;
+    } else if (name == "tls-key") {
+        options.tls_key = value;
+    } else if (name == "tls-session-cache") {
+        options.tls_session_cache = static_cast<size_t>(parse_integer(name, value, 0, INT_LIMIT));
+    } else if (name == "tls-tickets") {
+        options.tls_tickets = parse_bool(name, value);
+    } else if (name == "ktls") {
+        options.ktls = parse_bool(name, value);
+    } else if (name == "upgrade-socket") {
+        options.upgrade_socket = value;
+    } else if (name == "inherit-from") {
+        options.inherit_from = value;
+    } else if (name == "drain-timeout") {
+        options.drain_timeout = static_cast<int>(parse_integer(name, value, 0, INT_LIMIT));
+    } else if (name == "tcp-nodelay") {
+        options.tcp_nodelay = parse_bool(name, value);
+    } else if (name == "cork") {
+        options.cork = parse_bool(name, value);
+    } else if (name == "rcvbuf") {
+        options.rcvbuf = static_cast<int>(parse_integer(name, value, 0, INT_LIMIT));
+    } else if (name == "sndbuf") {
+        options.sndbuf = static_cast<int>(parse_integer(name, value, 0, INT_LIMIT));
+    } else if (name == "keep-alive-requests") {
+        options.keep_alive_requests = static_cast<int>(parse_integer(name, value, 1, INT_LIMIT));
+    } else if (name == "keep-alive-timeout") {
+        options.keep_alive_timeout = static_cast<int>(parse_integer(name, value, 0, INT_LIMIT));
+    } else if (name == "max-header-size") {
+        options.max_header_size = static_cast<size_t>(parse_integer(name, value, 1, std::numeric_limits<long long>::max()));
+    } else if (name == "max-body-size") {
+        options.max_body_size = static_cast<size_t>(parse_integer(name, value, 0, std::numeric_limits<long long>::max()));
+    } else if (name == "cache-size") {
+        options.cache_size = static_cast<size_t>(parse_integer(name, value, 0, std::numeric_limits<long long>::max()));
+    } else if (name == "durable-uploads") {
+        options.durable_uploads = parse_bool(name, value);
+    } else if (name == "debug-buffers") {
+        options.debug_buffers = parse_bool(name, value);
+    } else if (name == "max-connections-per-ip") {
+        options.client_limits.max_connections_per_ip = static_cast<uint32_t>(parse_integer(name, value, 0, UINT32_MAX));
+    } else if (name == "rate-limit") {
+        options.client_limits.requests_per_second = parse_double(name, value);
+    } else if (name == "rate-burst") {
+        options.client_limits.request_burst = static_cast<uint32_t>(parse_integer(name, value, 1, UINT32_MAX));
+    } else if (name == "proxy") {
+        options.proxies.push_back(value);
+    } else if (name == "trace-sample") {
+        options.trace_sample = static_cast<uint32_t>(parse_integer(name, value, 0, UINT32_MAX));
+    } else if (name == "trace-file") {
+        options.trace_file = value;
+    } else {
+        throw std::invalid_argument("Unknown option: " + raw_name);
+    }
+}
+
+void http_server::load_options_file(ServerOptions &options, const std::string &path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Failed to open config file: " + path);
+    }
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+        line = trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            throw std::invalid_argument(path + ":" + std::to_string(line_number) + ": expected 'name = value'");
+        }
+        try {
+            set_option(options, trim(line.substr(0, eq)), trim(line.substr(eq + 1)));
+        } catch (const std::invalid_argument &e) {
+            throw std::invalid_argument(path + ":" + std::to_string(line_number) + ": " + e.what());
+        }
+    }
+}
+
+http_server::ServerOptions http_server::parse_options(int argc, char **argv) {
+    ServerOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-d") {
+            arg = "--directory";
+        }
+        if (arg.rfind("--", 0) != 0) {
+            throw std::invalid_argument("Unexpected argument: " + arg);
+        }
+
+        std::string name = arg.substr(2);
+        std::string value;
+        size_t eq = name.find('=');
+        bool inline_value = (eq != std::string::npos);
+        if (inline_value) {
+            value = name.substr(eq + 1);
+            name.erase(eq);
+        }
+        name = normalize(name);
+        if (!inline_value) {
+            if (is_flag(name)) {
+                value = "true";
+            } else if (i + 1 < argc) {
+                value = argv[++i];
+            } else {
+                throw std::invalid_argument("--" + name + " option requires a value");
+            }
+        }
+
+        if (name == "config") {
+            load_options_file(options, value);
+        } else {
+            set_option(options, name, value);
+        }
+    }
+    return options;
+}
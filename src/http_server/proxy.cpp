@@ -0,0 +1,630 @@
+#include <http_server/proxy.hpp>
+#include <http_server/status.hpp>
+#include <algorithm>        // std::min
+#include <atomic>           // std::atomic
+#include <cerrno>           // errno
+#include <cstdio>           // snprintf()
+#include <cstdlib>          // std::atoi
+#include <cstring>          // std::memcpy
+#include <iostream>         // std::cerr
+#include <memory>           // std::shared_ptr
+#include <mutex>            // std::mutex
+#include <optional>         // std::optional
+#include <stdexcept>        // std::runtime_error, std::invalid_argument
+#include <fcntl.h>          // fcntl()
+#include <netdb.h>          // getaddrinfo()
+#include <netinet/in.h>     // IPPROTO_TCP
+#include <netinet/tcp.h>    // TCP_NODELAY
+#include <poll.h>           // poll()
+#include <sys/socket.h>     // socket(), connect(), send(), recv()
+#include <unistd.h>         // close()
+
+namespace http_server::proxy {
+    namespace {
+        using Clock = std::chrono::steady_clock;
+
+        constexpr size_t READ_CHUNK = 16384;
+        constexpr size_t MAX_RESPONSE_HEAD = 64 * 1024;
+
+        bool is_hop_by_hop(std::string_view name) {
+            return iequals(name, "connection") || iequals(name, "keep-alive") || iequals(name, "transfer-encoding") ||
+                   iequals(name, "upgrade") || iequals(name, "te") || iequals(name, "trailer") ||
+                   iequals(name, "proxy-connection") || iequals(name, "proxy-authorization") ||
+                   iequals(name, "proxy-authenticate") || iequals(name, "http2-settings");
+        }
+
+        // RFC 9110 section 9.2.2
+        bool is_idempotent(const std::string &method) {
+            return method == "GET" || method == "HEAD" || method == "OPTIONS" || method == "TRACE" ||
+                   method == "PUT" || method == "DELETE";
+        }
+
+        bool send_all(int fd, const char *data, size_t length) {
+            while (length > 0) {
+                ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+                if (sent < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return false;
+                }
+                data += sent;
+                length -= static_cast<size_t>(sent);
+            }
+            return true;
+        }
+
+        // One upstream and its idle keep-alive connections
+        struct Backend {
+            Upstream upstream;
+            sockaddr_storage address{};
+            socklen_t address_length = 0;
+
+            std::mutex idle_mutex;
+            std::vector<int> idle;
+
+            std::atomic<int> in_flight{0};
+            std::atomic<int> failures{0};
+            std::atomic<int64_t> ejected_until{0};   // steady clock, milliseconds
+        };
+
+        int64_t now_ms() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+        }
+
+        class UpstreamPool {
+        public:
+            explicit UpstreamPool(const ProxyOptions &options) : options(options) {
+                if (options.upstreams.empty()) {
+                    throw std::invalid_argument("Proxy needs at least one upstream");
+                }
+                for (const Upstream &upstream : options.upstreams) {
+                    auto backend = std::make_unique<Backend>();
+                    backend->upstream = upstream;
+                    addrinfo hints{};
+                    hints.ai_family = AF_UNSPEC;
+                    hints.ai_socktype = SOCK_STREAM;
+                    addrinfo *result = nullptr;
+                    std::string port = std::to_string(upstream.port);
+                    int rc = getaddrinfo(upstream.host.c_str(), port.c_str(), &hints, &result);
+                    if (rc != 0 || result == nullptr) {
+                        throw std::runtime_error("Failed to resolve upstream " + upstream.host + ": " + gai_strerror(rc));
+                    }
+                    std::memcpy(&backend->address, result->ai_addr, result->ai_addrlen);
+                    backend->address_length = result->ai_addrlen;
+                    freeaddrinfo(result);
+                    backends.push_back(std::move(backend));
+                }
+            }
+
+            ~UpstreamPool() {
+                for (auto &backend : backends) {
+                    for (int fd : backend->idle) {
+                        close(fd);
+                    }
+                }
+            }
+
+            // Healthy upstream with the fewest requests in flight; rotating start breaks ties.
+            // 'avoid' is skipped when there is any alternative (it just failed this request).
+            Backend &pick(const Backend *avoid = nullptr) {
+                int64_t now = now_ms();
+                size_t start = next.fetch_add(1, std::memory_order_relaxed);
+                Backend *best = nullptr;
+                Backend *soonest = nullptr;
+                for (size_t i = 0; i < backends.size(); ++i) {
+                    Backend &candidate = *backends[(start + i) % backends.size()];
+                    if (&candidate == avoid && backends.size() > 1) {
+                        continue;
+                    }
+                    if (candidate.ejected_until.load(std::memory_order_relaxed) > now) {
+                        if (!soonest || candidate.ejected_until < soonest->ejected_until) {
+                            soonest = &candidate;
+                        }
+                        continue;
+                    }
+                    if (!best || candidate.in_flight.load(std::memory_order_relaxed) < best->in_flight.load(std::memory_order_relaxed)) {
+                        best = &candidate;
+                    }
+                }
+                // Everything ejected: try the one that comes back first rather than failing outright
+                return best ? *best : soonest ? *soonest : *backends.front();
+            }
+
+            // An idle pooled connection if one is still usable, else a fresh one; -1 on connect failure
+            int acquire(Backend &backend, bool &reused) {
+                {
+                    std::lock_guard<std::mutex> lock(backend.idle_mutex);
+                    while (!backend.idle.empty()) {
+                        int fd = backend.idle.back();
+                        backend.idle.pop_back();
+                        // Readable while idle means the upstream closed it (or sent junk)
+                        pollfd probe{fd, POLLIN, 0};
+                        if (poll(&probe, 1, 0) == 0) {
+                            reused = true;
+                            return fd;
+                        }
+                        close(fd);
+                    }
+                }
+                reused = false;
+                return connect_to(backend);
+            }
+
+            void release(Backend &backend, int fd, bool reusable) {
+                if (reusable) {
+                    std::lock_guard<std::mutex> lock(backend.idle_mutex);
+                    if (backend.idle.size() < options.max_idle_connections) {
+                        backend.idle.push_back(fd);
+                        return;
+                    }
+                }
+                close(fd);
+            }
+
+            void report(Backend &backend, bool ok) {
+                if (ok) {
+                    backend.failures.store(0, std::memory_order_relaxed);
+                    return;
+                }
+                if (backend.failures.fetch_add(1, std::memory_order_relaxed) + 1 >= options.max_failures) {
+                    backend.ejected_until.store(now_ms() + options.eject_duration.count(), std::memory_order_relaxed);
+                    std::cerr << "Proxy: ejecting upstream " << backend.upstream.host << ":" << backend.upstream.port
+                              << " for " << options.eject_duration.count() << "ms" << std::endl;
+                }
+            }
+
+            const ProxyOptions options;
+
+        private:
+            std::vector<std::unique_ptr<Backend>> backends;
+            std::atomic<size_t> next{0};
+
+            int connect_to(Backend &backend) {
+                int fd = socket(backend.address.ss_family, SOCK_STREAM, 0);
+                if (fd < 0) {
+                    return -1;
+                }
+                int flags = fcntl(fd, F_GETFL);
+                fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+                int rc = connect(fd, reinterpret_cast<const sockaddr *>(&backend.address), backend.address_length);
+                if (rc < 0 && errno == EINPROGRESS) {
+                    pollfd pending{fd, POLLOUT, 0};
+                    rc = poll(&pending, 1, static_cast<int>(options.connect_timeout.count()));
+                    int error = 0;
+                    socklen_t length = sizeof(error);
+                    if (rc == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0) {
+                        rc = 0;
+                    } else {
+                        rc = -1;
+                    }
+                }
+                if (rc < 0) {
+                    close(fd);
+                    return -1;
+                }
+                fcntl(fd, F_SETFL, flags);
+
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                timeval timeout{};
+                timeout.tv_sec = options.io_timeout.count() / 1000;
+                timeout.tv_usec = (options.io_timeout.count() % 1000) * 1000;
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                return fd;
+            }
+        };
+
+        // One request/response exchange on an upstream connection. Owned by the
+        // response body stream so the connection is pooled once the body is drained.
+        class Exchange {
+        public:
+            enum class Framing { NONE, LENGTH, CHUNKED, UNTIL_CLOSE };
+
+            Exchange(std::shared_ptr<UpstreamPool> pool, Backend &backend, int fd)
+                : pool(std::move(pool)), backend(backend), fd(fd) {
+                backend.in_flight.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            ~Exchange() {
+                if (fd >= 0) {
+                    pool->release(backend, fd, complete && reusable && buffer.size() == offset);
+                }
+                backend.in_flight.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            Exchange(const Exchange &) = delete;
+            Exchange &operator=(const Exchange &) = delete;
+
+            std::shared_ptr<UpstreamPool> pool;
+            Backend &backend;
+            int fd;
+            std::string buffer;
+            size_t offset = 0;
+            Framing framing = Framing::NONE;
+            size_t remaining = 0;
+            bool complete = false;
+            bool reusable = true;
+            bool timed_out = false;
+
+            // Read more bytes into the buffer; false on EOF, error or timeout
+            bool fill() {
+                if (offset > 0 && offset == buffer.size()) {
+                    buffer.clear();
+                    offset = 0;
+                }
+                char chunk[READ_CHUNK];
+                while (true) {
+                    ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+                    if (got > 0) {
+                        buffer.append(chunk, static_cast<size_t>(got));
+                        return true;
+                    }
+                    if (got < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    timed_out = got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+                    return false;
+                }
+            }
+
+            // Read a CRLF-terminated line, consuming it
+            bool read_line(std::string &line) {
+                while (true) {
+                    size_t eol = buffer.find("\r\n", offset);
+                    if (eol != std::string::npos) {
+                        line = buffer.substr(offset, eol - offset);
+                        offset = eol + 2;
+                        return true;
+                    }
+                    if (buffer.size() - offset > MAX_RESPONSE_HEAD || !fill()) {
+                        return false;
+                    }
+                }
+            }
+
+            // Pass body bytes to the sink as they arrive from upstream
+            bool stream_body(const BodySink &sink) {
+                switch (framing) {
+                    case Framing::NONE:
+                        complete = true;
+                        return true;
+                    case Framing::LENGTH:
+                        while (remaining > 0) {
+                            if (offset == buffer.size() && !fill()) {
+                                return false;
+                            }
+                            size_t take = std::min(remaining, buffer.size() - offset);
+                            if (!sink(buffer.data() + offset, take)) {
+                                return false;
+                            }
+                            offset += take;
+                            remaining -= take;
+                        }
+                        complete = true;
+                        return true;
+                    case Framing::UNTIL_CLOSE:
+                        reusable = false;
+                        while (true) {
+                            if (offset < buffer.size()) {
+                                if (!sink(buffer.data() + offset, buffer.size() - offset)) {
+                                    return false;
+                                }
+                                offset = buffer.size();
+                            }
+                            if (!fill()) {
+                                complete = !timed_out;
+                                return complete;
+                            }
+                        }
+                    case Framing::CHUNKED:
+                        return stream_chunked(sink);
+                }
+                return false;
+            }
+
+        private:
+            bool stream_chunked(const BodySink &sink) {
+                std::string line;
+                while (true) {
+                    if (!read_line(line)) {
+                        return false;
+                    }
+                    size_t chunk_size;
+                    try {
+                        chunk_size = std::stoul(line, nullptr, 16);
+                    } catch (const std::exception &) {
+                        return false;
+                    }
+                    if (chunk_size == 0) {
+                        // Skip trailers up to the terminating empty line
+                        do {
+                            if (!read_line(line)) {
+                                return false;
+                            }
+                        } while (!line.empty());
+                        complete = true;
+                        return true;
+                    }
+                    remaining = chunk_size;
+                    while (remaining > 0) {
+                        if (offset == buffer.size() && !fill()) {
+                            return false;
+                        }
+                        size_t take = std::min(remaining, buffer.size() - offset);
+                        if (!sink(buffer.data() + offset, take)) {
+                            return false;
+                        }
+                        offset += take;
+                        remaining -= take;
+                    }
+                    if (!read_line(line) || !line.empty()) {
+                        return false;
+                    }
+                }
+            }
+        };
+
+        HTTP_Response error_response(HTTP_STATUS_CODE code, const std::string &message, const std::string &body) {
+            return HTTP_Response {
+                (int)code,
+                message,
+                {{"Content-Type", "text/plain"}},
+                body
+            };
+        }
+
+        std::string build_request_head(const HTTP_Request &request, const std::string &path) {
+            std::string head = request.method + " " + path + " HTTP/1.1\r\n";
+            std::string forwarded_for = request.remote_address;
+            request.headers.for_each([&](std::string_view name, const std::string &value) {
+                // The client's Expect was answered here, and the body is sent right behind the head
+                if (is_hop_by_hop(name) || iequals(name, "content-length") || iequals(name, "expect")) {
+                    return;
+                }
+                if (iequals(name, "x-forwarded-for")) {
+                    forwarded_for = request.remote_address.empty() ? value : value + ", " + request.remote_address;
+                    return;
+                }
+                head.append(name).append(": ").append(value).append("\r\n");
+            });
+            if (!forwarded_for.empty()) {
+                head += "X-Forwarded-For: " + forwarded_for + "\r\n";
+            }
+            if (request.body_stream && is_chunked(request)) {
+                head += "Transfer-Encoding: chunked\r\n";
+            } else if (request.body_stream) {
+                // Relayed as it arrives, under the client's own length
+                head += "Content-Length: " + std::to_string(content_length(request).value_or(0)) + "\r\n";
+            } else if (!request.body.empty() || request.headers.contains(HTTP_HEADER::CONTENT_LENGTH)) {
+                head += "Content-Length: " + std::to_string(request.body.size()) + "\r\n";
+            }
+            head += "Connection: keep-alive\r\n\r\n";
+            return head;
+        }
+
+        enum class BodyResult { SENT, CLIENT_FAILED, UPSTREAM_FAILED };
+
+        // Relay a streamed request body upstream as it is read from the client: a chunked one
+        // re-chunked piece by piece and followed by the client's trailers, a Content-Length
+        // one as is
+        BodyResult send_streamed_body(int fd, const HTTP_Request &request) {
+            bool chunked = is_chunked(request);
+            bool upstream_alive = true;
+            bool completed = request.body_stream([&](const char *data, size_t length) {
+                if (length == 0) {
+                    return upstream_alive;
+                }
+                if (!chunked) {
+                    upstream_alive = send_all(fd, data, length);
+                    return upstream_alive;
+                }
+                char size_line[20];
+                int size_length = snprintf(size_line, sizeof(size_line), "%zx\r\n", length);
+                upstream_alive = send_all(fd, size_line, size_length) && send_all(fd, data, length) && send_all(fd, "\r\n", 2);
+                return upstream_alive;
+            });
+            if (!upstream_alive) {
+                return BodyResult::UPSTREAM_FAILED;
+            }
+            if (!completed) {
+                return BodyResult::CLIENT_FAILED;
+            }
+            if (!chunked) {
+                return BodyResult::SENT;
+            }
+            std::string last_chunk = "0\r\n";
+            request.trailers.for_each([&](std::string_view name, const std::string &value) {
+                if (!is_hop_by_hop(name) && !iequals(name, "content-length")) {
+                    last_chunk.append(name).append(": ").append(value).append("\r\n");
+                }
+            });
+            last_chunk += "\r\n";
+            return send_all(fd, last_chunk.data(), last_chunk.size()) ? BodyResult::SENT : BodyResult::UPSTREAM_FAILED;
+        }
+
+        // One status line and header block into 'response', replacing what a previous one set
+        bool read_status_and_headers(Exchange &exchange, HTTP_Response &response, bool &http10, bool &chunked,
+                                     std::optional<size_t> &content_length) {
+            std::string line;
+            if (!exchange.read_line(line) || line.compare(0, 5, "HTTP/") != 0) {
+                return false;
+            }
+            size_t code_start = line.find(' ');
+            if (code_start == std::string::npos) {
+                return false;
+            }
+            response.status_code = std::atoi(line.c_str() + code_start + 1);
+            size_t message_start = line.find(' ', code_start + 1);
+            response.status_message = message_start == std::string::npos ? "" : line.substr(message_start + 1);
+            response.headers = Headers();
+            http10 = line.compare(0, 8, "HTTP/1.0") == 0;
+            exchange.reusable = !http10;
+            chunked = false;
+            content_length.reset();
+
+            while (true) {
+                if (!exchange.read_line(line)) {
+                    return false;
+                }
+                if (line.empty()) {
+                    return true;
+                }
+                size_t colon = line.find(':');
+                if (colon == std::string::npos) {
+                    continue;
+                }
+                std::string name = line.substr(0, colon);
+                size_t value_start = line.find_first_not_of(" \t", colon + 1);
+                std::string value = value_start == std::string::npos ? "" : line.substr(value_start);
+                if (iequals(name, "connection")) {
+                    exchange.reusable = http10 ? iequals(value, "keep-alive") : !iequals(value, "close");
+                    continue;
+                }
+                if (iequals(name, "transfer-encoding")) {
+                    chunked = value.find("chunked") != std::string::npos;
+                    continue;
+                }
+                if (iequals(name, "content-length")) {
+                    content_length = std::stoul(value);
+                }
+                if (!is_hop_by_hop(name)) {
+                    response.headers.set(name, std::move(value));
+                }
+            }
+        }
+
+        // Parse the final response head into 'response' and decide how the body is framed.
+        // Interim 1xx responses (100 Continue for a forwarded Expect, 103 Early Hints) are
+        // skipped; the client only sees the final one.
+        bool read_response_head(Exchange &exchange, const HTTP_Request &request, HTTP_Response &response) {
+            bool http10 = false;
+            bool chunked = false;
+            std::optional<size_t> content_length;
+            do {
+                if (!read_status_and_headers(exchange, response, http10, chunked, content_length)) {
+                    return false;
+                }
+            } while (response.status_code >= 100 && response.status_code < 200 && response.status_code != 101);
+
+            // RFC 9112 section 6.3: these never carry a body
+            bool bodiless = request.method == "HEAD" || response.status_code == 204 || response.status_code == 304 ||
+                            response.status_code == 101;
+            if (bodiless) {
+                exchange.framing = Exchange::Framing::NONE;
+            } else if (chunked) {
+                response.headers.erase(HTTP_HEADER::CONTENT_LENGTH);
+                exchange.framing = Exchange::Framing::CHUNKED;
+            } else if (content_length) {
+                exchange.framing = *content_length ? Exchange::Framing::LENGTH : Exchange::Framing::NONE;
+                exchange.remaining = *content_length;
+            } else {
+                exchange.framing = Exchange::Framing::UNTIL_CLOSE;
+            }
+            return true;
+        }
+    }
+
+    std::vector<Upstream> parse_upstreams(const std::string &spec) {
+        std::vector<Upstream> upstreams;
+        size_t start = 0;
+        while (start <= spec.size()) {
+            size_t end = spec.find(',', start);
+            std::string item = spec.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            size_t colon = item.rfind(':');
+            if (colon == std::string::npos || colon == 0 || colon + 1 == item.size()) {
+                throw std::invalid_argument("Upstream must be host:port, got '" + item + "'");
+            }
+            std::string host = item.substr(0, colon);
+            if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+                host = host.substr(1, host.size() - 2);
+            }
+            unsigned long port = std::stoul(item.substr(colon + 1));
+            if (port == 0 || port > 65535) {
+                throw std::invalid_argument("Upstream port out of range in '" + item + "'");
+            }
+            upstreams.push_back({host, static_cast<uint16_t>(port)});
+            if (end == std::string::npos) {
+                break;
+            }
+            start = end + 1;
+        }
+        return upstreams;
+    }
+
+    Handler make_proxy_handler(ProxyOptions options) {
+        auto pool = std::make_shared<UpstreamPool>(options);
+
+        return [pool](const HTTP_Request &request, const Params &params) -> HTTP_Response {
+            std::string path = request.path;
+            if (!pool->options.path_param.empty()) {
+                auto it = params.find(pool->options.path_param);
+                path = "/" + (it == params.end() ? std::string() : it->second);
+            }
+            std::string head = build_request_head(request, path);
+
+            // A second attempt only covers a failed connect, and a pooled connection the upstream
+            // closed while idle. Even then a non-idempotent request is not written twice.
+            const Backend *failed = nullptr;
+            bool body_consumed = false;
+            bool replayable = is_idempotent(request.method);
+            for (int attempt = 0; attempt < 2; ++attempt) {
+                Backend &backend = pool->pick(failed);
+                failed = &backend;
+                bool reused = false;
+                int fd = pool->acquire(backend, reused);
+                if (fd < 0) {
+                    pool->report(backend, false);
+                    continue;
+                }
+                auto exchange = std::make_shared<Exchange>(pool, backend, fd);
+
+                bool sent = send_all(fd, head.data(), head.size());
+                if (sent && request.body_stream) {
+                    // The body can only be read from the client once, so there is no second attempt
+                    body_consumed = true;
+                    BodyResult result = send_streamed_body(fd, request);
+                    if (result == BodyResult::CLIENT_FAILED) {
+                        exchange->reusable = false;
+                        return error_response(HTTP_STATUS_CODE::BAD_REQUEST, "Bad Request", "Incomplete or malformed request body");
+                    }
+                    sent = (result == BodyResult::SENT);
+                } else if (sent) {
+                    sent = send_all(fd, request.body.data(), request.body.size());
+                }
+                HTTP_Response response{0, "", {}, ""};
+                bool parsed = false;
+                try {
+                    parsed = sent && read_response_head(*exchange, request, response);
+                } catch (const std::exception &e) {
+                    std::cerr << "Proxy: malformed upstream response: " << e.what() << std::endl;
+                }
+                if (parsed) {
+                    pool->report(backend, true);
+                    if (exchange->framing == Exchange::Framing::NONE) {
+                        exchange->complete = true;
+                        return response;
+                    }
+                    response.body_stream = [exchange](const BodySink &sink) {
+                        return exchange->stream_body(sink);
+                    };
+                    return response;
+                }
+
+                exchange->reusable = false;
+                bool stale = reused && exchange->buffer.empty() && !exchange->timed_out;
+                if (!stale) {
+                    pool->report(backend, false);
+                    if (exchange->timed_out) {
+                        return error_response(HTTP_STATUS_CODE::GATEWAY_TIMEOUT, "Gateway Timeout", "Upstream timed out");
+                    }
+                }
+                if (!stale || !replayable || body_consumed) {
+                    break;
+                }
+            }
+            return error_response(HTTP_STATUS_CODE::BAD_GATEWAY, "Bad Gateway", "No upstream available");
+        };
+    }
+}
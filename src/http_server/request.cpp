@@ -69,48 +69,89 @@ http_server::HTTP_Request http_server::parse_request(const std::string &raw) {
 
             std::string name = lines[i].substr(0, sep);
             std::string value = lines[i].substr(sep + 2);
-            request.headers[name] = value;
+            // A repeated framing header must not let its last copy decide where the body ends
+            if(const std::string *existing = request.headers.get(name)) {
+                if(iequals(name, "Content-Length") && *existing != value) {
+                    throw std::runtime_error("Conflicting Content-Length values");
+                }
+                if(iequals(name, "Transfer-Encoding")) {
+                    value = *existing + ", " + value;   // refused below, as any list of codings is
+                }
+            }
+            request.headers.set(name, std::move(value));
         }
 
-        // Process Accept-Encoding header for gzip support
-        if (request.headers.find("Accept-Encoding") != request.headers.end()) {
-            request.encoding_scheme = "";
-            // Clean the header by removing spaces
-            std::string& encoding_header = request.headers["Accept-Encoding"];
-            encoding_header.erase(
-                std::remove(encoding_header.begin(), encoding_header.end(), ' '),
-                encoding_header.end()
-            );
+        negotiate_encoding(request);
 
-            std::istringstream encodings(encoding_header);
-            std::string encoding;
-            while(std::getline(encodings, encoding, ',')) {
-                if(encoding == "gzip") {
-                    request.encoding_scheme = encoding;
-                    break;
-                }
+        // Only plain chunked bodies are decoded, and a message framed both ways is a
+        // smuggling attempt (RFC 9112 section 6.3)
+        if(const std::string *transfer_encoding = request.headers.get(HTTP_HEADER::TRANSFER_ENCODING)) {
+            if(!is_chunked(request) || transfer_encoding->find(',') != std::string::npos) {
+                throw std::runtime_error("Unsupported Transfer-Encoding: " + *transfer_encoding);
             }
-        } else {
-            request.encoding_scheme = "";
-        }
-        
-        // Process Content-Length if present
-        auto content_length_it = request.headers.find("Content-Length");
-        if(content_length_it != request.headers.end()) {
-            try {
-                size_t content_length = std::stoul(content_length_it->second);
-                if (content_length > request.body.size()) {
-                    std::cerr << "Warning: Content-Length (" << content_length << ") exceeds actual body size (" 
-                              << request.body.size() << ")" << std::endl;
-                }
-            } catch (const std::exception& e) {
-                std::cerr << "Invalid Content-Length header: " << e.what() << std::endl;
+            if(request.headers.contains(HTTP_HEADER::CONTENT_LENGTH)) {
+                throw std::runtime_error("Both Transfer-Encoding and Content-Length present");
             }
         }
         
+        // A malformed length would leave the body's end, and the next request's start, ambiguous
+        content_length(request);
+        
         return request;
     } catch (const std::exception& e) {
         std::cerr << "Error parsing HTTP request: " << e.what() << std::endl;
         throw; // Rethrow to be handled by caller
     }
+}
+
+std::optional<size_t> http_server::content_length(const HTTP_Request &request) {
+    const std::string *value = request.headers.get(HTTP_HEADER::CONTENT_LENGTH);
+    if(value == nullptr) {
+        return std::nullopt;
+    }
+    // std::stoul would accept signs, spaces and trailing junk
+    if(value->empty() || value->size() > 19 || value->find_first_not_of("0123456789") != std::string::npos) {
+        throw std::runtime_error("Invalid Content-Length: " + *value);
+    }
+    return static_cast<size_t>(std::stoull(*value));
+}
+
+bool http_server::is_chunked(const HTTP_Request &request) {
+    const std::string *transfer_encoding = request.headers.get(HTTP_HEADER::TRANSFER_ENCODING);
+    if(transfer_encoding == nullptr) {
+        return false;
+    }
+    // Only the last coding in the list frames the message
+    std::string_view codings = *transfer_encoding;
+    size_t comma = codings.rfind(',');
+    std::string_view last = (comma == std::string_view::npos) ? codings : codings.substr(comma + 1);
+    while(!last.empty() && (last.front() == ' ' || last.front() == '\t')) {
+        last.remove_prefix(1);
+    }
+    while(!last.empty() && (last.back() == ' ' || last.back() == '\t')) {
+        last.remove_suffix(1);
+    }
+    return iequals(last, "chunked");
+}
+
+void http_server::negotiate_encoding(HTTP_Request &request) {
+    // Process Accept-Encoding header for gzip support
+    request.encoding_scheme = "";
+    if (request.headers.contains(HTTP_HEADER::ACCEPT_ENCODING)) {
+        // Clean the header by removing spaces
+        std::string& encoding_header = request.headers[HTTP_HEADER::ACCEPT_ENCODING];
+        encoding_header.erase(
+            std::remove(encoding_header.begin(), encoding_header.end(), ' '),
+            encoding_header.end()
+        );
+
+        std::istringstream encodings(encoding_header);
+        std::string encoding;
+        while(std::getline(encodings, encoding, ',')) {
+            if(encoding == "gzip") {
+                request.encoding_scheme = encoding;
+                break;
+            }
+        }
+    }
 }
\ No newline at end of file
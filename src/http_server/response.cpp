@@ -11,15 +11,16 @@ std::string http_server::HTTP_Response::to_string() const {
         // Status line
         ss << "HTTP/1.1 " << status_code << " " << status_message << "\r\n";
         
-        // Set Content-Length header if not already set
-        std::map<std::string, std::string> all_headers = headers;
-        if(all_headers.find("Content-Length") == all_headers.end() && !body.empty()) {
-            all_headers["Content-Length"] = std::to_string(body.size());
-        }
-        
         // Headers
-        for(const auto &[name, value] : all_headers) {
+        headers.for_each([&](std::string_view name, const std::string &value) {
             ss << name << ": " << value << "\r\n";
+        });
+
+        // Set Content-Length header if not already set; an empty body still needs it so
+        // keep-alive clients know the response is over. A taken over connection ends by closing.
+        bool bodiless_status = (status_code >= 100 && status_code < 200) || status_code == 204 || status_code == 304;
+        if(!headers.contains(HTTP_HEADER::CONTENT_LENGTH) && !body_stream && !takeover && !bodiless_status) {
+            ss << header_name(HTTP_HEADER::CONTENT_LENGTH) << ": " << body.size() << "\r\n";
         }
         
         // Empty line separator
@@ -1,16 +1,41 @@
 #include <http_server/router.hpp>
+#include <http_server/async/event_loop.hpp>
+#include <http_server/trace.hpp>
 #include <iostream>
 
-void http_server::Router::add_route(const std::string &method, const std::string &path_pattern, Handler handler) {
+namespace {
+    http_server::async::Task<http_server::HTTP_Response> call_async(http_server::AsyncHandler handler,
+                                                                    http_server::HTTP_Request request,
+                                                                    http_server::Params params) {
+        co_return co_await handler(request, params);
+    }
+}
+
+void http_server::Router::add_route(const std::string &method, const std::string &path_pattern, Handler handler,
+                                   std::optional<CachePolicy> cache_policy) {
     try {
         auto [compiled_method, compiled_path] = compile_path_pattern(path_pattern);
-        routes.push_back({method, path_pattern, std::move(compiled_method), std::move(compiled_path), std::move(handler)});
+        routes.push_back({method, path_pattern, std::move(compiled_method), std::move(compiled_path), std::move(handler), std::move(cache_policy)});
     } catch (const std::exception& e) {
         std::cerr << "Error adding route: " << e.what() << std::endl;
     }
 }
 
+void http_server::Router::add_route(const std::string &method, const std::string &path_pattern, AsyncHandler handler,
+                                   std::optional<CachePolicy> cache_policy) {
+    // The connection resumes the response on the event loop rather than blocking on it; the
+    // coroutine outlives this call, so it gets its own copies of the request and parameters
+    add_route(method, path_pattern, [handler = std::move(handler)](const HTTP_Request &request, const Params &params) {
+        HTTP_Response response{(int)HTTP_STATUS_CODE::OK, "OK", {}, ""};
+        response.deferred = [handler, request, params]() {
+            return call_async(handler, request, params);
+        };
+        return response;
+    }, std::move(cache_policy));
+}
+
 http_server::HTTP_Response http_server::Router::dispatch(const HTTP_Request &request) const {
+    trace::Span span("dispatch");
     try {
         for (const auto &route : routes) {
             if(route.method != request.method) {
@@ -22,7 +47,21 @@ http_server::HTTP_Response http_server::Router::dispatch(const HTTP_Request &req
                 for (size_t i = 0; i < route.path_params.size(); ++i) {
                     params[route.path_params[i]] = match[i + 1].str();
                 }
-                return route.handler(request, params);
+                auto run_handler = [&] {
+                    trace::Span handler_span("handler");
+                    return route.handler(request, params);
+                };
+                if (cache && route.cache_policy) {
+                    // The cache keeps finished responses: a miss on an async route waits for it here
+                    return cache->get_or_compute(cache_key(request, *route.cache_policy), route.cache_policy->ttl, [&] {
+                        HTTP_Response response = run_handler();
+                        if (response.deferred) {
+                            response = async::sync_wait(response.deferred());
+                        }
+                        return response;
+                    });
+                }
+                return run_handler();
             }
         }
     } catch (const std::exception& e) {
@@ -36,6 +75,22 @@ http_server::HTTP_Response http_server::Router::dispatch(const HTTP_Request &req
     };
 }
 
+void http_server::Router::enable_cache(size_t max_bytes) {
+    cache = std::make_shared<ResponseCache>(max_bytes);
+}
+
+std::string http_server::Router::cache_key(const HTTP_Request &request, const CachePolicy &policy) {
+    // Fields are separated by '\n', which cannot appear inside any of them
+    std::string key = request.method + '\n' + request.path + '\n' + request.encoding_scheme;
+    for (const auto &name : policy.vary) {
+        key += '\n';
+        if (const std::string *value = request.headers.get(name)) {
+            key += *value;
+        }
+    }
+    return key;
+}
+
 std::pair<std::regex, std::vector<std::string>> http_server::Router::compile_path_pattern(const std::string &path_pattern) {
     std::string regex_str = "^";
     std::vector<std::string> names;
@@ -48,6 +103,11 @@ std::pair<std::regex, std::vector<std::string>> http_server::Router::compile_pat
             names.push_back(path_pattern.substr(i+1, j-(i+1)));
             regex_str += "([^/]+)";
             i = j;
+        } else if (path_pattern[i] == '*' && (i+1)<path_pattern.size()) {
+            // wildcard: the rest of the path, slashes included
+            names.push_back(path_pattern.substr(i+1));
+            regex_str += "(.*)";
+            i = path_pattern.size();
         } else {
             // escape regex chars
             if (std::string(".^$|()[]*+?{}\\").find(path_pattern[i]) != std::string::npos)
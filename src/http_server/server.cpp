@@ -1,141 +1,700 @@
 #include <http_server/server.hpp>
 #include <http_server/request.hpp>
 #include <http_server/response.hpp>
+#include <http_server/chunked.hpp>
+#include <http_server/trace.hpp>
+#include <http_server/http2/session.hpp>
+#include <http_server/handoff.hpp>
+#include <http_server/async/event_loop.hpp>
+#include <utils/buffer_pool.hpp>
 #include <sys/socket.h>
 #include <netinet/in.h>
-#include <thread>
+#include <netinet/tcp.h>    // TCP_NODELAY, TCP_DEFER_ACCEPT, TCP_FASTOPEN
 #include <fstream>
 #include <cstring>
+#include <cstdio>           // snprintf()
 #include <sstream>          // std::istringstream
-#include <thread>           // std::thread<
+#include <thread>           // std::thread
 #include <unistd.h>         // close()
 #include <filesystem>       // std::filesystem
 #include <arpa/inet.h>      // sockaddr_in, htons(), INADDR_ANY
+#include <poll.h>           // poll()
+#include <sys/eventfd.h>    // eventfd()
+#include <csignal>          // SIGUSR1
+#include <chrono>           // std::chrono::steady_clock
+#include <algorithm>        // std::min
+#include <utility>          // std::exchange
 
-http_server::HTTP_Server::HTTP_Server(uint16_t port, std::string root_path) {
+namespace {
+    // Upgrade: h2c (RFC 7540 section 3.2); requests carrying a body stay on HTTP/1.1
+    bool is_h2c_upgrade(const http_server::HTTP_Request &request) {
+        const std::string *upgrade = request.headers.get(http_server::HTTP_HEADER::UPGRADE);
+        if(request.version != "HTTP/1.1" || upgrade == nullptr || http_server::content_length(request).value_or(0) > 0 ||
+           http_server::is_chunked(request) ||
+           !request.headers.contains(http_server::HTTP_HEADER::HTTP2_SETTINGS)) {
+            return false;
+        }
+        std::istringstream protocols(*upgrade);
+        std::string protocol;
+        while(std::getline(protocols, protocol, ',')) {
+            protocol.erase(0, protocol.find_first_not_of(' '));
+            if(protocol == "h2c") {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 'flags' may add MSG_MORE when more of the response follows right away
+    bool send_all(int fd, const char *data, size_t length, int flags = 0) {
+        while(length > 0) {
+            ssize_t sent = send(fd, data, length, MSG_NOSIGNAL | flags);
+            if(sent < 0) {
+                if(errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            data += sent;
+            length -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    // Wait for 'fd' to become readable, then recv into a pooled buffer borrowed just for
+    // the call and append to 'out'. Returns recv's result; -1 with EAGAIN on timeout, or
+    // when 'wake_fd' turns readable first.
+    ssize_t read_available(int fd, std::string &out, int timeout_ms, int wake_fd = -1) {
+        pollfd waiting[2] = {{fd, POLLIN, 0}, {wake_fd, POLLIN, 0}};
+        int ready;
+        do {
+            ready = poll(waiting, 2, timeout_ms);
+        } while(ready < 0 && errno == EINTR);
+        if(ready < 0) {
+            return -1;
+        }
+        if(ready == 0 || waiting[0].revents == 0) {
+            errno = EAGAIN;
+            return -1;
+        }
+        http_server::buffer_pool::Buffer buffer = http_server::buffer_pool::acquire(http_server::config::READ_BUFFER_SIZE);
+        ssize_t bytes_read;
+        do {
+            bytes_read = recv(fd, buffer.data(), buffer.size(), 0);
+        } while(bytes_read < 0 && errno == EINTR);
+        if(bytes_read > 0) {
+            out.append(buffer.data(), static_cast<size_t>(bytes_read));
+        }
+        return bytes_read;
+    }
+
+    // Decode the chunked body that follows a request head into 'sink', reading more from
+    // the socket as the decoder asks for it. Bytes past the body stay in 'pending'.
+    bool read_chunked_body(int fd, std::string &pending, http_server::ChunkedDecoder &decoder,
+                           int timeout_ms, const http_server::BodySink &sink) {
+        try {
+            while(!decoder.done()) {
+                if(decoder.aborted()) {
+                    return false;
+                }
+                if(pending.empty() && read_available(fd, pending, timeout_ms) <= 0) {
+                    return false;
+                }
+                pending.erase(0, decoder.decode(pending, sink));
+            }
+            return true;
+        } catch (const http_server::ChunkedError &e) {
+            std::cerr << "Rejecting chunked body: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    // Pass the next 'remaining' bytes of a Content-Length body to 'sink', from 'pending' and then
+    // the socket. Bytes past the body stay in 'pending'.
+    bool read_length_body(int fd, std::string &pending, size_t &remaining, int timeout_ms,
+                          const http_server::BodySink &sink) {
+        while(remaining > 0) {
+            if(pending.empty() && read_available(fd, pending, timeout_ms) <= 0) {
+                return false;
+            }
+            size_t take = std::min(remaining, pending.size());
+            if(!sink(pending.data(), take)) {
+                return false;
+            }
+            pending.erase(0, take);
+            remaining -= take;
+        }
+        return true;
+    }
+
+    // 'Expect: 100-continue' on an HTTP/1.1 request; HTTP/1.0 clients' expectations are ignored
+    bool expects_continue(const http_server::HTTP_Request &request) {
+        const std::string *expect = request.headers.get(http_server::HTTP_HEADER::EXPECT);
+        return expect != nullptr && request.version == "HTTP/1.1" && http_server::iequals(*expect, "100-continue");
+    }
+
+    constexpr char CONTINUE_RESPONSE[] = "HTTP/1.1 100 Continue\r\n\r\n";
+
+    // Closing with unread bytes in the receive buffer resets the connection, and the client may
+    // lose the response it has not read yet. Stop sending and discard what arrives for a while.
+    void linger_close(int fd) {
+        shutdown(fd, SHUT_WR);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(http_server::config::LINGER_TIMEOUT_MS);
+        size_t discarded = 0;
+        std::string sink;
+        while(discarded < http_server::config::LINGER_MAX_BYTES) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if(left.count() <= 0 || read_available(fd, sink, static_cast<int>(left.count())) <= 0) {
+                break;
+            }
+            discarded += sink.size();
+            sink.clear();
+        }
+    }
+
+    // The listener 'inherited' has for 'spec', taken out of it
+    std::optional<http_server::Listener> take_listener(std::vector<http_server::Listener> &inherited, const std::string &spec) {
+        for(auto it = inherited.begin(); it != inherited.end(); ++it) {
+            if(it->spec == spec) {
+                http_server::Listener listener = std::move(*it);
+                inherited.erase(it);
+                return listener;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Run a streamed body into the socket, adding chunk framing when requested
+    bool send_body_stream(int fd, const http_server::BodyStream &body_stream, bool chunked, bool cork) {
+        int more = cork ? MSG_MORE : 0;
+        bool client_alive = true;
+        bool completed = body_stream([&](const char *data, size_t length) {
+            if(length == 0) {
+                return client_alive;
+            }
+            if(chunked) {
+                char size_line[20];
+                int size_length = snprintf(size_line, sizeof(size_line), "%zx\r\n", length);
+                client_alive = send_all(fd, size_line, size_length, more) && send_all(fd, data, length, more) && send_all(fd, "\r\n", 2, more);
+            } else {
+                client_alive = send_all(fd, data, length);
+            }
+            return client_alive;
+        });
+        if(!completed || !client_alive) {
+            return false;
+        }
+        return !chunked || send_all(fd, "0\r\n\r\n", 5);
+    }
+}
+
+http_server::HTTP_Server::HTTP_Server(uint16_t port, std::string root_path)
+    : HTTP_Server([&] {
+        ServerOptions defaults;
+        defaults.port = port;
+        defaults.directory = std::move(root_path);
+        return defaults;
+    }()) {}
+
+http_server::HTTP_Server::HTTP_Server(const ServerOptions &server_options) : options(server_options) {
     try {
-        // Create socket
-        server_fd = socket(AF_INET, SOCK_STREAM, 0);
-        if(server_fd < 0) {
-            throw std::runtime_error("Failed to create socket");
+        std::vector<std::string> specs = options.listen;
+        if(specs.empty()) {
+            specs.push_back("*:" + std::to_string(options.port));
         }
-        
-        // Set socket options to reuse address and port
-        int opt = 1;
-        if(setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-            throw std::runtime_error("Failed to set socket options");
+        std::optional<handoff::Inherited> inherited;
+        if(!options.inherit_from.empty()) {
+            inherited = handoff::inherit(options.inherit_from, config::HANDOFF_TIMEOUT * 1000);
+            predecessor = inherited->connection;
         }
-        
-        // Setup server address
-        std::memset(&this->server_address, 0, sizeof(this->server_address));
-        server_address.sin_family = AF_INET;
-        server_address.sin_addr.s_addr = INADDR_ANY;
-        server_address.sin_port = htons(port);
-        
-        // Bind socket
-        if(bind(server_fd, (struct sockaddr *)&server_address, sizeof(server_address)) < 0) {
-            throw std::runtime_error("Failed to bind to port " + std::to_string(port));
+        for(const auto &spec : specs) {
+            // An inherited socket keeps its accept queue; listening again applies our backlog
+            std::optional<Listener> reused;
+            if(inherited) {
+                reused = take_listener(inherited->listeners, spec);
+            }
+            if(reused) {
+                listen(reused->fd, options.backlog);
+                listeners.push_back(std::move(*reused));
+                std::cout << "Listening on " << spec << " (inherited)" << std::endl;
+            } else {
+                listeners.push_back(open_listener(spec, options));
+                std::cout << "Listening on " << spec << std::endl;
+            }
+            if(listeners.back().tls && !tls_context) {
+                tls_context = std::make_unique<tls::Context>(options);
+            }
         }
-        
-        // Listen for connections
-        int connection_backlog = 5;
-        if(listen(server_fd, connection_backlog) < 0) {
-            throw std::runtime_error("Failed to listen on port " + std::to_string(port));
+        if(inherited) {
+            // Not configured here any more; the old process still owns their socket files
+            for(auto &listener : inherited->listeners) {
+                listener.unix_path.clear();
+                close_listener(listener);
+            }
+            if(inherited->control_path == options.upgrade_socket) {
+                upgrade_fd = std::exchange(inherited->control_fd, -1);
+            } else if(inherited->control_fd >= 0) {
+                close(inherited->control_fd);
+            }
+        }
+        if(!options.upgrade_socket.empty() && upgrade_fd < 0) {
+            upgrade_fd = handoff::open_control(options.upgrade_socket);
+        }
+        drain_fd = eventfd(0, EFD_CLOEXEC);
+        if(drain_fd < 0) {
+            throw std::runtime_error("Failed to create eventfd: " + std::string(strerror(errno)));
+        }
+
+        if(options.cache_size > 0) {
+            enable_response_cache(options.cache_size);
+        }
+        if(options.client_limits.max_connections_per_ip > 0 || options.client_limits.requests_per_second > 0) {
+            set_client_limits(options.client_limits);
+        }
+        if(options.trace_sample > 0) {
+            enable_tracing(options.trace_sample, options.trace_file);
         }
         
-        std::cout << "Server initialized on port " << port << std::endl;
+        std::cout << "Server initialized" << std::endl;
     } catch (const std::exception& e) {
-        // Close socket if it was opened
-        if(server_fd >= 0) {
-            close(server_fd);
-            server_fd = -1;
+        // Close the listeners that were opened; inherited socket files stay with the old process,
+        // which keeps serving once we hang up on it
+        for(auto &listener : listeners) {
+            if(predecessor >= 0) {
+                listener.unix_path.clear();
+            }
+            close_listener(listener);
+        }
+        if(predecessor >= 0) {
+            close(predecessor);
+        }
+        if(upgrade_fd >= 0) {
+            close(upgrade_fd);
         }
         std::cerr << "Server initialization error: " << e.what() << std::endl;
         throw;  // Re-throw to be handled by main()
     }
 }
 
-void http_server::HTTP_Server::add_route(const std::string &method, const std::string &path_pattern, Handler handler) {
+void http_server::HTTP_Server::configure_connection(int client_fd, const Listener &listener) const {
+    if(listener.is_tcp()) {
+        int nodelay = options.tcp_nodelay ? 1 : 0;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+    if(options.keep_alive_timeout > 0) {
+        // recv() fails with EAGAIN once the connection has been idle this long
+        timeval timeout{options.keep_alive_timeout, 0};
+        setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+}
+
+void http_server::HTTP_Server::add_route(const std::string &method, const std::string &path_pattern, Handler handler,
+                                        std::optional<CachePolicy> cache_policy) {
     try {
         // Compile the path pattern into a regex
         auto [regex_pattern, path_params] = Router::compile_path_pattern(path_pattern);
         
         // Add the route to the router
-        this->router.add_route(method, path_pattern, handler);
+        this->router.add_route(method, path_pattern, handler, std::move(cache_policy));
     } catch (const std::exception& e) {
         std::cerr << "Error adding route: " << e.what() << std::endl;
         throw; // Re-throw to be handled by the caller
     }
 }
 
+void http_server::HTTP_Server::add_route(const std::string &method, const std::string &path_pattern, AsyncHandler handler,
+                                        std::optional<CachePolicy> cache_policy) {
+    this->router.add_route(method, path_pattern, std::move(handler), std::move(cache_policy));
+}
+
+void http_server::HTTP_Server::enable_response_cache(size_t max_bytes) {
+    this->router.enable_cache(max_bytes);
+}
+
+void http_server::HTTP_Server::set_client_limits(const ClientLimits &limits) {
+    this->limiter = std::make_unique<ClientLimiter>(limits);
+}
+
+void http_server::HTTP_Server::enable_tracing(uint32_t sample_every, const std::string &dump_prefix) {
+    trace::set_sampling(sample_every);
+    trace::dump_on_signal(SIGUSR1, dump_prefix);
+    router.add_route("GET", "/debug/trace", [](const HTTP_Request &, const Params &) {
+        return HTTP_Response {
+            (int)HTTP_STATUS_CODE::OK,
+            "OK",
+            {{"Content-Type", "application/json"}},
+            trace::dump_json()
+        };
+    });
+    std::cout << "Tracing 1 in " << sample_every << " requests; SIGUSR1 or GET /debug/trace dumps them" << std::endl;
+}
+
+void http_server::HTTP_Server::add_head_check(HeadCheck check) {
+    head_checks.push_back(std::move(check));
+}
+
+void http_server::HTTP_Server::stream_request_bodies(std::string prefix) {
+    while(!prefix.empty() && prefix.back() == '/') {
+        prefix.pop_back();
+    }
+    streamed_prefixes.push_back(std::move(prefix));
+}
+
+bool http_server::HTTP_Server::streams_body(const HTTP_Request &request) const {
+    for(const auto &prefix : streamed_prefixes) {
+        if(request.path.compare(0, prefix.size(), prefix) == 0 &&
+           (request.path.size() == prefix.size() || request.path[prefix.size()] == '/')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<http_server::HTTP_Response> http_server::HTTP_Server::check_head(const HTTP_Request &request) const {
+    // 100-continue is the only expectation defined (RFC 9110 section 10.1.1)
+    if(const std::string *expect = request.headers.get(HTTP_HEADER::EXPECT)) {
+        if(request.version != "HTTP/1.0" && !iequals(*expect, "100-continue")) {
+            return HTTP_Response {
+                (int)HTTP_STATUS_CODE::EXPECTATION_FAILED,
+                "Expectation Failed",
+                {},
+                "Unsupported expectation: " + *expect
+            };
+        }
+    }
+    std::optional<size_t> length = content_length(request);
+    if(length && *length > options.max_body_size) {
+        return HTTP_Response {
+            (int)HTTP_STATUS_CODE::CONTENT_TOO_LARGE,
+            "Content Too Large",
+            {},
+            "Request body is limited to " + std::to_string(options.max_body_size) + " bytes"
+        };
+    }
+    for(const auto &check : head_checks) {
+        if(auto response = check(request)) {
+            return response;
+        }
+    }
+    return std::nullopt;
+}
+
+http_server::HTTP_Response http_server::HTTP_Server::dispatch(const HTTP_Request &request, ClientKey client) const {
+    if(limiter) {
+        auto wait = limiter->try_request(client);
+        if(wait.count() > 0) {
+            return HTTP_Response {
+                (int)HTTP_STATUS_CODE::TOO_MANY_REQUESTS,
+                "Too Many Requests",
+                {{"Retry-After", std::to_string(std::chrono::ceil<std::chrono::seconds>(wait).count())}},
+                ""
+            };
+        }
+    }
+    return this->router.dispatch(request);
+}
+
 void http_server::HTTP_Server::run() {
     try {
         std::cout << "Server starting to listen for connections..." << std::endl;
+
+        std::vector<pollfd> waiting;
+        for(const auto &listener : listeners) {
+            waiting.push_back(pollfd{listener.fd, POLLIN, 0});
+        }
+        size_t control_slot = waiting.size();
+        waiting.push_back(pollfd{upgrade_fd, POLLIN, 0});
+        waiting.push_back(pollfd{drain_fd, POLLIN, 0});
+
+        // Accepting from here on, so the process that handed its listeners over can stop
+        if(predecessor >= 0) {
+            handoff::ready(predecessor);
+            std::cout << "Took over the listeners from " << options.inherit_from << std::endl;
+        }
         
-        while(true) {
-            try {
-                struct sockaddr_in client_address;
-                int client_address_len = sizeof(client_address);
-                
-                int client_fd = accept(this->server_fd, (struct sockaddr *)&client_address, (socklen_t*)&client_address_len);
-                if(client_fd < 0) {
-                    throw std::runtime_error("Accept failed: " + std::string(strerror(errno)));
+        while(!draining) {
+            if(poll(waiting.data(), waiting.size(), -1) < 0) {
+                if(errno != EINTR) {
+                    std::cerr << "Error waiting for connections: " << strerror(errno) << std::endl;
+                }
+                continue;
+            }
+            for(size_t i = 0; i < listeners.size(); ++i) {
+                if(waiting[i].revents & POLLIN) {
+                    accept_connection(listeners[i]);
+                }
+            }
+            if(waiting[control_slot].revents & POLLIN) {
+                int connection = accept4(upgrade_fd, nullptr, nullptr, SOCK_CLOEXEC);
+                if(connection >= 0 && handing_off.exchange(true)) {
+                    close(connection);  // one replacement at a time
+                } else if(connection >= 0) {
+                    std::thread(&HTTP_Server::hand_off, this, connection).detach();
                 }
-                
-                // Create a detached thread to handle the client
-                std::thread([this, client_fd, client_address]() {
-                    try {
-                        handle_client_connection(client_fd, client_address);
-                    } catch (const std::exception& e) {
-                        std::cerr << "Error handling client: " << e.what() << std::endl;
-                    }
-                    // Ensure the client socket is closed even if an exception occurs
-                    shutdown(client_fd, SHUT_RDWR);
-                    close(client_fd);
-                }).detach();
-            } catch (const std::exception& e) {
-                std::cerr << "Error accepting connection: " << e.what() << std::endl;
-                // Continue to accept other connections even if one fails
             }
         }
+        drain();
     } catch (const std::exception& e) {
         std::cerr << "Server error: " << e.what() << std::endl;
         throw; // Re-throw to be handled by main()
     }
 }
 
-void http_server::HTTP_Server::handle_client_connection(int client_fd, const sockaddr_in& client_address) {
-    char buffer[BUF_LEN];
-    std::string raw_request;
+void http_server::HTTP_Server::accept_connection(const Listener &listener) {
+    try {
+        sockaddr_storage client_address{};
+        socklen_t client_address_len = sizeof(client_address);
+        
+        int client_fd = accept4(listener.fd, (struct sockaddr *)&client_address, &client_address_len, SOCK_CLOEXEC);
+        if(client_fd < 0) {
+            throw std::runtime_error("Accept failed: " + std::string(strerror(errno)));
+        }
+
+        // Over the per-IP connection cap: reset before spending a thread on it
+        ClientConnection client{ClientLimiter::client_key(client_address), false};
+        if(limiter) {
+            std::optional<ClientConnection> admitted = limiter->try_acquire_connection(client.client);
+            if(!admitted) {
+                struct linger reset{1, 0};
+                setsockopt(client_fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+                close(client_fd);
+                return;
+            }
+            client = *admitted;
+        }
+        
+        configure_connection(client_fd, listener);
+        std::string client_ip = format_peer(client_address, listener);
+
+        // Create a detached thread to handle the client
+        ++connections;
+        std::thread([this, client_fd, client_ip, client, tls = listener.tls]() {
+            // A TLS connection is served through the descriptor the handshake hands back
+            int fd = tls ? tls_context->accept(client_fd, client_ip) : client_fd;
+            if(fd >= 0) {
+                serve_connection(fd, client_ip, client);
+                return;
+            }
+            if(limiter) {
+                limiter->release_connection(client);
+            }
+            --connections;
+        }).detach();
+    } catch (const std::exception& e) {
+        std::cerr << "Error accepting connection: " << e.what() << std::endl;
+        // Continue to accept other connections even if one fails
+    }
+}
+
+void http_server::HTTP_Server::hand_off(int connection) {
+    std::cout << "Handing the listeners to a new process" << std::endl;
+    bool taken = handoff::hand_over(connection, listeners, upgrade_fd, options.upgrade_socket, config::HANDOFF_TIMEOUT * 1000);
+    close(connection);
+    if(!taken) {
+        std::cerr << "Handoff failed; still accepting" << std::endl;
+        handing_off = false;
+        return;
+    }
+    draining = true;
+    uint64_t one = 1;
+    if(write(drain_fd, &one, sizeof(one)) < 0) {
+        std::cerr << "Failed to signal drain: " << strerror(errno) << std::endl;
+    }
+}
+
+void http_server::HTTP_Server::drain() {
+    // The new process owns the addresses now; close our copies without removing socket files
+    for(auto &listener : listeners) {
+        listener.unix_path.clear();
+        close_listener(listener);
+    }
+    close(upgrade_fd);
+    upgrade_fd = -1;
+
+    std::cout << "Stopped accepting; draining " << connections << " connections" << std::endl;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(options.drain_timeout);
+    while(connections > 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    if(connections > 0) {
+        std::cerr << "Drain timed out with " << connections << " connections open" << std::endl;
+    } else {
+        std::cout << "Drained" << std::endl;
+    }
+}
+
+void http_server::HTTP_Server::serve_connection(int client_fd, const std::string &client_ip, ClientConnection client,
+                                                std::optional<Resumption> resumed) {
+    Outcome outcome = Outcome::closed;
+    try {
+        outcome = handle_client_connection(client_fd, client_ip, client, std::move(resumed));
+    } catch (const std::exception& e) {
+        std::cerr << "Error handling client: " << e.what() << std::endl;
+    }
+    if(outcome == Outcome::suspended) {
+        return;     // the event loop holds the connection, and its place in the counts
+    }
+    // Ensure the client socket is closed even if an exception occurs
+    if(outcome != Outcome::handed_off) {
+        if(tls_context) {
+            tls_context->close_notify(client_fd);
+        }
+        shutdown(client_fd, SHUT_RDWR);
+        close(client_fd);
+    }
+    if(limiter) {
+        limiter->release_connection(client);
+    }
+    --connections;
+}
+
+http_server::async::Task<void> http_server::HTTP_Server::resume_deferred(
+        int client_fd, std::string client_ip, ClientConnection client, HTTP_Request request,
+        std::function<async::Task<HTTP_Response>()> deferred, std::string pending, int requests) {
+    HTTP_Response response;
+    try {
+        response = co_await deferred();
+    } catch (const std::exception& e) {
+        std::cerr << "Error dispatching request: " << e.what() << std::endl;
+        response = HTTP_Response {
+            (int)HTTP_STATUS_CODE::INTERNAL_SERVER_ERROR,
+            "Internal Server Error",
+            {},
+            "An error occurred while processing your request"
+        };
+    }
+    // Sending blocks, and so does waiting for the next request: back to a connection thread
+    std::thread([this, client_fd, client_ip = std::move(client_ip), client,
+                 resumed = Resumption{std::move(request), std::move(response), std::move(pending), requests}]() mutable {
+        serve_connection(client_fd, client_ip, client, std::move(resumed));
+    }).detach();
+}
+
+http_server::HTTP_Server::Outcome http_server::HTTP_Server::handle_client_connection(
+        int client_fd, const std::string &client_ip, ClientConnection client, std::optional<Resumption> resumed) {
+    std::string pending;    // bytes received but not yet parsed, may hold pipelined requests
     bool keep_alive = true;
-    
-    // Get client IP for logging
-    char client_ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &client_address.sin_addr, client_ip, INET_ADDRSTRLEN);
-    std::cout << "New client connection from " << client_ip << std::endl;
-    
     int requests = 0;
+
+    if(resumed) {
+        pending = std::move(resumed->pending);
+        requests = resumed->requests;
+        try {
+            Outcome outcome = respond(client_fd, client_ip, resumed->request, resumed->response, false, pending, requests);
+            if(outcome != Outcome::open) {
+                return outcome;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error processing request from " << client_ip << ": " << e.what() << std::endl;
+            return Outcome::closed;
+        }
+    } else {
+        std::cout << "New client connection from " << client_ip << std::endl;
+    }
+    // HTTP/2 sessions check each stream's head themselves, before taking its body
+    auto dispatch_client = [this, client = client.client](const HTTP_Request &request) {
+        return dispatch(request, client);
+    };
+    auto check_client = [this](const HTTP_Request &request) {
+        return check_head(request);
+    };
+    
+    int idle_timeout_ms = options.keep_alive_timeout > 0 ? options.keep_alive_timeout * 1000 : -1;
     while(keep_alive) {
         try {
-            // Clear previous data
-            memset(buffer, 0, BUF_LEN);
-            
-            // Receive data
-            int bytes_read = recv(client_fd, buffer, BUF_LEN - 1, 0);
-            if(bytes_read <= 0) {
-                // Client disconnected or error
-                if (bytes_read < 0) {
-                    std::cerr << "Error reading from socket: " << strerror(errno) << std::endl;
+            trace::Request traced;  // sampled requests record their phases from here on
+
+            // Receive until the request head is buffered; the body is read once the head is accepted
+            size_t head_size = 0;
+            bool disconnected = false;
+            bool head_too_large = false;
+            {
+                trace::Span recv_span("recv");
+                size_t head_end;
+                while((head_end = pending.find("\r\n\r\n")) == std::string::npos) {
+                    if(pending.size() > options.max_header_size) {
+                        head_too_large = true;
+                        break;
+                    }
+                    // Once draining, an idle keep-alive connection only waits briefly: the client may
+                    // have sent its next request already. A fresh connection still gets its first one.
+                    bool idle = pending.empty();
+                    if(idle) {
+                        // This thread serves only this connection: its cached buffers would sit unused
+                        buffer_pool::flush_thread_cache();
+                    }
+                    int timeout_ms = idle_timeout_ms;
+                    int wake_fd = -1;
+                    if(idle && requests > 0) {
+                        if(draining) {
+                            timeout_ms = (timeout_ms < 0) ? config::DRAIN_IDLE_MS : std::min(timeout_ms, config::DRAIN_IDLE_MS);
+                        } else {
+                            wake_fd = drain_fd;
+                        }
+                    }
+                    ssize_t bytes_read = read_available(client_fd, pending, timeout_ms, wake_fd);
+                    if(bytes_read < 0 && errno == EAGAIN && wake_fd >= 0 && draining) {
+                        continue;
+                    }
+                    if(bytes_read <= 0) {
+                        // Client disconnected, went idle past the keep-alive timeout, or error
+                        if (bytes_read < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                            std::cerr << "Error reading from socket: " << strerror(errno) << std::endl;
+                        }
+                        disconnected = true;
+                        recv_span.cancel();
+                        traced.cancel();
+                        break;
+                    }
+                    if(idle) {
+                        // Time spent waiting on an idle keep-alive connection is not part of the request
+                        traced.restart();
+                        recv_span.restart();
+                    }
                 }
+                if(head_end != std::string::npos) {
+                    head_size = head_end + 4;
+                    head_too_large = head_size > options.max_header_size;
+                }
+            }
+            if(disconnected) {
                 break;
             }
+            if(head_too_large) {
+                HTTP_Response error_response {
+                    (int)HTTP_STATUS_CODE::REQUEST_HEADER_FIELDS_TOO_LARGE,
+                    "Request Header Fields Too Large",
+                    {{"Connection", "close"}},
+                    "Request head is limited to " + std::to_string(options.max_header_size) + " bytes"
+                };
+                std::string response_str = error_response.to_string();
+                send_all(client_fd, response_str.c_str(), response_str.length());
+                linger_close(client_fd);
+                break;
+            }
+
+            // HTTP/2 with prior knowledge opens with the connection preface instead of a request
+            if(requests == 0 && pending.rfind("PRI * HTTP/2.0\r\n\r\n", 0) == 0) {
+                traced.cancel();    // streams are traced one by one on their own threads
+                http2::Session session(client_fd, dispatch_client, client_ip, std::move(pending));
+                session.check_heads(check_client, options.max_body_size);
+                session.drain_on(drain_fd);
+                session.run();
+                return Outcome::closed;
+            }
             
-            raw_request = std::string(buffer, bytes_read);
+            std::string raw_head = pending.substr(0, head_size);
+            pending.erase(0, head_size);
             
-            // Parse and dispatch the request
+            // Parse the head
             HTTP_Request request;
             try {
-                request = parse_request(raw_request);
+                trace::Span span("parse");
+                request = parse_request(raw_head);
+                request.remote_address = client_ip;
+                if(traced) {
+                    traced.set_label(request.method + " " + request.path);
+                }
             } catch (const std::exception& e) {
                 std::cerr << "Failed to parse request: " << e.what() << std::endl;
                 // Send bad request response
@@ -149,51 +708,117 @@ void http_server::HTTP_Server::handle_client_connection(int client_fd, const soc
                 send(client_fd, response_str.c_str(), response_str.length(), 0);
                 break; // Close connection on parse error
             }
-            
-            // Process the request
-            HTTP_Response response;
-            try {
-                response = this->router.dispatch(request);
-            } catch (const std::exception& e) {
-                std::cerr << "Error dispatching request: " << e.what() << std::endl;
-                response = HTTP_Response {
-                    (int)HTTP_STATUS_CODE::INTERNAL_SERVER_ERROR,
-                    "Internal Server Error",
-                    {},
-                    "An error occurred while processing your request"
-                };
+
+            // Refuse before reading the body; a client waiting for 100 Continue never sends it
+            size_t body_length = content_length(request).value_or(0);
+            bool has_body = body_length > 0 || is_chunked(request);
+            std::optional<HTTP_Response> refused = check_head(request);
+            bool send_continue = !refused && has_body && expects_continue(request);
+            // Left on the connection for the handler to read, like a chunked body
+            bool stream_body = !refused && body_length > 0 && streams_body(request);
+
+            if(!refused && body_length > 0 && !stream_body) {
+                trace::Span span("recv");
+                if(send_continue && pending.empty() && !send_all(client_fd, CONTINUE_RESPONSE, sizeof(CONTINUE_RESPONSE) - 1)) {
+                    break;
+                }
+                send_continue = false;
+                bool body_complete = true;
+                while(pending.size() < body_length) {
+                    if(read_available(client_fd, pending, idle_timeout_ms) <= 0) {
+                        body_complete = false;
+                        break;
+                    }
+                }
+                if(!body_complete) {
+                    span.cancel();
+                    break;
+                }
+                request.body = pending.substr(0, body_length);
+                pending.erase(0, body_length);
+            }
+            if(pending.empty()) {
+                // Nothing pipelined behind it: drop the storage so the connection idles with no buffer
+                std::string().swap(pending);
             }
             
-            // Check if keep-alive
-            keep_alive = false;
-            if(request.version == "HTTP/1.1") {
-                auto it = request.headers.find("Connection");
-                keep_alive = ((it == request.headers.end()) || (it->second != "close"));
-            } else if(request.version == "HTTP/1.0") {
-                auto it = request.headers.find("Connection");
-                keep_alive = ((it != request.headers.end()) && (it->second == "keep-alive"));
+            if(!refused && is_h2c_upgrade(request)) {
+                traced.cancel();
+                std::string switching = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+                if(send(client_fd, switching.c_str(), switching.length(), 0) < 0) {
+                    break;
+                }
+                http2::Session session(client_fd, dispatch_client, client_ip, std::move(pending));
+                session.check_heads(check_client, options.max_body_size);
+                session.set_upgrade(request, *request.headers.get(HTTP_HEADER::HTTP2_SETTINGS));
+                session.drain_on(drain_fd);
+                session.run();
+                return Outcome::closed;
             }
             
-            // Set Connection header in response accordingly
-            if(keep_alive) {
-                response.headers["Connection"] = "keep-alive";
+            // A chunked or streamed body stays on the connection and is decoded as the handler
+            // reads it; 100 Continue goes out only once the handler asks for the body
+            size_t body_remaining = 0;
+            if(stream_body) {
+                body_remaining = body_length;
+                request.body_stream = [&](const BodySink &sink) {
+                    if(std::exchange(send_continue, false) && pending.empty() &&
+                       !send_all(client_fd, CONTINUE_RESPONSE, sizeof(CONTINUE_RESPONSE) - 1)) {
+                        return false;
+                    }
+                    return read_length_body(client_fd, pending, body_remaining, idle_timeout_ms, sink);
+                };
+            }
+            std::optional<ChunkedDecoder> body_decoder;
+            if(!refused && is_chunked(request)) {
+                body_decoder.emplace(ChunkedLimits{config::MAX_CHUNK_LINE, options.max_header_size, options.max_body_size});
+                request.body_stream = [&, &decoder = *body_decoder](const BodySink &sink) {
+                    if(std::exchange(send_continue, false) && pending.empty() &&
+                       !send_all(client_fd, CONTINUE_RESPONSE, sizeof(CONTINUE_RESPONSE) - 1)) {
+                        return false;
+                    }
+                    if(!read_chunked_body(client_fd, pending, decoder, idle_timeout_ms, sink)) {
+                        return false;
+                    }
+                    request.trailers = decoder.trailers();
+                    return true;
+                };
+            }
+
+            // Process the request
+            HTTP_Response response;
+            if(refused) {
+                response = std::move(*refused);
             } else {
-                response.headers["Connection"] = "close";
+                try {
+                    response = dispatch(request, client.client);
+                } catch (const std::exception& e) {
+                    std::cerr << "Error dispatching request: " << e.what() << std::endl;
+                    response = HTTP_Response {
+                        (int)HTTP_STATUS_CODE::INTERNAL_SERVER_ERROR,
+                        "Internal Server Error",
+                        {},
+                        "An error occurred while processing your request"
+                    };
+                }
             }
+            // Whether the connection is still positioned at the next request
+            bool body_unread = refused ? has_body : ((body_decoder && !body_decoder->done()) || body_remaining > 0);
             
-            // Send response
-            std::string response_str = response.to_string();
-            if (send(client_fd, response_str.c_str(), response_str.length(), 0) < 0) {
-                std::cerr << "Error sending response: " << strerror(errno) << std::endl;
-                break;
+            if(response.deferred) {
+                if(!request.body_stream) {
+                    // The handler awaits on the event loop instead of holding this thread
+                    async::spawn(resume_deferred(client_fd, client_ip, client, std::move(request),
+                                                 std::move(response.deferred), std::move(pending), requests));
+                    return Outcome::suspended;
+                }
+                // Only this thread can read the streamed body the handler may ask for
+                response = async::sync_wait(response.deferred());
             }
-            
-            // Log the request
-            std::cout << client_ip << " - " << request.method << " " << request.path 
-                      << " - " << response.status_code << std::endl;
-            
-            if(!keep_alive || ++requests >= http_server::config::MAX_KEEP_ALIVE_REQUESTS) {
-                break;
+
+            Outcome outcome = respond(client_fd, client_ip, request, response, body_unread, pending, requests);
+            if(outcome != Outcome::open) {
+                return outcome;
             }
         } catch (const std::exception& e) {
             std::cerr << "Error processing request from " << client_ip << ": " << e.what() << std::endl;
@@ -211,15 +836,111 @@ void http_server::HTTP_Server::handle_client_connection(int client_fd, const soc
             break; // Close connection on error
         }
     }
+    return Outcome::closed;
 }
 
-http_server::HTTP_Server::~HTTP_Server() {
-    try {
-        if(server_fd >= 0) {
-            close(server_fd);
-            server_fd = -1;
+http_server::HTTP_Server::Outcome http_server::HTTP_Server::respond(int client_fd, const std::string &client_ip,
+                                                                   const HTTP_Request &request, HTTP_Response &response,
+                                                                   bool body_unread, std::string &pending, int &requests) {
+    // A 101 hands the socket, and anything read past the request, to the new protocol;
+    // other responses taking the socket over are delimited by closing it
+    if(response.takeover) {
+        if(response.status_code != (int)HTTP_STATUS_CODE::SWITCHING_PROTOCOLS) {
+            response.headers.set(HTTP_HEADER::CONNECTION, "close");
         }
-    } catch (const std::exception& e) {
-        std::cerr << "Error closing server socket: " << e.what() << std::endl;
+        std::string head = response.to_string();
+        if(!send_all(client_fd, head.data(), head.size())) {
+            return Outcome::closed;
+        }
+        std::cout << client_ip << " - " << request.method << " " << request.path
+                  << " - " << response.status_code << std::endl;
+        response.takeover(client_fd, std::move(pending));
+        return Outcome::handed_off;
+    }
+
+    // Streamed bodies of unknown length are chunked, or delimited by closing for HTTP/1.0
+    bool chunked = false;
+    if(response.body_stream && !response.headers.contains(HTTP_HEADER::CONTENT_LENGTH)) {
+        chunked = (request.version == "HTTP/1.1");
+        if(chunked) {
+            response.headers.set(HTTP_HEADER::TRANSFER_ENCODING, "chunked");
+        }
+    }
+
+    // Check if keep-alive; the last request allowed on this connection closes it
+    bool keep_alive = false;
+    const std::string *connection = request.headers.get(HTTP_HEADER::CONNECTION);
+    if(request.version == "HTTP/1.1") {
+        keep_alive = (connection == nullptr) || !iequals(*connection, "close");
+    } else if(request.version == "HTTP/1.0") {
+        keep_alive = (connection != nullptr) && iequals(*connection, "keep-alive");
+    }
+    if(++requests >= options.keep_alive_requests) {
+        keep_alive = false;
+    }
+    // Listeners handed to a new process: the client's next request goes there
+    if(draining) {
+        keep_alive = false;
+    }
+    if(response.body_stream && !chunked && !response.headers.contains(HTTP_HEADER::CONTENT_LENGTH)) {
+        keep_alive = false;
+    }
+    // The rest of an unread or rejected request body would be taken for the next request
+    if(body_unread) {
+        keep_alive = false;
+    }
+    if(pending.empty()) {
+        std::string().swap(pending);
+    }
+
+    // Set Connection header in response accordingly
+    if(keep_alive) {
+        response.headers.set(HTTP_HEADER::CONNECTION, "keep-alive");
+    } else {
+        response.headers.set(HTTP_HEADER::CONNECTION, "close");
+    }
+
+    // Send response
+    // With a streamed body, hold the head back so it shares a segment with the first piece
+    {
+        trace::Span span("send");
+        std::string response_str = response.to_string();
+        int head_flags = (response.body_stream && options.cork) ? MSG_MORE : 0;
+        if (!send_all(client_fd, response_str.c_str(), response_str.length(), head_flags)) {
+            std::cerr << "Error sending response: " << strerror(errno) << std::endl;
+            return Outcome::closed;
+        }
+        if(response.body_stream && !send_body_stream(client_fd, response.body_stream, chunked, options.cork)) {
+            std::cerr << "Streaming response body to " << client_ip << " failed" << std::endl;
+            return Outcome::closed;
+        }
+    }
+
+    // Log the request
+    std::cout << client_ip << " - " << request.method << " " << request.path 
+              << " - " << response.status_code << std::endl;
+
+    if(!keep_alive) {
+        if(body_unread) {
+            linger_close(client_fd);
+        }
+        return Outcome::closed;
+    }
+    return Outcome::open;
+}
+
+http_server::HTTP_Server::~HTTP_Server() {
+    for(auto &listener : listeners) {
+        close_listener(listener);
+    }
+    if(upgrade_fd >= 0) {
+        close(upgrade_fd);
+        unlink(options.upgrade_socket.c_str());
+    }
+    if(predecessor >= 0) {
+        close(predecessor);
+    }
+    if(drain_fd >= 0) {
+        close(drain_fd);
     }
 }
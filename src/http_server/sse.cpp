@@ -0,0 +1,339 @@
+#include <http_server/sse.hpp>
+#include <http_server/async/event_loop.hpp>
+#include <http_server/status.hpp>
+#include <cerrno>           // errno
+#include <deque>            // std::deque
+#include <iostream>         // std::cerr
+#include <stdexcept>        // std::invalid_argument
+#include <string_view>      // std::string_view
+#include <sys/socket.h>     // sendmsg(), shutdown()
+#include <sys/uio.h>        // iovec
+#include <unistd.h>         // close()
+
+namespace http_server::sse {
+    namespace {
+        using Payload = std::shared_ptr<const std::string>;
+
+        constexpr size_t MAX_IOVECS = 64;   // queued events gathered into one sendmsg()
+
+        // Comment line written to idle streams, so proxies keep them open and dead peers are noticed
+        const Payload HEARTBEAT = std::make_shared<const std::string>(":\n\n");
+
+        void check_field(const std::string &value, const char *name) {
+            if (value.find_first_of("\r\n") != std::string::npos) {
+                throw std::invalid_argument(std::string("Event ") + name + " contains a line break");
+            }
+        }
+    }
+
+    // One event stream connection. Publishers append to 'queue'; a single writer coroutine
+    // at a time drains it, and a watcher coroutine notices when the client goes away.
+    class Subscriber {
+    public:
+        enum class Push { QUEUED, CLOSED, OVERFLOW };
+
+        Subscriber(std::weak_ptr<Broadcaster> owner, std::string topic, int fd, std::string peer, size_t max_queued)
+            : owner(std::move(owner)), topic(std::move(topic)), fd(fd), peer(std::move(peer)), max_queued(max_queued) {}
+        ~Subscriber() {
+            ::close(fd);
+        }
+
+        const std::weak_ptr<Broadcaster> owner;
+        const std::string topic;
+        const int fd;
+        const std::string peer;
+        const size_t max_queued;
+        size_t slot = 0;    // index in the topic's list; guarded by the broadcaster's mutex
+
+        // Queue 'payload'; 'start' is set when no writer is running and one must be spawned
+        Push push(const Payload &payload, bool &start) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (closed) {
+                return Push::CLOSED;
+            }
+            if (queued + payload->size() > max_queued) {
+                closed = true;
+                return Push::OVERFLOW;
+            }
+            queue.push_back(payload);
+            queued += payload->size();
+            start = !writing;
+            writing = true;
+            return Push::QUEUED;
+        }
+
+        // Stop writing and wake the watcher, which unsubscribes
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            ::shutdown(fd, SHUT_RDWR);
+        }
+
+        static async::Task<void> write(std::shared_ptr<Subscriber> self);
+        static async::Task<void> watch(std::shared_ptr<Subscriber> self);
+
+    private:
+        std::mutex mutex;           // guards everything below
+        std::deque<Payload> queue;
+        size_t offset = 0;          // bytes of the front payload already sent
+        size_t queued = 0;          // unsent bytes
+        bool writing = false;
+        bool closed = false;
+    };
+
+    async::Task<void> Subscriber::write(std::shared_ptr<Subscriber> self) {
+        iovec iov[MAX_IOVECS];
+        while (true) {
+            size_t count = 0;
+            {
+                std::lock_guard<std::mutex> lock(self->mutex);
+                if (self->closed || self->queue.empty()) {
+                    if (self->closed) {
+                        self->queue.clear();
+                        self->queued = self->offset = 0;
+                    }
+                    self->writing = false;
+                    co_return;
+                }
+                // Only the writer removes payloads, so these stay valid once the lock is released
+                for (const Payload &payload : self->queue) {
+                    if (count == MAX_IOVECS) {
+                        break;
+                    }
+                    size_t skip = (count == 0) ? self->offset : 0;
+                    iov[count++] = iovec{const_cast<char *>(payload->data()) + skip, payload->size() - skip};
+                }
+            }
+
+            msghdr message{};
+            message.msg_iov = iov;
+            message.msg_iovlen = count;
+            ssize_t sent = ::sendmsg(self->fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    if (co_await async::wait_writable(self->fd, std::chrono::seconds(config::SSE_SEND_TIMEOUT))) {
+                        continue;
+                    }
+                    if (auto owner = self->owner.lock()) {
+                        owner->evict(*self, "write stalled");
+                        continue;
+                    }
+                }
+                self->close();
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(self->mutex);
+            size_t remaining = static_cast<size_t>(sent);
+            self->queued -= remaining;
+            while (remaining > 0) {
+                size_t left = self->queue.front()->size() - self->offset;
+                if (remaining < left) {
+                    self->offset += remaining;
+                    break;
+                }
+                remaining -= left;
+                self->offset = 0;
+                self->queue.pop_front();
+            }
+        }
+    }
+
+    async::Task<void> Subscriber::watch(std::shared_ptr<Subscriber> self) {
+        // Clients send nothing after the request; reading only tells us when they leave
+        while (true) {
+            if (!co_await async::wait_readable(self->fd, std::chrono::seconds(config::SSE_HEARTBEAT_INTERVAL))) {
+                bool start = false;
+                Push pushed = self->push(HEARTBEAT, start);
+                if (pushed == Push::OVERFLOW) {
+                    if (auto owner = self->owner.lock()) {
+                        owner->evict(*self, "not reading");
+                    }
+                } else if (start) {
+                    async::spawn(write(self));
+                }
+                continue;
+            }
+            char discard[256];
+            ssize_t received = ::recv(self->fd, discard, sizeof(discard), MSG_DONTWAIT);
+            if (received > 0 || (received < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))) {
+                continue;
+            }
+            break;
+        }
+        self->close();
+        if (auto owner = self->owner.lock()) {
+            owner->unsubscribe(*self);
+        }
+    }
+
+    std::string encode(const Event &event) {
+        check_field(event.event, "type");
+        check_field(event.id, "id");
+
+        std::string out;
+        out.reserve(event.data.size() + event.event.size() + event.id.size() + 32);
+        if (!event.event.empty()) {
+            out.append("event: ").append(event.event) += '\n';
+        }
+        if (!event.id.empty()) {
+            out.append("id: ").append(event.id) += '\n';
+        }
+        if (event.retry_ms >= 0) {
+            out.append("retry: ").append(std::to_string(event.retry_ms)) += '\n';
+        }
+        // One data field per line; CRLF, LF and CR all end a line
+        std::string_view rest = event.data;
+        while (true) {
+            size_t end = rest.find_first_of("\r\n");
+            out.append("data: ").append(rest.substr(0, end)) += '\n';
+            if (end == std::string_view::npos) {
+                break;
+            }
+            bool crlf = rest[end] == '\r' && end + 1 < rest.size() && rest[end + 1] == '\n';
+            rest.remove_prefix(end + (crlf ? 2 : 1));
+        }
+        out += '\n';
+        return out;
+    }
+
+    Broadcaster::Broadcaster(size_t max_queued) : max_queued(max_queued) {}
+
+    size_t Broadcaster::publish(const std::string &topic, const Event &event) {
+        return publish_encoded(topic, std::make_shared<const std::string>(encode(event)));
+    }
+
+    size_t Broadcaster::publish_encoded(const std::string &topic, std::shared_ptr<const std::string> payload) {
+        std::vector<std::shared_ptr<Subscriber>> to_start;
+        std::vector<std::shared_ptr<Subscriber>> to_evict;
+        size_t reached = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = topics.find(topic);
+            if (it == topics.end()) {
+                return 0;
+            }
+            for (const auto &subscriber : it->second) {
+                bool start = false;
+                switch (subscriber->push(payload, start)) {
+                case Subscriber::Push::QUEUED:
+                    ++reached;
+                    if (start) {
+                        to_start.push_back(subscriber);
+                    }
+                    break;
+                case Subscriber::Push::OVERFLOW:
+                    to_evict.push_back(subscriber);
+                    break;
+                case Subscriber::Push::CLOSED:
+                    break;
+                }
+            }
+        }
+        // Writes and shutdowns happen outside the lock; most writes complete right here
+        for (const auto &subscriber : to_evict) {
+            evict(*subscriber, "not reading");
+        }
+        for (auto &subscriber : to_start) {
+            async::spawn(Subscriber::write(std::move(subscriber)));
+        }
+        return reached;
+    }
+
+    void Broadcaster::subscribe(const std::string &topic, int fd, std::string remote_address) {
+        auto subscriber = std::make_shared<Subscriber>(weak_from_this(), topic, fd, std::move(remote_address), max_queued);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto &list = topics[topic];
+            subscriber->slot = list.size();
+            list.push_back(subscriber);
+        }
+        async::spawn(Subscriber::watch(std::move(subscriber)));
+    }
+
+    void Broadcaster::unsubscribe(Subscriber &subscriber) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = topics.find(subscriber.topic);
+        if (it == topics.end()) {
+            return;
+        }
+        auto &list = it->second;
+        size_t slot = subscriber.slot;
+        if (slot >= list.size() || list[slot].get() != &subscriber) {
+            return;
+        }
+        // Swap with the last subscriber so removal is O(1)
+        if (slot + 1 != list.size()) {
+            list[slot] = std::move(list.back());
+            list[slot]->slot = slot;
+        }
+        list.pop_back();
+        if (list.empty()) {
+            topics.erase(it);
+        }
+    }
+
+    void Broadcaster::evict(Subscriber &subscriber, const char *reason) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++evicted;
+        }
+        std::cerr << "Dropping event stream subscriber " << subscriber.peer << ": " << reason << std::endl;
+        subscriber.close();
+    }
+
+    size_t Broadcaster::subscriber_count(const std::string &topic) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = topics.find(topic);
+        return it == topics.end() ? 0 : it->second.size();
+    }
+
+    uint64_t Broadcaster::evicted_count() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return evicted;
+    }
+
+    http_server::Handler Broadcaster::endpoint(TopicSelector topic) {
+        return [self = shared_from_this(), topic = std::move(topic)](const HTTP_Request &request, const Params &params) -> HTTP_Response {
+            // HTTP/2 streams have no socket of their own to hand over
+            if (request.version != "HTTP/1.1" && request.version != "HTTP/1.0") {
+                return HTTP_Response {
+                    (int)HTTP_STATUS_CODE::HTTP_VERSION_NOT_SUPPORTED,
+                    "HTTP Version Not Supported",
+                    {},
+                    "Event streams are served over HTTP/1.x"
+                };
+            }
+            std::string name = topic(request, params);
+            if (name.empty()) {
+                return HTTP_Response {
+                    (int)HTTP_STATUS_CODE::NOT_FOUND,
+                    "Not Found",
+                    {},
+                    "No such event stream"
+                };
+            }
+
+            HTTP_Response response {
+                (int)HTTP_STATUS_CODE::OK,
+                "OK",
+                {{"Content-Type", "text/event-stream"}, {"Cache-Control", "no-cache"}},
+                ""
+            };
+            response.takeover = [self, name, peer = request.remote_address](int fd, std::string) {
+                self->subscribe(name, fd, peer);
+            };
+            return response;
+        };
+    }
+
+    Broadcaster::TopicSelector topic_param(std::string name) {
+        return [name = std::move(name)](const HTTP_Request &, const Params &params) {
+            auto it = params.find(name);
+            return it == params.end() ? std::string() : it->second;
+        };
+    }
+}
@@ -0,0 +1,338 @@
+#include <http_server/tls.hpp>
+#include <http_server/config.hpp>
+#include <stdexcept>        // std::runtime_error
+#include <unistd.h>         // close()
+
+#ifdef HTTP_SERVER_TLS
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <algorithm>        // std::min
+#include <cerrno>           // errno
+#include <chrono>           // std::chrono
+#include <csignal>          // signal()
+#include <cstring>          // strerror()
+#include <fcntl.h>          // fcntl()
+#include <iostream>         // std::cerr
+#include <linux/tls.h>      // TLS_SET_RECORD_TYPE
+#include <netinet/tcp.h>    // TCP_ULP
+#include <poll.h>           // poll()
+#include <sys/socket.h>     // socketpair(), shutdown(), sendmsg(), SOL_TLS
+#include <thread>           // std::thread
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr size_t RELAY_CHUNK = 16 << 10;    // one TLS record of plaintext
+
+    // Most recent OpenSSL error on this thread, or errno when OpenSSL has none
+    std::string last_error() {
+        unsigned long code = ERR_get_error();
+        ERR_clear_error();
+        if(code == 0) {
+            return errno != 0 ? strerror(errno) : "connection closed";
+        }
+        char text[256];
+        ERR_error_string_n(code, text, sizeof(text));
+        return text;
+    }
+
+    void set_nonblocking(int fd, bool nonblocking) {
+        int flags = fcntl(fd, F_GETFL);
+        fcntl(fd, F_SETFL, nonblocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
+    }
+
+    // Prefer HTTP/2 when the client offers it; the connection then opens with the h2 preface
+    int select_alpn(SSL *, const unsigned char **out, unsigned char *out_length,
+                    const unsigned char *in, unsigned int in_length, void *) {
+        static const unsigned char protocols[] = "\x02h2\x08http/1.1";
+        unsigned char *selected = nullptr;
+        if(SSL_select_next_proto(&selected, out_length, protocols, sizeof(protocols) - 1, in, in_length) != OPENSSL_NPN_NEGOTIATED) {
+            return SSL_TLSEXT_ERR_NOACK;
+        }
+        *out = selected;
+        return SSL_TLSEXT_ERR_OK;
+    }
+
+    // Drive SSL_accept on a non-blocking socket; an empty result means it completed
+    std::string handshake(SSL *ssl, int fd, Clock::time_point deadline) {
+        while(true) {
+            ERR_clear_error();
+            errno = 0;
+            int result = SSL_accept(ssl);
+            if(result == 1) {
+                return "";
+            }
+            short events;
+            switch(SSL_get_error(ssl, result)) {
+            case SSL_ERROR_WANT_READ:
+                events = POLLIN;
+                break;
+            case SSL_ERROR_WANT_WRITE:
+                events = POLLOUT;
+                break;
+            default:
+                return last_error();
+            }
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+            if(left <= 0) {
+                return "timed out";
+            }
+            pollfd waiting{fd, events, 0};
+            if(poll(&waiting, 1, static_cast<int>(left)) < 0 && errno != EINTR) {
+                return strerror(errno);
+            }
+        }
+    }
+
+    // Move plaintext between the TLS connection on 'fd' and 'app', the socketpair end the HTTP
+    // code does not hold, until both directions are finished. Owns all three.
+    void relay(SSL *ssl, int fd, int app) {
+        set_nonblocking(app, true);
+        std::string to_app;         // decrypted, not yet taken by the HTTP side
+        std::string to_peer;        // from the HTTP side, not yet encrypted
+        size_t write_retry = 0;     // length of an SSL_write that must be repeated as it was
+        bool peer_done = false;     // the client closed its side
+        bool app_shut = false;      // ...and the HTTP side has been told
+        bool app_done = false;      // the HTTP side closed its end
+        char buffer[RELAY_CHUNK];
+
+        while(true) {
+            bool progressed = false;
+            bool broken = false;
+            short peer_events = 0;
+            short app_events = 0;
+
+            // Client to HTTP side, holding back while the HTTP side is slow to read
+            while(!peer_done && to_app.size() < 4 * RELAY_CHUNK) {
+                ERR_clear_error();
+                int received = SSL_read(ssl, buffer, sizeof(buffer));
+                if(received > 0) {
+                    to_app.append(buffer, static_cast<size_t>(received));
+                    progressed = true;
+                    continue;
+                }
+                int error = SSL_get_error(ssl, received);
+                if(error == SSL_ERROR_WANT_READ) {
+                    peer_events |= POLLIN;
+                } else if(error == SSL_ERROR_WANT_WRITE) {
+                    peer_events |= POLLOUT;
+                } else {
+                    // close_notify, or a plain TCP close, which clients commonly send instead
+                    peer_done = progressed = true;
+                }
+                break;
+            }
+            if(!to_app.empty()) {
+                ssize_t sent = send(app, to_app.data(), to_app.size(), MSG_NOSIGNAL);
+                if(sent > 0) {
+                    to_app.erase(0, static_cast<size_t>(sent));
+                    progressed = true;
+                } else if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    broken = true;
+                }
+                if(!to_app.empty()) {
+                    app_events |= POLLOUT;
+                }
+            } else if(peer_done && !app_shut) {
+                shutdown(app, SHUT_WR);
+                app_shut = progressed = true;
+            }
+
+            // HTTP side to client
+            if(!app_done && to_peer.size() < RELAY_CHUNK) {
+                ssize_t received = recv(app, buffer, sizeof(buffer), 0);
+                if(received > 0) {
+                    to_peer.append(buffer, static_cast<size_t>(received));
+                    progressed = true;
+                } else if(received == 0) {
+                    app_done = progressed = true;
+                } else if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                    app_events |= POLLIN;
+                } else {
+                    broken = true;
+                }
+            }
+            if(!to_peer.empty()) {
+                size_t length = write_retry ? write_retry : std::min(to_peer.size(), RELAY_CHUNK);
+                ERR_clear_error();
+                int sent = SSL_write(ssl, to_peer.data(), static_cast<int>(length));
+                if(sent > 0) {
+                    to_peer.erase(0, static_cast<size_t>(sent));
+                    write_retry = 0;
+                    progressed = true;
+                } else {
+                    int error = SSL_get_error(ssl, sent);
+                    write_retry = length;
+                    if(error == SSL_ERROR_WANT_WRITE) {
+                        peer_events |= POLLOUT;
+                    } else if(error == SSL_ERROR_WANT_READ) {
+                        peer_events |= POLLIN;
+                    } else {
+                        broken = true;
+                    }
+                }
+            }
+
+            if(broken) {
+                break;
+            }
+            if(app_done && to_peer.empty()) {
+                SSL_shutdown(ssl);      // best effort close_notify
+                break;
+            }
+            if(progressed) {
+                continue;
+            }
+            if(peer_events == 0 && app_events == 0) {
+                break;
+            }
+            pollfd waiting[2] = {{fd, peer_events, 0}, {app, app_events, 0}};
+            if(poll(waiting, 2, -1) < 0 && errno != EINTR) {
+                break;
+            }
+        }
+
+        SSL_free(ssl);
+        close(fd);
+        close(app);
+    }
+}
+
+http_server::tls::Context::Context(const ServerOptions &options) {
+    if(options.tls_cert.empty() || options.tls_key.empty()) {
+        throw std::runtime_error("TLS listeners need --tls-cert and --tls-key");
+    }
+    context = SSL_CTX_new(TLS_server_method());
+    if(context == nullptr) {
+        throw std::runtime_error("Failed to create TLS context: " + last_error());
+    }
+    auto fail = [this](const std::string &what) {
+        std::string reason = last_error();
+        SSL_CTX_free(context);
+        context = nullptr;
+        throw std::runtime_error(what + ": " + reason);
+    };
+
+    SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION);
+    if(SSL_CTX_use_certificate_chain_file(context, options.tls_cert.c_str()) != 1) {
+        fail("Failed to load certificate " + options.tls_cert);
+    }
+    if(SSL_CTX_use_PrivateKey_file(context, options.tls_key.c_str(), SSL_FILETYPE_PEM) != 1) {
+        fail("Failed to load private key " + options.tls_key);
+    }
+    if(SSL_CTX_check_private_key(context) != 1) {
+        fail("Certificate and private key do not match");
+    }
+
+    // Resumption skips the key exchange: by session ID from the shared cache, or by tickets
+    // sealed with keys that live as long as this context
+    static const unsigned char session_context[] = "http_server";
+    SSL_CTX_set_session_id_context(context, session_context, sizeof(session_context) - 1);
+    if(options.tls_session_cache > 0) {
+        SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(context, static_cast<long>(options.tls_session_cache));
+    } else {
+        SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_OFF);
+    }
+    if(!options.tls_tickets) {
+        SSL_CTX_set_options(context, SSL_OP_NO_TICKET);
+    }
+    if(options.ktls) {
+        // A renegotiation would arrive as a handshake record on a kernel-framed socket
+        SSL_CTX_set_options(context, SSL_OP_ENABLE_KTLS | SSL_OP_NO_RENEGOTIATION);
+    }
+    SSL_CTX_set_mode(context, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_RELEASE_BUFFERS);
+    SSL_CTX_set_alpn_select_cb(context, select_alpn, nullptr);
+
+    // OpenSSL writes with write(), so a client that went away must not kill the process
+    signal(SIGPIPE, SIG_IGN);
+}
+
+http_server::tls::Context::~Context() {
+    SSL_CTX_free(context);
+}
+
+int http_server::tls::Context::accept(int fd, const std::string &peer) {
+    SSL *ssl = SSL_new(context);
+    if(ssl == nullptr || SSL_set_fd(ssl, fd) != 1) {
+        std::cerr << "Failed to set up TLS for " << peer << ": " << last_error() << std::endl;
+        SSL_free(ssl);
+        close(fd);
+        return -1;
+    }
+    set_nonblocking(fd, true);
+    std::string error = handshake(ssl, fd, Clock::now() + std::chrono::seconds(config::TLS_HANDSHAKE_TIMEOUT));
+    if(!error.empty()) {
+        std::cerr << "TLS handshake with " << peer << " failed: " << error << std::endl;
+        SSL_free(ssl);
+        close(fd);
+        return -1;
+    }
+
+    // With the kernel framing records both ways, the socket carries plaintext as far as we
+    // are concerned, and file bodies are encrypted on their way out without a user copy.
+    // Reads then fail with EIO on any record that is not application data, and nothing
+    // above the socket can answer one, so this is only for TLS 1.2 with renegotiation
+    // off: its peers send nothing else but a closing alert. TLS 1.3 peers may send a
+    // KeyUpdate at any time, which only OpenSSL can follow, so those stay relayed.
+    bool kernel = false;
+#ifndef OPENSSL_NO_KTLS
+    kernel = SSL_version(ssl) == TLS1_2_VERSION && BIO_get_ktls_send(SSL_get_wbio(ssl))
+          && BIO_get_ktls_recv(SSL_get_rbio(ssl)) && !SSL_has_pending(ssl);
+#endif
+    if(kernel) {
+        SSL_free(ssl);
+        set_nonblocking(fd, false);
+        return fd;
+    }
+
+    int pair[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) < 0) {
+        std::cerr << "Failed to relay TLS for " << peer << ": " << strerror(errno) << std::endl;
+        SSL_free(ssl);
+        close(fd);
+        return -1;
+    }
+    std::thread(relay, ssl, fd, pair[1]).detach();
+    return pair[0];
+}
+
+void http_server::tls::Context::close_notify(int fd) const {
+    // The session is gone by now; the kernel encrypts the alert like any other record
+    char ulp[16] = {};
+    socklen_t length = sizeof(ulp);
+    if(getsockopt(fd, SOL_TCP, TCP_ULP, ulp, &length) < 0 || strcmp(ulp, "tls") != 0) {
+        return;
+    }
+    unsigned char alert[2] = {1, 0};    // warning, close_notify
+    iovec iov{alert, sizeof(alert)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(unsigned char))];
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_TLS;
+    header->cmsg_type = TLS_SET_RECORD_TYPE;
+    header->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+    *CMSG_DATA(header) = 21;            // alert record
+    sendmsg(fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+#else
+
+http_server::tls::Context::Context(const ServerOptions &) {
+    throw std::runtime_error("TLS support was not compiled in");
+}
+
+http_server::tls::Context::~Context() {}
+
+int http_server::tls::Context::accept(int fd, const std::string &) {
+    close(fd);
+    return -1;
+}
+
+void http_server::tls::Context::close_notify(int) const {}
+
+#endif
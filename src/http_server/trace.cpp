@@ -0,0 +1,238 @@
+#include <http_server/trace.hpp>
+#include <http_server/config.hpp>
+#include <algorithm>    // std::min
+#include <cerrno>       // errno
+#include <csignal>      // sigaction()
+#include <cstdio>       // snprintf()
+#include <cstring>      // strerror()
+#include <ctime>        // clock_gettime()
+#include <fcntl.h>      // O_CLOEXEC, O_NONBLOCK
+#include <fstream>      // std::ofstream
+#include <iostream>     // std::cout, std::cerr
+#include <memory>       // std::unique_ptr
+#include <mutex>        // std::mutex
+#include <stdexcept>    // std::runtime_error
+#include <thread>       // std::thread
+#include <unistd.h>     // getpid(), gettid(), pipe2()
+#include <vector>       // std::vector
+
+namespace http_server::trace {
+    namespace detail {
+        std::atomic<uint32_t> sample_every{0};
+        thread_local uint64_t current_request = 0;
+    }
+
+    namespace {
+        struct Event {
+            const char *name;
+            uint64_t start_ns;
+            uint64_t duration_ns;
+            uint64_t request;
+            uint32_t tid;
+            char label[44];     // request events only, truncated
+        };
+
+        // The most recent spans of every thread, oldest overwritten first
+        struct Ring {
+            std::mutex mutex;
+            std::unique_ptr<Event[]> events;   // allocated by the first request traced
+            uint64_t head = 0;                  // events ever added
+
+            void add(const Event *batch, size_t count) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!events) {
+                    events = std::make_unique<Event[]>(config::TRACE_RING_EVENTS);
+                }
+                for (size_t i = 0; i < count; ++i) {
+                    events[head++ % config::TRACE_RING_EVENTS] = batch[i];
+                }
+            }
+        };
+
+        Ring &ring() {
+            // Never destroyed: threads may still be finishing requests during exit
+            static Ring *instance = new Ring();
+            return *instance;
+        }
+
+        // Spans of the request this thread is serving, added to the ring in one go when
+        // it ends (or when the batch fills) so threads rarely meet on the ring's lock
+        struct ThreadBatch {
+            Event events[config::TRACE_THREAD_EVENTS];
+            size_t count = 0;
+            uint32_t tid = 0;
+
+            void flush() {
+                ring().add(events, count);
+                count = 0;
+            }
+        };
+
+        thread_local ThreadBatch thread_batch;
+        std::atomic<uint64_t> request_counter{0};
+
+        void append_escaped(std::string &out, std::string_view text) {
+            for (char c : text) {
+                if (c == '"' || c == '\\') {
+                    out += '\\';
+                    out += c;
+                } else if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += c;
+                }
+            }
+        }
+
+        int signal_pipe[2] = {-1, -1};
+
+        void on_signal(int) {
+            int saved_errno = errno;
+            char byte = 1;
+            ssize_t ignored = write(signal_pipe[1], &byte, 1);
+            (void)ignored;
+            errno = saved_errno;
+        }
+    }
+
+    void set_sampling(uint32_t every) {
+        detail::sample_every.store(every, std::memory_order_relaxed);
+    }
+
+    uint64_t now_ns() {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+    }
+
+    uint64_t detail::begin_request(uint32_t every) {
+        uint64_t sequence = request_counter.fetch_add(1, std::memory_order_relaxed);
+        if (sequence % every != 0) {
+            return 0;
+        }
+        current_request = sequence + 1;
+        return current_request;
+    }
+
+    void detail::record(const char *name, uint64_t start_ns, uint64_t end_ns, std::string_view label) {
+        ThreadBatch &batch = thread_batch;
+        if (batch.count == config::TRACE_THREAD_EVENTS) {
+            batch.flush();
+        }
+        if (batch.tid == 0) {
+            batch.tid = static_cast<uint32_t>(gettid());
+        }
+        Event &event = batch.events[batch.count++];
+        event.name = name;
+        event.start_ns = start_ns;
+        event.duration_ns = end_ns - start_ns;
+        event.request = current_request;
+        event.tid = batch.tid;
+        size_t length = std::min(label.size(), sizeof(event.label) - 1);
+        label.copy(event.label, length);
+        event.label[length] = '\0';
+    }
+
+    void Request::cancel() {
+        if (id != 0) {
+            id = 0;
+            detail::current_request = 0;
+            // Spans of a full batch may already be in the ring; the rest are dropped
+            thread_batch.count = 0;
+        }
+    }
+
+    Request::~Request() {
+        if (id != 0) {
+            detail::record("request", start, now_ns(), label);
+            detail::current_request = 0;
+            thread_batch.flush();
+        }
+    }
+
+    std::string dump_json() {
+        std::vector<Event> events;
+        {
+            Ring &shared = ring();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            uint64_t begin = shared.head > config::TRACE_RING_EVENTS ? shared.head - config::TRACE_RING_EVENTS : 0;
+            for (uint64_t i = begin; i < shared.head; ++i) {
+                events.push_back(shared.events[i % config::TRACE_RING_EVENTS]);
+            }
+        }
+
+        std::string pid = std::to_string(getpid());
+        std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        out += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"args\":{\"name\":\"http_server\"}}";
+        char numbers[96];
+        for (const Event &event : events) {
+            out += ",{\"name\":\"";
+            append_escaped(out, event.name);
+            out += "\",\"cat\":\"http\",\"ph\":\"X\",\"pid\":" + pid;
+            // Trace-event timestamps are microseconds
+            snprintf(numbers, sizeof(numbers), ",\"tid\":%u,\"ts\":%llu.%03llu,\"dur\":%llu.%03llu",
+                     event.tid,
+                     static_cast<unsigned long long>(event.start_ns / 1000), static_cast<unsigned long long>(event.start_ns % 1000),
+                     static_cast<unsigned long long>(event.duration_ns / 1000), static_cast<unsigned long long>(event.duration_ns % 1000));
+            out += numbers;
+            out += ",\"args\":{\"request\":" + std::to_string(event.request);
+            if (event.label[0] != '\0') {
+                out += ",\"label\":\"";
+                append_escaped(out, event.label);
+                out += '"';
+            }
+            out += "}}";
+        }
+        out += "]}\n";
+        return out;
+    }
+
+    bool dump_to_file(const std::string &path) {
+        std::string json = dump_json();
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(json.data(), json.size());
+        file.close();
+        return static_cast<bool>(file);
+    }
+
+    void dump_on_signal(int signal, const std::string &path_prefix) {
+        if (signal_pipe[0] >= 0) {
+            throw std::logic_error("Trace dump signal already installed");
+        }
+        if (pipe2(signal_pipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+            throw std::runtime_error("Failed to create trace signal pipe: " + std::string(strerror(errno)));
+        }
+        // Only the write end must not block inside the handler
+        fcntl(signal_pipe[0], F_SETFL, 0);
+
+        std::thread([path_prefix, read_fd = signal_pipe[0]] {
+            int dumps = 0;
+            char byte;
+            while (true) {
+                ssize_t n = read(read_fd, &byte, 1);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    return;
+                }
+                std::string path = path_prefix + "." + std::to_string(getpid()) + "." + std::to_string(++dumps) + ".json";
+                if (dump_to_file(path)) {
+                    std::cout << "Wrote trace to " << path << std::endl;
+                } else {
+                    std::cerr << "Failed to write trace to " << path << std::endl;
+                }
+            }
+        }).detach();
+
+        struct sigaction action{};
+        action.sa_handler = on_signal;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        if (sigaction(signal, &action, nullptr) < 0) {
+            throw std::runtime_error("Failed to install trace signal handler: " + std::string(strerror(errno)));
+        }
+    }
+}
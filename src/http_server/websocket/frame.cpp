@@ -0,0 +1,170 @@
+#include <http_server/websocket/frame.hpp>
+#include <cstring>          // std::memcpy
+#if defined(__SSE2__)
+#include <emmintrin.h>      // _mm_xor_si128
+#endif
+
+namespace http_server::websocket {
+    std::optional<FrameHeader> parse_frame_header(std::string_view data) {
+        if (data.size() < 2) {
+            return std::nullopt;
+        }
+        uint8_t first = static_cast<uint8_t>(data[0]);
+        uint8_t second = static_cast<uint8_t>(data[1]);
+
+        FrameHeader header{};
+        header.fin = (first & 0x80) != 0;
+        header.opcode = static_cast<Opcode>(first & 0x0F);
+        header.masked = (second & 0x80) != 0;
+        // No extensions are negotiated, so the reserved bits must be clear
+        if (first & 0x70) {
+            throw ProtocolError(CloseCode::PROTOCOL_ERROR, "Reserved bits set");
+        }
+        switch (header.opcode) {
+        case Opcode::CONTINUATION:
+        case Opcode::TEXT:
+        case Opcode::BINARY:
+        case Opcode::CLOSE:
+        case Opcode::PING:
+        case Opcode::PONG:
+            break;
+        default:
+            throw ProtocolError(CloseCode::PROTOCOL_ERROR, "Unknown opcode " + std::to_string(first & 0x0F));
+        }
+
+        size_t length_bytes = 0;
+        header.payload_length = second & 0x7F;
+        if (header.payload_length == 126) {
+            length_bytes = 2;
+        } else if (header.payload_length == 127) {
+            length_bytes = 8;
+        }
+        header.header_length = 2 + length_bytes + (header.masked ? 4 : 0);
+        if (data.size() < header.header_length) {
+            return std::nullopt;
+        }
+        if (length_bytes > 0) {
+            header.payload_length = 0;
+            for (size_t i = 0; i < length_bytes; ++i) {
+                header.payload_length = (header.payload_length << 8) | static_cast<uint8_t>(data[2 + i]);
+            }
+            if (header.payload_length >> 63) {
+                throw ProtocolError(CloseCode::PROTOCOL_ERROR, "Payload length has the high bit set");
+            }
+        }
+        if (header.masked) {
+            std::memcpy(header.mask, data.data() + 2 + length_bytes, 4);
+        }
+
+        if (is_control(header.opcode) && (!header.fin || header.payload_length > 125)) {
+            throw ProtocolError(CloseCode::PROTOCOL_ERROR, "Fragmented or oversized control frame");
+        }
+        return header;
+    }
+
+    void append_frame(std::string &out, Opcode opcode, std::string_view payload, bool fin) {
+        out += static_cast<char>((fin ? 0x80 : 0x00) | static_cast<uint8_t>(opcode));
+        uint64_t length = payload.size();
+        if (length < 126) {
+            out += static_cast<char>(length);
+        } else if (length <= 0xFFFF) {
+            out += static_cast<char>(126);
+            out += static_cast<char>(length >> 8);
+            out += static_cast<char>(length & 0xFF);
+        } else {
+            out += static_cast<char>(127);
+            for (int shift = 56; shift >= 0; shift -= 8) {
+                out += static_cast<char>((length >> shift) & 0xFF);
+            }
+        }
+        out.append(payload);
+    }
+
+    void apply_mask(char *data, size_t length, const uint8_t mask[4], size_t offset) {
+        // The mask rotated so that data[0] lines up with mask[offset % 4], repeated
+        uint8_t pattern[16];
+        for (size_t i = 0; i < sizeof(pattern); ++i) {
+            pattern[i] = mask[(offset + i) % 4];
+        }
+
+        size_t i = 0;
+#if defined(__SSE2__)
+        __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pattern));
+        for (; i + 64 <= length; i += 64) {
+            __m128i *block = reinterpret_cast<__m128i *>(data + i);
+            _mm_storeu_si128(block, _mm_xor_si128(_mm_loadu_si128(block), key));
+            _mm_storeu_si128(block + 1, _mm_xor_si128(_mm_loadu_si128(block + 1), key));
+            _mm_storeu_si128(block + 2, _mm_xor_si128(_mm_loadu_si128(block + 2), key));
+            _mm_storeu_si128(block + 3, _mm_xor_si128(_mm_loadu_si128(block + 3), key));
+        }
+        for (; i + 16 <= length; i += 16) {
+            __m128i *block = reinterpret_cast<__m128i *>(data + i);
+            _mm_storeu_si128(block, _mm_xor_si128(_mm_loadu_si128(block), key));
+        }
+#endif
+        // Eight bytes at a time; the pattern repeats every four, so any 8-byte window of it works
+        uint64_t key64;
+        std::memcpy(&key64, pattern, sizeof(key64));
+        for (; i + 8 <= length; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            word ^= key64;
+            std::memcpy(data + i, &word, sizeof(word));
+        }
+        for (; i < length; ++i) {
+            data[i] = static_cast<char>(data[i] ^ pattern[i % 4]);
+        }
+    }
+
+    bool is_valid_utf8(std::string_view text) {
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(text.data());
+        size_t length = text.size();
+        size_t i = 0;
+        while (i < length) {
+            // ASCII runs are the common case
+            if (i + 8 <= length) {
+                uint64_t word;
+                std::memcpy(&word, bytes + i, sizeof(word));
+                if ((word & 0x8080808080808080ull) == 0) {
+                    i += 8;
+                    continue;
+                }
+            }
+            uint8_t lead = bytes[i];
+            if (lead < 0x80) {
+                ++i;
+                continue;
+            }
+            size_t extra;
+            uint32_t code_point;
+            if (lead >= 0xC2 && lead <= 0xDF) {
+                extra = 1;
+                code_point = lead & 0x1F;
+            } else if (lead >= 0xE0 && lead <= 0xEF) {
+                extra = 2;
+                code_point = lead & 0x0F;
+            } else if (lead >= 0xF0 && lead <= 0xF4) {
+                extra = 3;
+                code_point = lead & 0x07;
+            } else {
+                return false;
+            }
+            if (extra >= length - i) {
+                return false;   // truncated sequence
+            }
+            for (size_t j = 1; j <= extra; ++j) {
+                if ((bytes[i + j] & 0xC0) != 0x80) {
+                    return false;
+                }
+                code_point = (code_point << 6) | (bytes[i + j] & 0x3F);
+            }
+            // Overlong forms, surrogates and values past U+10FFFF
+            if ((extra == 2 && code_point < 0x800) || (extra == 3 && (code_point < 0x10000 || code_point > 0x10FFFF)) ||
+                (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+                return false;
+            }
+            i += extra + 1;
+        }
+        return true;
+    }
+}
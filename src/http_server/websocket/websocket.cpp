@@ -0,0 +1,393 @@
+#include <http_server/websocket/websocket.hpp>
+#include <http_server/async/event_loop.hpp>
+#include <http_server/async/io.hpp>
+#include <http_server/config.hpp>
+#include <http_server/status.hpp>
+#include <utils/base64.hpp>
+#include <utils/buffer_pool.hpp>
+#include <utils/sha1.hpp>
+#include <iostream>         // std::cerr
+#include <sys/socket.h>     // shutdown()
+#include <unistd.h>         // close()
+#include <utility>          // std::exchange
+
+namespace http_server::websocket {
+    namespace {
+        constexpr char HANDSHAKE_GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+        // Comma separated header value containing 'token', ignoring case
+        bool has_token(const std::string *value, std::string_view token) {
+            if (value == nullptr) {
+                return false;
+            }
+            std::string_view rest = *value;
+            while (!rest.empty()) {
+                size_t comma = rest.find(',');
+                std::string_view item = rest.substr(0, comma);
+                while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) {
+                    item.remove_prefix(1);
+                }
+                while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) {
+                    item.remove_suffix(1);
+                }
+                if (iequals(item, token)) {
+                    return true;
+                }
+                rest = (comma == std::string_view::npos) ? std::string_view() : rest.substr(comma + 1);
+            }
+            return false;
+        }
+
+        // Close codes an endpoint may put on the wire (RFC 6455 section 7.4)
+        bool is_sendable_close_code(uint16_t code) {
+            return (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1011) || (code >= 3000 && code <= 4999);
+        }
+
+        async::Task<void> run_session(std::shared_ptr<WebSocket> socket, Handler handler, HTTP_Request request, Params params) {
+            try {
+                co_await handler(socket, request, params);
+            } catch (const std::exception &e) {
+                std::cerr << "WebSocket handler for " << socket->remote_address() << " failed: " << e.what() << std::endl;
+                socket->close(CloseCode::INTERNAL_ERROR);
+            }
+            co_await socket->finish();
+        }
+    }
+
+    // Resumes once nothing is queued or being written
+    struct WebSocket::DrainAwaiter {
+        WebSocket &socket;
+
+        bool await_ready() const {
+            std::lock_guard<std::mutex> lock(socket.mutex);
+            return !socket.flushing;
+        }
+        bool await_suspend(std::coroutine_handle<> handle) {
+            std::lock_guard<std::mutex> lock(socket.mutex);
+            if (!socket.flushing) {
+                return false;
+            }
+            socket.drain_waiter = handle;
+            return true;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    WebSocket::WebSocket(int fd, std::string buffered, std::string remote_address)
+        : fd(fd), peer(std::move(remote_address)), in(std::move(buffered)) {}
+
+    WebSocket::~WebSocket() {
+        ::close(fd);
+    }
+
+    bool WebSocket::is_open() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return !close_sent && !close_received && !failed;
+    }
+
+    size_t WebSocket::buffered_amount() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return outbox.size() + in_flight;
+    }
+
+    CloseCode WebSocket::close_code() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return peer_close_code;
+    }
+
+    bool WebSocket::send_text(std::string_view text) {
+        return queue(Opcode::TEXT, text);
+    }
+
+    bool WebSocket::send_binary(std::string_view data) {
+        return queue(Opcode::BINARY, data);
+    }
+
+    bool WebSocket::ping(std::string_view payload) {
+        return queue(Opcode::PING, payload.substr(0, 125));
+    }
+
+    void WebSocket::close(CloseCode code, std::string_view reason) {
+        std::string payload;
+        payload += static_cast<char>(static_cast<uint16_t>(code) >> 8);
+        payload += static_cast<char>(static_cast<uint16_t>(code) & 0xFF);
+        payload.append(reason.substr(0, 123));
+        queue(Opcode::CLOSE, payload, true);
+    }
+
+    bool WebSocket::queue(Opcode opcode, std::string_view payload, bool closing) {
+        bool start = false;
+        bool overflow = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (close_sent || failed) {
+                return false;
+            }
+            if (outbox.size() + in_flight + payload.size() > config::WEBSOCKET_MAX_BUFFERED) {
+                failed = overflow = true;
+            } else {
+                append_frame(outbox, opcode, payload);
+                close_sent = closing;
+                start = !flushing;
+                flushing = true;
+            }
+        }
+        if (overflow) {
+            // Too far behind to catch up: wake the reader and the writer so both give up
+            std::cerr << "WebSocket peer " << peer << " is not reading; disconnecting" << std::endl;
+            ::shutdown(fd, SHUT_RDWR);
+            return false;
+        }
+        if (start) {
+            async::spawn(flush(shared_from_this()));
+        }
+        return true;
+    }
+
+    async::Task<void> WebSocket::flush(std::shared_ptr<WebSocket> self) {
+        std::coroutine_handle<> waiter;
+        while (true) {
+            std::string batch;
+            {
+                std::lock_guard<std::mutex> lock(self->mutex);
+                if (self->outbox.empty() || self->failed) {
+                    self->outbox.clear();
+                    self->in_flight = 0;
+                    self->flushing = false;
+                    waiter = std::exchange(self->drain_waiter, {});
+                    break;
+                }
+                // Everything queued so far goes out in one write
+                batch.swap(self->outbox);
+                self->in_flight = batch.size();
+            }
+            bool sent = true;
+            try {
+                co_await async::send_all(self->fd, batch, std::chrono::seconds(config::WEBSOCKET_SEND_TIMEOUT));
+            } catch (const std::exception &) {
+                sent = false;
+            }
+            if (!sent) {
+                std::lock_guard<std::mutex> lock(self->mutex);
+                self->failed = true;
+                ::shutdown(self->fd, SHUT_RDWR);
+            }
+        }
+        if (waiter) {
+            async::EventLoop::instance().schedule(waiter);
+        }
+    }
+
+    void WebSocket::fail(CloseCode code, const std::string &reason) {
+        std::cerr << "Closing WebSocket from " << peer << ": " << reason << std::endl;
+        close(code);
+        std::lock_guard<std::mutex> lock(mutex);
+        close_received = true;     // nothing more is read from a peer that broke the protocol
+    }
+
+    async::Task<std::optional<Message>> WebSocket::receive(std::chrono::milliseconds timeout) {
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (close_received || failed) {
+                    co_return std::nullopt;
+                }
+            }
+
+            std::optional<FrameHeader> header;
+            try {
+                header = parse_frame_header(in);
+            } catch (const ProtocolError &e) {
+                fail(e.code, e.what());
+                co_return std::nullopt;
+            }
+            if (header && header->payload_length > config::WEBSOCKET_MAX_MESSAGE) {
+                fail(CloseCode::MESSAGE_TOO_BIG, "Frame of " + std::to_string(header->payload_length) + " bytes");
+                co_return std::nullopt;
+            }
+
+            if (!header || in.size() - header->header_length < header->payload_length) {
+                // Borrow a read buffer only for the read itself, as HTTP connections do
+                buffer_pool::Buffer buffer = buffer_pool::acquire(config::READ_BUFFER_SIZE);
+                size_t received = 0;
+                bool dropped = false;
+                try {
+                    received = co_await async::recv_some(fd, buffer.data(), buffer.size(), timeout);
+                } catch (const async::TimeoutError &) {
+                    throw;
+                } catch (const std::exception &) {
+                    dropped = true;
+                }
+                if (dropped || received == 0) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    failed = true;
+                    co_return std::nullopt;
+                }
+                in.append(buffer.data(), received);
+                continue;
+            }
+
+            if (!header->masked) {
+                fail(CloseCode::PROTOCOL_ERROR, "Unmasked client frame");
+                co_return std::nullopt;
+            }
+            char *payload = in.data() + header->header_length;
+            size_t length = static_cast<size_t>(header->payload_length);
+            apply_mask(payload, length, header->mask);
+            std::string_view data(payload, length);
+
+            std::optional<Message> message;
+            switch (header->opcode) {
+            case Opcode::PING:
+                queue(Opcode::PONG, data);
+                break;
+            case Opcode::PONG:
+                break;
+            case Opcode::CLOSE: {
+                CloseCode code = CloseCode::NO_STATUS;
+                if (length == 1) {
+                    fail(CloseCode::PROTOCOL_ERROR, "Truncated close frame");
+                    co_return std::nullopt;
+                }
+                if (length >= 2) {
+                    uint16_t value = static_cast<uint16_t>((static_cast<uint8_t>(data[0]) << 8) | static_cast<uint8_t>(data[1]));
+                    if (!is_sendable_close_code(value)) {
+                        fail(CloseCode::PROTOCOL_ERROR, "Invalid close code " + std::to_string(value));
+                        co_return std::nullopt;
+                    }
+                    if (!is_valid_utf8(data.substr(2))) {
+                        fail(CloseCode::INVALID_DATA, "Close reason is not UTF-8");
+                        co_return std::nullopt;
+                    }
+                    code = static_cast<CloseCode>(value);
+                }
+                // Echo the close unless we started the handshake
+                close(code == CloseCode::NO_STATUS ? CloseCode::NORMAL : code);
+                std::lock_guard<std::mutex> lock(mutex);
+                close_received = true;
+                peer_close_code = code;
+                co_return std::nullopt;
+            }
+            case Opcode::TEXT:
+            case Opcode::BINARY:
+                if (fragment_opcode) {
+                    fail(CloseCode::PROTOCOL_ERROR, "New message before the previous one finished");
+                    co_return std::nullopt;
+                }
+                if (header->fin) {
+                    message = Message{header->opcode, std::string(data)};
+                } else {
+                    fragment_opcode = header->opcode;
+                    fragments.assign(data);
+                }
+                break;
+            case Opcode::CONTINUATION:
+                if (!fragment_opcode) {
+                    fail(CloseCode::PROTOCOL_ERROR, "Continuation without a message");
+                    co_return std::nullopt;
+                }
+                if (fragments.size() + length > config::WEBSOCKET_MAX_MESSAGE) {
+                    fail(CloseCode::MESSAGE_TOO_BIG, "Message over " + std::to_string(config::WEBSOCKET_MAX_MESSAGE) + " bytes");
+                    co_return std::nullopt;
+                }
+                fragments.append(data);
+                if (header->fin) {
+                    message = Message{*fragment_opcode, std::move(fragments)};
+                    fragment_opcode.reset();
+                    fragments.clear();
+                }
+                break;
+            }
+
+            in.erase(0, header->header_length + length);
+            if (in.empty()) {
+                std::string().swap(in);
+            }
+            if (message) {
+                if (message->is_text() && !is_valid_utf8(message->data)) {
+                    fail(CloseCode::INVALID_DATA, "Text message is not UTF-8");
+                    co_return std::nullopt;
+                }
+                co_return message;
+            }
+        }
+    }
+
+    async::Task<void> WebSocket::finish() {
+        close(CloseCode::NORMAL);
+        // Give the peer a moment to answer our close; anything else it sends is dropped
+        try {
+            while (co_await receive(std::chrono::seconds(config::WEBSOCKET_CLOSE_TIMEOUT))) {}
+        } catch (const std::exception &) {}
+        co_await DrainAwaiter{*this};
+        std::lock_guard<std::mutex> lock(mutex);
+        failed = true;
+        ::shutdown(fd, SHUT_RDWR);
+    }
+
+    Handler from_callbacks(Callbacks callbacks) {
+        return [callbacks = std::move(callbacks)](std::shared_ptr<WebSocket> socket, const HTTP_Request &, const Params &) -> async::Task<void> {
+            if (callbacks.on_open) {
+                callbacks.on_open(socket);
+            }
+            while (auto message = co_await socket->receive()) {
+                if (callbacks.on_message) {
+                    callbacks.on_message(socket, std::move(*message));
+                }
+            }
+            if (callbacks.on_close) {
+                callbacks.on_close(socket, socket->close_code());
+            }
+        };
+    }
+
+    std::string accept_key(std::string_view key) {
+        sha1::Digest digest = sha1::digest(std::string(key) + HANDSHAKE_GUID);
+        return base64::encode(std::string_view(reinterpret_cast<const char *>(digest.data()), digest.size()));
+    }
+
+    http_server::Handler upgrade(Handler handler) {
+        return [handler = std::move(handler)](const HTTP_Request &request, const Params &params) -> HTTP_Response {
+            if (request.version != "HTTP/1.1" || !has_token(request.headers.get(HTTP_HEADER::UPGRADE), "websocket") ||
+                !has_token(request.headers.get(HTTP_HEADER::CONNECTION), "upgrade")) {
+                return HTTP_Response {
+                    (int)HTTP_STATUS_CODE::UPGRADE_REQUIRED,
+                    "Upgrade Required",
+                    {{"Upgrade", "websocket"}},
+                    "This resource is only available over WebSocket"
+                };
+            }
+            const std::string *version = request.headers.get("Sec-WebSocket-Version");
+            if (version == nullptr || *version != "13") {
+                return HTTP_Response {
+                    (int)HTTP_STATUS_CODE::UPGRADE_REQUIRED,
+                    "Upgrade Required",
+                    {{"Sec-WebSocket-Version", "13"}},
+                    "Unsupported WebSocket version"
+                };
+            }
+            const std::string *key = request.headers.get("Sec-WebSocket-Key");
+            auto nonce = key ? base64::decode(*key) : std::nullopt;
+            if (!nonce || nonce->size() != 16 || !request.body.empty() || request.body_stream) {
+                return HTTP_Response {
+                    (int)HTTP_STATUS_CODE::BAD_REQUEST,
+                    "Bad Request",
+                    {},
+                    "Invalid WebSocket handshake"
+                };
+            }
+
+            HTTP_Response response {
+                (int)HTTP_STATUS_CODE::SWITCHING_PROTOCOLS,
+                "Switching Protocols",
+                {{"Upgrade", "websocket"}, {"Connection", "Upgrade"}, {"Sec-WebSocket-Accept", accept_key(*key)}},
+                ""
+            };
+            response.takeover = [handler, request, params](int fd, std::string buffered) {
+                auto socket = std::make_shared<WebSocket>(fd, std::move(buffered), request.remote_address);
+                async::spawn(run_session(std::move(socket), handler, request, params));
+            };
+            return response;
+        };
+    }
+}
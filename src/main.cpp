@@ -1,37 +1,23 @@
 #include <http_server/server.hpp>
 #include <http_server/compression/registry.hpp>
 #include <http_server/compression/gzip.hpp>
+#include <http_server/proxy.hpp>
+#include <http_server/async/event_loop.hpp>
+#include <http_server/websocket/websocket.hpp>
+#include <http_server/sse.hpp>
+#include <utils/buffer_pool.hpp>
 #include <utils/file_utils.hpp>
+#include <utils/group_commit.hpp>
+#include <utils/mmap_cache.hpp>
 #include <utils/path_validation.hpp>
 #include <stdexcept>
 #include <filesystem>
 
 int main(int argc, char **argv) {
     try {
-        // Parse command line arguments with better error handling
-        uint16_t port = http_server::config::DEFAULT_PORT; // Default port
-        std::string root_path = "."; // Default directory
-        
-        for (int i = 1; i < argc; ++i) {
-            std::string arg = argv[i];
-            if (arg == "--directory" || arg == "-d") {
-                if (i + 1 < argc) {
-                    root_path = argv[++i];
-                } else {
-                    throw std::invalid_argument("--directory option requires a path argument");
-                }
-            } else if (arg.find("--port=") == 0) {
-                try {
-                    std::string port_str = arg.substr(7);
-                    port = std::stoi(port_str);
-                    if (port <= 0 || port > 65535) {
-                        throw std::out_of_range("Port must be between 1-65535");
-                    }
-                } catch (const std::exception& e) {
-                    throw std::invalid_argument("Invalid port specification: " + std::string(e.what()));
-                }
-            }
-        }
+        // Command line and --config file options
+        http_server::ServerOptions options = http_server::parse_options(argc, argv);
+        std::string root_path = options.directory;
         
         // Validate that the root directory exists
         if (!std::filesystem::exists(root_path)) {
@@ -46,8 +32,14 @@ int main(int argc, char **argv) {
         http_server::compression::CompressionRegistry::register_compressor(std::make_unique<http_server::compression::GzipCompressor>());
 
         // Create and configure the server
-        http_server::HTTP_Server server(port, root_path);
-        std::cout << "Starting HTTP server on port " << port << " with root directory: " << root_path << std::endl;
+        http_server::HTTP_Server server(options);
+        std::cout << "Starting HTTP server with root directory: " << root_path << std::endl;
+        if (options.cache_size > 0) {
+            std::cout << "Response cache enabled: " << options.cache_size << " bytes" << std::endl;
+        }
+        if (options.durable_uploads) {
+            std::cout << "Durable uploads enabled" << std::endl;
+        }
         
         // Register routes
         server.add_route("GET", "/", [&](const http_server::HTTP_Request &request, const http_server::Params &params) {
@@ -106,18 +98,40 @@ int main(int argc, char **argv) {
                     "An error occurred processing your request"
                 };
             }
-        });
+        }, http_server::CachePolicy{std::chrono::seconds(1), {}});
 
         server.add_route("GET", "/files/:name", [&](const http_server::HTTP_Request &request, const http_server::Params &params) {
             try {
                 std::string name = params.at("name");
-                if(!std::filesystem::path(name).has_filename()) {
+                if(!std::filesystem::path(name).has_filename() || http_server::file_utils::is_temporary(name)) {
                     throw std::invalid_argument("Invalid file path");
                 }
                 
                 // Use our path validation method to prevent directory traversal
                 std::string validated_path = http_server::path_validation::validate_file_path(root_path, name);
 
+                // Larger files are sent straight from a shared mapping instead of a per-request copy
+                std::error_code size_error;
+                auto size = std::filesystem::file_size(validated_path, size_error);
+                if(!size_error && size >= http_server::config::MMAP_MIN_FILE_SIZE) {
+                    if(auto mapped = http_server::file_utils::MmapCache::instance().get(validated_path)) {
+                        return http_server::HTTP_Response {
+                            (int)http_server::HTTP_STATUS_CODE::OK,
+                            "OK",
+                            {{
+                                "Content-Type", "application/octet-stream"
+                            },
+                            {
+                                "Content-Length", std::to_string(mapped->size())
+                            }},
+                            "",
+                            [mapped](const http_server::BodySink &sink) {
+                                return sink(mapped->data(), mapped->size());
+                            }
+                        };
+                    }
+                }
+
                 if(auto content = http_server::file_utils::read_file(validated_path)) {
                     return http_server::HTTP_Response {
                         (int)http_server::HTTP_STATUS_CODE::OK,
@@ -165,19 +179,57 @@ int main(int argc, char **argv) {
             };
         });
 
+        // Refuse uploads outside the root before any of the body is sent
+        server.add_head_check([&](const http_server::HTTP_Request &request) -> std::optional<http_server::HTTP_Response> {
+            if(request.method != "POST" || request.path.rfind("/files/", 0) != 0) {
+                return std::nullopt;
+            }
+            if(http_server::file_utils::is_temporary(request.path.substr(7))) {
+                return http_server::HTTP_Response {
+                    (int)http_server::HTTP_STATUS_CODE::FORBIDDEN,
+                    "Forbidden",
+                    {},
+                    "Access denied: Reserved file name",
+                };
+            }
+            try {
+                http_server::path_validation::validate_file_path(root_path, request.path.substr(7));
+            } catch(const std::runtime_error &e) {
+                if(std::string(e.what()).find("traversal") != std::string::npos) {
+                    return http_server::HTTP_Response {
+                        (int)http_server::HTTP_STATUS_CODE::FORBIDDEN,
+                        "Forbidden",
+                        {},
+                        "Access denied: Directory traversal attempt detected",
+                    };
+                }
+            }
+            return std::nullopt;
+        });
+
         server.add_route("POST", "/files/:name", [&](const http_server::HTTP_Request &request, const http_server::Params &params) {
             try {
                 std::string name = params.at("name");
-                if(!std::filesystem::path(name).has_filename()) {
+                if(!std::filesystem::path(name).has_filename() || http_server::file_utils::is_temporary(name)) {
                     throw std::invalid_argument("Invalid file path");
                 }
                 
                 // Use our path validation method to prevent directory traversal
                 std::string validated_path = http_server::path_validation::validate_file_path(root_path, name);
 
-                std::string content = request.body;
-
-                http_server::file_utils::save_file(validated_path, content);
+                // Chunked uploads go to disk as they arrive instead of being buffered first
+                if(request.body_stream) {
+                    if(!http_server::file_utils::save_file_stream(validated_path, request.body_stream, options.durable_uploads)) {
+                        return http_server::HTTP_Response {
+                            (int)http_server::HTTP_STATUS_CODE::BAD_REQUEST,
+                            "Bad Request",
+                            {},
+                            "Incomplete or malformed chunked body",
+                        };
+                    }
+                } else {
+                    http_server::file_utils::save_file(validated_path, request.body, options.durable_uploads);
+                }
                 return http_server::HTTP_Response {
                     (int)http_server::HTTP_STATUS_CODE::CREATED,
                     "Created",
@@ -220,8 +272,7 @@ int main(int argc, char **argv) {
 
         server.add_route("GET", "/user-agent", [&](const http_server::HTTP_Request &request, const http_server::Params &params) {
             try {
-                auto it = request.headers.find("User-Agent");
-                if(it != request.headers.end()) {
+                if(const std::string *user_agent = request.headers.get(http_server::HTTP_HEADER::USER_AGENT)) {
                     return http_server::HTTP_Response {
                         (int)http_server::HTTP_STATUS_CODE::OK,
                         "OK",
@@ -229,9 +280,9 @@ int main(int argc, char **argv) {
                             "Content-Type", "text/plain"
                         },
                         {
-                            "Content-Length", std::to_string(it->second.size())
+                            "Content-Length", std::to_string(user_agent->size())
                         }},
-                        it->second
+                        *user_agent
                     };
                 }
 
@@ -250,7 +301,128 @@ int main(int argc, char **argv) {
                     "An error occurred processing your request"
                 };
             }
+        }, http_server::CachePolicy{std::chrono::seconds(1), {"User-Agent"}});
+
+        // Waits on the event loop rather than blocking a thread in the handler
+        server.add_route("GET", "/sleep/:ms", [](const http_server::HTTP_Request &, const http_server::Params &params) -> http_server::async::Task<http_server::HTTP_Response> {
+            int ms = std::stoi(params.at("ms"));
+            if (ms < 0 || ms > 10000) {
+                co_return http_server::HTTP_Response {
+                    (int)http_server::HTTP_STATUS_CODE::BAD_REQUEST,
+                    "Bad Request",
+                    {},
+                    "Sleep must be between 0 and 10000 ms"
+                };
+            }
+            co_await http_server::async::sleep_for(std::chrono::milliseconds(ms));
+            co_return http_server::HTTP_Response {
+                (int)http_server::HTTP_STATUS_CODE::OK,
+                "OK",
+                {{
+                    "Content-Type", "text/plain"
+                }},
+                "Slept " + std::to_string(ms) + " ms"
+            };
+        });
+
+        // Sends every message back; the connection lives on the event loop after the upgrade
+        server.add_route("GET", "/ws/echo", http_server::websocket::upgrade(
+            [](std::shared_ptr<http_server::websocket::WebSocket> socket, const http_server::HTTP_Request &,
+               const http_server::Params &) -> http_server::async::Task<void> {
+                while (auto message = co_await socket->receive()) {
+                    if (message->is_text()) {
+                        socket->send_text(message->data);
+                    } else {
+                        socket->send_binary(message->data);
+                    }
+                }
+            }));
+
+        // Event streams: GET subscribes to a topic, POST sends its body to the topic's subscribers
+        auto events = std::make_shared<http_server::sse::Broadcaster>();
+        server.add_route("GET", "/events/:topic", events->endpoint(http_server::sse::topic_param("topic")));
+        server.add_route("POST", "/events/:topic", [events](const http_server::HTTP_Request &request, const http_server::Params &params) {
+            std::string data = request.body;
+            if (request.body_stream && !request.body_stream([&](const char *piece, size_t length) {
+                    data.append(piece, length);
+                    return data.size() <= http_server::config::SSE_MAX_QUEUED;
+                })) {
+                return http_server::HTTP_Response {
+                    (int)http_server::HTTP_STATUS_CODE::BAD_REQUEST,
+                    "Bad Request",
+                    {},
+                    "Incomplete, malformed or oversized event body"
+                };
+            }
+            size_t reached = events->publish(params.at("topic"), {data});
+            return http_server::HTTP_Response {
+                (int)http_server::HTTP_STATUS_CODE::ACCEPTED,
+                "Accepted",
+                {{
+                    "Content-Type", "text/plain"
+                }},
+                "Queued for " + std::to_string(reached) + " subscribers"
+            };
         });
+
+        // Read/write buffer gauge: bytes lent to connections now and bytes kept free for reuse
+        if (options.debug_buffers) {
+            server.add_route("GET", "/debug/buffers", [](const http_server::HTTP_Request &, const http_server::Params &) {
+                http_server::buffer_pool::Stats stats = http_server::buffer_pool::stats();
+                return http_server::HTTP_Response {
+                    (int)http_server::HTTP_STATUS_CODE::OK,
+                    "OK",
+                    {{
+                        "Content-Type", "application/json"
+                    }},
+                    "{\"in_use_bytes\": " + std::to_string(stats.in_use_bytes) +
+                    ", \"pooled_bytes\": " + std::to_string(stats.pooled_bytes) +
+                    ", \"allocations\": " + std::to_string(stats.allocations) +
+                    ", \"reuses\": " + std::to_string(stats.reuses) + "}\n"
+                };
+            });
+        }
+
+        // Group commit counters: uploads made durable, the fsync batches they shared and directory syncs
+        if (options.durable_uploads) {
+            server.add_route("GET", "/debug/uploads", [](const http_server::HTTP_Request &, const http_server::Params &) {
+                http_server::file_utils::GroupCommitter::Stats stats = http_server::file_utils::GroupCommitter::instance().stats();
+                return http_server::HTTP_Response {
+                    (int)http_server::HTTP_STATUS_CODE::OK,
+                    "OK",
+                    {{
+                        "Content-Type", "application/json"
+                    }},
+                    "{\"commits\": " + std::to_string(stats.commits) +
+                    ", \"batches\": " + std::to_string(stats.batches) +
+                    ", \"directory_syncs\": " + std::to_string(stats.directory_syncs) + "}\n"
+                };
+            });
+        }
+
+        // Reverse-proxied prefixes; the upstream sees the path below the prefix
+        for (const auto &spec : options.proxies) {
+            size_t eq = spec.find('=');
+            if (eq == std::string::npos || spec.empty() || spec[0] != '/') {
+                throw std::invalid_argument("Invalid proxy specification: " + spec);
+            }
+            std::string prefix = spec.substr(0, eq);
+            while (!prefix.empty() && prefix.back() == '/') {
+                prefix.pop_back();
+            }
+            std::string upstreams = spec.substr(eq + 1);
+            http_server::proxy::ProxyOptions proxy_options;
+            proxy_options.upstreams = http_server::proxy::parse_upstreams(upstreams);
+            proxy_options.path_param = "path";
+            http_server::Handler proxy_handler = http_server::proxy::make_proxy_handler(proxy_options);
+            for (const char *method : {"GET", "HEAD", "POST", "PUT", "PATCH", "DELETE", "OPTIONS"}) {
+                server.add_route(method, prefix + "/*path", proxy_handler);
+            }
+            // Uploads are relayed as they arrive instead of being buffered first
+            server.stream_request_bodies(prefix);
+            std::cout << "Proxying " << prefix << "/ to " << upstreams << std::endl;
+        }
+
         // Run the server
         server.run();
     } catch(const std::exception &e) {
@@ -0,0 +1,74 @@
+#include <utils/base64.hpp>
+#include <cstdint>  // uint32_t
+
+namespace http_server::base64 {
+    namespace {
+        constexpr char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        int value_of(char c) {
+            if (c >= 'A' && c <= 'Z') return c - 'A';
+            if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+            if (c >= '0' && c <= '9') return c - '0' + 52;
+            if (c == '+') return 62;
+            if (c == '/') return 63;
+            return -1;
+        }
+    }
+
+    std::string encode(std::string_view data) {
+        std::string out;
+        out.reserve((data.size() + 2) / 3 * 4);
+        size_t i = 0;
+        for (; i + 3 <= data.size(); i += 3) {
+            uint32_t group = (uint32_t(uint8_t(data[i])) << 16) | (uint32_t(uint8_t(data[i + 1])) << 8) | uint8_t(data[i + 2]);
+            out += ALPHABET[(group >> 18) & 63];
+            out += ALPHABET[(group >> 12) & 63];
+            out += ALPHABET[(group >> 6) & 63];
+            out += ALPHABET[group & 63];
+        }
+        size_t left = data.size() - i;
+        if (left > 0) {
+            uint32_t group = uint32_t(uint8_t(data[i])) << 16;
+            if (left == 2) {
+                group |= uint32_t(uint8_t(data[i + 1])) << 8;
+            }
+            out += ALPHABET[(group >> 18) & 63];
+            out += ALPHABET[(group >> 12) & 63];
+            out += left == 2 ? ALPHABET[(group >> 6) & 63] : '=';
+            out += '=';
+        }
+        return out;
+    }
+
+    std::optional<std::string> decode(std::string_view text) {
+        if (text.size() % 4 != 0) {
+            return std::nullopt;
+        }
+        std::string out;
+        out.reserve(text.size() / 4 * 3);
+        for (size_t i = 0; i < text.size(); i += 4) {
+            bool last = (i + 4 == text.size());
+            int padding = 0;
+            uint32_t group = 0;
+            for (size_t j = 0; j < 4; ++j) {
+                char c = text[i + j];
+                int value;
+                if (c == '=' && last && j >= 2 && (j == 3 || text[i + 3] == '=')) {
+                    value = 0;
+                    ++padding;
+                } else if ((value = value_of(c)) < 0 || padding > 0) {
+                    return std::nullopt;
+                }
+                group = (group << 6) | static_cast<uint32_t>(value);
+            }
+            out += static_cast<char>(group >> 16);
+            if (padding < 2) {
+                out += static_cast<char>((group >> 8) & 0xFF);
+            }
+            if (padding < 1) {
+                out += static_cast<char>(group & 0xFF);
+            }
+        }
+        return out;
+    }
+}
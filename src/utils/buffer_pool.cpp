@@ -0,0 +1,135 @@
+#include <utils/buffer_pool.hpp>
+#include <http_server/config.hpp>
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace http_server::buffer_pool {
+    namespace {
+        std::atomic<size_t> in_use_bytes{0};
+        std::atomic<size_t> pooled_bytes{0};
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> reuses{0};
+
+        struct SharedLists {
+            std::mutex mutex;
+            std::vector<char *> free[CLASS_COUNT];
+        };
+
+        SharedLists &shared() {
+            // Never destroyed: thread caches flush into it during thread exit
+            static SharedLists *lists = new SharedLists();
+            return *lists;
+        }
+
+        void give_back(char *bytes, uint8_t size_class) {
+            size_t size = SIZE_CLASSES[size_class];
+            SharedLists &lists = shared();
+            {
+                std::lock_guard<std::mutex> lock(lists.mutex);
+                if (pooled_bytes.load() + size <= config::BUFFER_POOL_MAX_BYTES) {
+                    lists.free[size_class].push_back(bytes);
+                    pooled_bytes += size;
+                    return;
+                }
+            }
+            delete[] bytes;
+        }
+
+        struct ThreadCache {
+            std::vector<char *> free[CLASS_COUNT];
+            bool empty = true;
+
+            void flush() {
+                for (size_t size_class = 0; size_class < CLASS_COUNT; ++size_class) {
+                    for (char *bytes : free[size_class]) {
+                        pooled_bytes -= SIZE_CLASSES[size_class];
+                        give_back(bytes, static_cast<uint8_t>(size_class));
+                    }
+                    free[size_class].clear();
+                }
+                empty = true;
+            }
+
+            ~ThreadCache() {
+                flush();
+            }
+        };
+
+        thread_local ThreadCache cache;
+    }
+
+    Buffer acquire(size_t min_size) {
+        size_t size_class = 0;
+        while (size_class + 1 < CLASS_COUNT && SIZE_CLASSES[size_class] < min_size) {
+            ++size_class;
+        }
+        size_t size = SIZE_CLASSES[size_class];
+        in_use_bytes += size;
+
+        auto &local = cache.free[size_class];
+        if (!local.empty()) {
+            char *bytes = local.back();
+            local.pop_back();
+            pooled_bytes -= size;
+            ++reuses;
+            return Buffer(bytes, static_cast<uint8_t>(size_class));
+        }
+        {
+            SharedLists &lists = shared();
+            std::lock_guard<std::mutex> lock(lists.mutex);
+            if (!lists.free[size_class].empty()) {
+                char *bytes = lists.free[size_class].back();
+                lists.free[size_class].pop_back();
+                pooled_bytes -= size;
+                ++reuses;
+                return Buffer(bytes, static_cast<uint8_t>(size_class));
+            }
+        }
+        ++allocations;
+        return Buffer(new char[size], static_cast<uint8_t>(size_class));
+    }
+
+    void Buffer::release() {
+        if (!bytes) {
+            return;
+        }
+        size_t size = SIZE_CLASSES[size_class];
+        in_use_bytes -= size;
+        auto &local = cache.free[size_class];
+        if (local.size() < config::BUFFER_POOL_THREAD_CACHE) {
+            local.push_back(bytes);
+            pooled_bytes += size;
+            cache.empty = false;
+        } else {
+            give_back(bytes, size_class);
+        }
+        bytes = nullptr;
+    }
+
+    void flush_thread_cache() {
+        if (!cache.empty) {
+            cache.flush();
+        }
+    }
+
+    Buffer::Buffer(Buffer &&other) noexcept : bytes(std::exchange(other.bytes, nullptr)), size_class(other.size_class) {}
+
+    Buffer &Buffer::operator=(Buffer &&other) noexcept {
+        if (this != &other) {
+            release();
+            bytes = std::exchange(other.bytes, nullptr);
+            size_class = other.size_class;
+        }
+        return *this;
+    }
+
+    Buffer::~Buffer() {
+        release();
+    }
+
+    Stats stats() {
+        return Stats{in_use_bytes.load(), pooled_bytes.load(), allocations.load(), reuses.load()};
+    }
+}
@@ -1,7 +1,15 @@
 #include <utils/file_utils.hpp>
+#include <utils/group_commit.hpp>
+#include <cerrno>           // errno, EEXIST
+#include <cstdio>           // snprintf()
+#include <cstring>          // strerror()
+#include <fcntl.h>          // open()
 #include <fstream>
 #include <iostream>
 #include <filesystem>
+#include <functional>
+#include <random>           // std::random_device, std::mt19937_64
+#include <unistd.h>         // write(), close()
 
 namespace http_server::file_utils {
     std::optional<std::string> read_file(const std::string& file_path) {
@@ -28,33 +36,98 @@ namespace http_server::file_utils {
         }
     }
 
-    void save_file(const std::string& file_path, const std::string& content) {
-        try {
-            // Validate the file path
-            std::filesystem::path validated_path = file_path;
-            std::filesystem::path parent_path = validated_path.parent_path();
-            
+    namespace {
+        // Create a new, hidden sibling of 'file_path' that nobody else can have opened:
+        // O_EXCL with a random name, so neither another process (such as a server the
+        // listeners were handed to) nor a client guessing the name can share it
+        int create_temporary(const std::string& file_path, std::string& temp_path) {
+            thread_local std::mt19937_64 random{std::random_device{}()};
+            std::filesystem::path target(file_path);
+            for(int attempt = 0; attempt < 16; ++attempt) {
+                char suffix[17];
+                snprintf(suffix, sizeof(suffix), "%016llx", static_cast<unsigned long long>(random()));
+                temp_path = (target.parent_path() / (TEMP_PREFIX + target.filename().string() + "." + suffix)).string();
+                int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+                if(fd >= 0 || errno != EEXIST) {
+                    return fd;
+                }
+            }
+            return -1;
+        }
+
+        // Write a sibling through 'write' and rename it over the target, so readers (and
+        // mappings) of the old file never see it truncated or half written. Returns
+        // false, leaving the target alone, if 'write' gives up. Durable replacements are
+        // synced and renamed by the group committer.
+        bool replace_file(const std::string& file_path, bool durable, const std::function<bool(const BodySink&)>& write) {
             // Create directories if they don't exist
+            std::filesystem::path parent_path = std::filesystem::path(file_path).parent_path();
             if (!parent_path.empty() && !std::filesystem::exists(parent_path)) {
                 std::filesystem::create_directories(parent_path);
             }
-            
-            // Write to file
-            std::ofstream file(file_path, std::ios::binary);
-            if(!file) {
-                throw std::runtime_error("Failed to open file for writing: " + file_path);
+
+            std::string temp_path;
+            int fd = create_temporary(file_path, temp_path);
+            if(fd < 0) {
+                throw std::runtime_error("Failed to open file for writing: " + file_path + ": " + strerror(errno));
             }
-            file.write(content.data(), content.size());
-            if(!file) {
-                throw std::runtime_error("Failed to write to file: " + file_path);
+            bool failed = false;
+            bool completed = write([&](const char* data, size_t length) {
+                while(length > 0) {
+                    ssize_t written = ::write(fd, data, length);
+                    if(written < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if(written <= 0) {
+                        failed = true;
+                        return false;
+                    }
+                    data += written;
+                    length -= static_cast<size_t>(written);
+                }
+                return true;
+            });
+            failed = (close(fd) != 0) || failed;
+            if(!completed || failed) {
+                std::filesystem::remove(temp_path);
+                if(failed) {
+                    throw std::runtime_error("Failed to write to file: " + file_path);
+                }
+                return false;
             }
-            file.close();
+            if(durable) {
+                GroupCommitter::instance().commit(temp_path, file_path);
+            } else {
+                std::filesystem::rename(temp_path, file_path);
+            }
+            return true;
+        }
+    }
+
+    void save_file(const std::string& file_path, const std::string& content, bool durable) {
+        try {
+            replace_file(file_path, durable, [&](const BodySink& sink) {
+                return sink(content.data(), content.size());
+            });
+        } catch (const std::exception& e) {
+            std::cerr << "Error saving file: " << e.what() << std::endl;
+            throw; // Rethrow to be handled by the caller
+        }
+    }
+
+    bool save_file_stream(const std::string& file_path, const BodyStream& source, bool durable) {
+        try {
+            return replace_file(file_path, durable, source);
         } catch (const std::exception& e) {
             std::cerr << "Error saving file: " << e.what() << std::endl;
             throw; // Rethrow to be handled by the caller
         }
     }
 
+    bool is_temporary(const std::string& path) {
+        return std::filesystem::path(path).filename().string().rfind(TEMP_PREFIX, 0) == 0;
+    }
+
     bool delete_file(const std::string& file_path) {
         try {
             if (std::filesystem::remove(file_path)) {
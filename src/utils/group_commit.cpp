@@ -0,0 +1,130 @@
+#include <utils/group_commit.hpp>
+#include <http_server/config.hpp>
+#include <algorithm>        // std::min
+#include <cerrno>           // errno
+#include <cstdio>           // rename()
+#include <cstring>          // strerror()
+#include <fcntl.h>          // open(), sync_file_range()
+#include <filesystem>       // std::filesystem::path
+#include <stdexcept>        // std::runtime_error
+#include <unistd.h>         // fdatasync(), fsync(), close(), unlink()
+#include <unordered_map>    // std::unordered_map
+
+namespace http_server::file_utils {
+    GroupCommitter::GroupCommitter(std::chrono::microseconds window, size_t max_batch)
+        : window(window), max_batch(max_batch), committer([this] { run(); }) {}
+
+    GroupCommitter::~GroupCommitter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        queued.notify_one();
+        committer.join();
+    }
+
+    GroupCommitter &GroupCommitter::instance() {
+        static GroupCommitter committer(std::chrono::microseconds(config::GROUP_COMMIT_WINDOW_US), config::GROUP_COMMIT_MAX_BATCH);
+        return committer;
+    }
+
+    void GroupCommitter::commit(const std::string &temp_path, const std::string &path) {
+        Pending pending{temp_path, path};
+        std::unique_lock<std::mutex> lock(mutex);
+        queue.push_back(&pending);
+        queued.notify_one();
+        committed.wait(lock, [&] { return pending.done; });
+        if (!pending.error.empty()) {
+            throw std::runtime_error(pending.error);
+        }
+    }
+
+    GroupCommitter::Stats GroupCommitter::stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return totals;
+    }
+
+    void GroupCommitter::run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            queued.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+            // Let writers finishing at about the same time join this round; anything arriving
+            // while it syncs waits for the next one
+            queued.wait_for(lock, window, [&] { return stopping || queue.size() >= max_batch; });
+            size_t count = std::min(queue.size(), max_batch);
+            std::vector<Pending *> batch(queue.begin(), queue.begin() + count);
+            queue.erase(queue.begin(), queue.begin() + count);
+
+            lock.unlock();
+            size_t directories = sync_batch(batch);
+            lock.lock();
+
+            for (Pending *pending : batch) {
+                pending->done = true;
+            }
+            totals.commits += count;
+            totals.batches += 1;
+            totals.directory_syncs += directories;
+            committed.notify_all();
+        }
+    }
+
+    size_t GroupCommitter::sync_batch(const std::vector<Pending *> &batch) {
+        auto fail = [](Pending *pending, const char *what, const std::string &path) {
+            pending->error = std::string("Failed to ") + what + " " + path + ": " + strerror(errno);
+        };
+
+        // Queue writeback for every file before waiting on any, so the device gets the
+        // whole batch at once rather than one file per round trip
+        std::vector<int> fds(batch.size(), -1);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            fds[i] = open(batch[i]->temp_path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fds[i] < 0) {
+                fail(batch[i], "open", batch[i]->temp_path);
+                continue;
+            }
+            sync_file_range(fds[i], 0, 0, SYNC_FILE_RANGE_WRITE);
+        }
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (fds[i] < 0) {
+                continue;
+            }
+            if (fdatasync(fds[i]) < 0) {
+                fail(batch[i], "sync", batch[i]->temp_path);
+            }
+            close(fds[i]);
+        }
+
+        // Renames in arrival order, so the later of two uploads to one path wins
+        std::unordered_map<std::string, std::vector<Pending *>> directories;
+        for (Pending *pending : batch) {
+            if (pending->error.empty() && rename(pending->temp_path.c_str(), pending->path.c_str()) < 0) {
+                fail(pending, "rename", pending->temp_path);
+            }
+            if (!pending->error.empty()) {
+                unlink(pending->temp_path.c_str());
+                continue;
+            }
+            std::string parent = std::filesystem::path(pending->path).parent_path().string();
+            directories[parent.empty() ? "." : parent].push_back(pending);
+        }
+
+        // One sync per directory makes every rename in it durable
+        for (const auto &[directory, renamed] : directories) {
+            int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            bool synced = fd >= 0 && fsync(fd) == 0;
+            if (!synced) {
+                for (Pending *pending : renamed) {
+                    fail(pending, "sync directory", directory);
+                }
+            }
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        return directories.size();
+    }
+}
@@ -0,0 +1,107 @@
+#include <utils/mmap_cache.hpp>
+#include <http_server/config.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace http_server::file_utils {
+    MappedFile::MappedFile(void *address, const struct stat &info)
+        : address(address), length(static_cast<size_t>(info.st_size)), device(info.st_dev), inode(info.st_ino), modified(info.st_mtim) {}
+
+    MappedFile::~MappedFile() {
+        if (length > 0) {
+            munmap(address, length);
+        }
+    }
+
+    std::shared_ptr<const MappedFile> MappedFile::map(const std::string &path, const struct stat &info) {
+        if (!S_ISREG(info.st_mode)) {
+            return nullptr;
+        }
+        if (info.st_size == 0) {
+            // mmap rejects empty lengths
+            return std::shared_ptr<const MappedFile>(new MappedFile(nullptr, info));
+        }
+
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return nullptr;
+        }
+        void *address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);  // the mapping keeps the file alive
+        if (address == MAP_FAILED) {
+            return nullptr;
+        }
+        // Served front to back: read ahead aggressively and start paging in now
+        madvise(address, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+        madvise(address, static_cast<size_t>(info.st_size), MADV_WILLNEED);
+        return std::shared_ptr<const MappedFile>(new MappedFile(address, info));
+    }
+
+    bool MappedFile::matches(const struct stat &info) const {
+        return info.st_dev == device && info.st_ino == inode && static_cast<size_t>(info.st_size) == length
+            && info.st_mtim.tv_sec == modified.tv_sec && info.st_mtim.tv_nsec == modified.tv_nsec;
+    }
+
+    MmapCache::MmapCache(size_t max_bytes) : max_bytes(max_bytes) {}
+
+    MmapCache &MmapCache::instance() {
+        static MmapCache cache(config::MMAP_CACHE_BYTES);
+        return cache;
+    }
+
+    std::shared_ptr<const MappedFile> MmapCache::get(const std::string &path) {
+        struct stat info;
+        if (stat(path.c_str(), &info) < 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(path);
+            if (it != entries.end()) {
+                erase(it);
+            }
+            return nullptr;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(path);
+            if (it != entries.end()) {
+                if (it->second.file->matches(info)) {
+                    lru.splice(lru.begin(), lru, it->second.lru_position);
+                    return it->second.file;
+                }
+                // Changed on disk; readers holding the old mapping keep it until they finish
+                erase(it);
+            }
+        }
+
+        // Map outside the lock; a racing request for the same file may map it too
+        auto file = MappedFile::map(path, info);
+        if (!file || file->size() > max_bytes) {
+            return file;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(path);
+        if (it != entries.end()) {
+            erase(it);
+        }
+        while (bytes + file->size() > max_bytes && !lru.empty()) {
+            erase(entries.find(lru.back()));
+        }
+        lru.push_front(path);
+        entries.emplace(path, Entry{file, lru.begin()});
+        bytes += file->size();
+        return file;
+    }
+
+    void MmapCache::erase(std::unordered_map<std::string, Entry>::iterator it) {
+        bytes -= it->second.file->size();
+        lru.erase(it->second.lru_position);
+        entries.erase(it);
+    }
+
+    size_t MmapCache::mapped_bytes() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return bytes;
+    }
+}
@@ -0,0 +1,82 @@
+#include <utils/sha1.hpp>
+#include <cstring>  // std::memcpy
+
+namespace http_server::sha1 {
+    namespace {
+        uint32_t rotate_left(uint32_t value, int bits) {
+            return (value << bits) | (value >> (32 - bits));
+        }
+
+        void process_block(uint32_t state[5], const uint8_t *block) {
+            uint32_t w[80];
+            for (int i = 0; i < 16; ++i) {
+                w[i] = (uint32_t(block[i * 4]) << 24) | (uint32_t(block[i * 4 + 1]) << 16) |
+                       (uint32_t(block[i * 4 + 2]) << 8) | uint32_t(block[i * 4 + 3]);
+            }
+            for (int i = 16; i < 80; ++i) {
+                w[i] = rotate_left(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+            for (int i = 0; i < 80; ++i) {
+                uint32_t f, k;
+                if (i < 20) {
+                    f = (b & c) | (~b & d);
+                    k = 0x5A827999;
+                } else if (i < 40) {
+                    f = b ^ c ^ d;
+                    k = 0x6ED9EBA1;
+                } else if (i < 60) {
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8F1BBCDC;
+                } else {
+                    f = b ^ c ^ d;
+                    k = 0xCA62C1D6;
+                }
+                uint32_t temp = rotate_left(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rotate_left(b, 30);
+                b = a;
+                a = temp;
+            }
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+        }
+    }
+
+    Digest digest(std::string_view data) {
+        uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data.data());
+        size_t full_blocks = data.size() / 64;
+        for (size_t i = 0; i < full_blocks; ++i) {
+            process_block(state, bytes + i * 64);
+        }
+
+        // Padding: 0x80, zeros, then the message length in bits, big-endian
+        uint8_t tail[128] = {};
+        size_t remainder = data.size() % 64;
+        std::memcpy(tail, bytes + full_blocks * 64, remainder);
+        tail[remainder] = 0x80;
+        size_t tail_length = remainder < 56 ? 64 : 128;
+        uint64_t bit_length = static_cast<uint64_t>(data.size()) * 8;
+        for (int i = 0; i < 8; ++i) {
+            tail[tail_length - 1 - i] = static_cast<uint8_t>(bit_length >> (i * 8));
+        }
+        for (size_t offset = 0; offset < tail_length; offset += 64) {
+            process_block(state, tail + offset);
+        }
+
+        Digest result;
+        for (int i = 0; i < 5; ++i) {
+            result[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+            result[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+            result[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+            result[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+        }
+        return result;
+    }
+}
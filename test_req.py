@@ -1,3 +1,5 @@
+import socket
+
 import requests
 
 def test_get_request():
@@ -9,4 +11,25 @@ def test_get_request():
     assert response.status_code == 200, f"Expected status code 200, got {response.status_code}"
     print(response.text)
 
-test_get_request()
\ No newline at end of file
+def send_raw(request):
+    # Framing that requests would never produce has to go over a plain socket
+    with socket.create_connection(("localhost", 4221), timeout=5) as connection:
+        connection.sendall(request)
+        return connection.recv(4096).split(b"\r\n", 1)[0]
+
+def test_conflicting_content_length():
+    status = send_raw(b"POST /echo/x HTTP/1.1\r\nHost: localhost\r\n"
+                      b"Content-Length: 3\r\nContent-Length: 10\r\n\r\nabc")
+    assert status == b"HTTP/1.1 400 Bad Request", f"Expected 400, got {status}"
+
+def test_transfer_encoding_with_content_length():
+    status = send_raw(b"POST /echo/x HTTP/1.1\r\nHost: localhost\r\n"
+                      b"Content-Length: 3\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n")
+    assert status == b"HTTP/1.1 400 Bad Request", f"Expected 400, got {status}"
+    status = send_raw(b"POST /echo/x HTTP/1.1\r\nHost: localhost\r\n"
+                      b"Transfer-Encoding: chunked\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n")
+    assert status == b"HTTP/1.1 400 Bad Request", f"Expected 400, got {status}"
+
+test_get_request()
+test_conflicting_content_length()
+test_transfer_encoding_with_content_length()
\ No newline at end of file